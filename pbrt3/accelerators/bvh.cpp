@@ -0,0 +1,1231 @@
+//
+//  bvh.cpp
+//  pbrt3
+//
+//  Created by Ilya Rostovtsev on 10/17/26.
+//  Copyright © 2017 Ilya Rostovtsev. All rights reserved.
+//
+
+#include "bvh.hpp"
+#include "interaction.hpp"
+#include "memory.hpp"
+#include "parallel.hpp"
+#include "stats.hpp"
+#include "trianglemesh.hpp"
+#include <atomic>
+
+namespace pbrt {
+
+STAT_MEMORY_COUNTER( "Memory/BVH tree", treeBytes );
+STAT_RATIO( "BVH/Primitives per leaf node", totalPrimitives, totalLeafNodes );
+STAT_COUNTER( "BVH/Interior nodes", interiorNodes );
+STAT_COUNTER( "BVH/Leaf nodes", leafNodes );
+STAT_COUNTER( "BVH/Spatial split duplicate references", spatialSplitDuplicates );
+STAT_COUNTER( "BVH/Refits", refits );
+STAT_COUNTER( "BVH/Rebuilds after refit", refitRebuilds );
+
+// ranges at least this large have their bounds and SAH buckets computed with ParallelFor, and
+// their two children built concurrently
+static PBRT_CONSTEXPR int ParallelBuildThreshold = 16 * 1024;
+
+// SBVH (Stich et al., "Spatial Splits in Bounding Volume Hierarchies"): spatial splits are only
+// considered where the children of the best object split overlap by more than SpatialSplitAlpha
+// of the root's surface area, and may add at most MaxSpatialSplitDuplication references per
+// primitive over the whole tree.
+static PBRT_CONSTEXPR Float SpatialSplitAlpha = 1e-5;
+static PBRT_CONSTEXPR Float MaxSpatialSplitDuplication = .3;
+static PBRT_CONSTEXPR int SpatialSplitBins = 16;
+
+// Refit() rebuilds the tree from scratch once its SAH cost exceeds this multiple of the cost
+// right after the last build.
+static PBRT_CONSTEXPR Float RefitRebuildRatio = 1.5;
+
+// Primitives of widely varying size make SAH (and midpoint splits) peel off a few at a time and
+// build long chains. A node at depth with nPrimitives may only be split that way while splitting
+// its children, of up to nPrimitives each, into equal halves would still keep every leaf within
+// MaxBVHDepth; otherwise it is split into equal halves itself.
+static bool CanSplitBySAH( int depth, int nPrimitives )
+{
+    int equalCountsDepth = nPrimitives > 1 ? Log2Int( nPrimitives - 1 ) + 1 : 0;
+    return depth + 1 + equalCountsDepth < MaxBVHDepth;
+}
+
+struct BVHPrimitiveInfo
+{
+    BVHPrimitiveInfo() {}
+    BVHPrimitiveInfo( int primitiveNumber, const Bounds3f& bounds )
+    : primitiveNumber{ primitiveNumber },
+      bounds{ bounds },
+      centroid{ Float( .5 ) * bounds.pMin + Float( .5 ) * bounds.pMax }
+    {
+    }
+    int primitiveNumber;
+    Bounds3f bounds;
+    Point3f centroid;
+};
+
+struct BVHBuildNode
+{
+    void InitLeaf( int first, int n, const Bounds3f& b )
+    {
+        firstPrimOffset = first;
+        nPrimitives = n;
+        bounds = b;
+        children[ 0 ] = children[ 1 ] = nullptr;
+        ++leafNodes;
+        ++totalLeafNodes;
+        totalPrimitives += n;
+    }
+    void InitInterior( int axis, BVHBuildNode* c0, BVHBuildNode* c1 )
+    {
+        children[ 0 ] = c0;
+        children[ 1 ] = c1;
+        bounds = Union( c0->bounds, c1->bounds );
+        splitAxis = axis;
+        nPrimitives = 0;
+        ++interiorNodes;
+    }
+    Bounds3f bounds;
+    BVHBuildNode* children[ 2 ];
+    int splitAxis, firstPrimOffset, nPrimitives;
+};
+
+// Shared by every thread taking part in the build. Nodes come from the arena of the thread that
+// creates them; leaves reserve their slice of orderedPrims with an atomic add. Spatial splits
+// take the references they add out of duplicationBudget, for which orderedPrims has room.
+struct BVHBuildState
+{
+    BVHBuildState( int nPrimitives, int duplicationBudget )
+    : arenas( MaxThreadIndex() ),
+      primitiveInfo( nPrimitives ),
+      orderedPrims( nPrimitives + duplicationBudget ),
+      duplicationBudget{ duplicationBudget }
+    {
+    }
+    std::vector< MemoryArena > arenas;
+    std::vector< BVHPrimitiveInfo > primitiveInfo;
+    std::vector< BVHPrimitive > orderedPrims;
+    std::atomic< int > totalNodes{ 0 };
+    std::atomic< int > orderedPrimsOffset{ 0 };
+    std::atomic< int > duplicationBudget;
+    Float rootSurfaceArea = 0;
+};
+
+// With spatial splits a primitive can be referenced from several leaves. The mailbox remembers
+// the last few primitives a ray was tested against, so that repeated tests can be skipped.
+struct BVHMailbox
+{
+    // returns true if prim was already tested
+    bool Visit( const BVHPrimitive& prim )
+    {
+        for ( int i = 0; i < Size; ++i )
+            if ( entries[ i ] && entries[ i ]->shape == prim.shape &&
+                 entries[ i ]->triIndex == prim.triIndex )
+                return true;
+        entries[ next ] = &prim;
+        next = ( next + 1 ) % Size;
+        return false;
+    }
+    static PBRT_CONSTEXPR int Size = 8;
+    const BVHPrimitive* entries[ Size ] = {};
+    int next = 0;
+};
+
+// Bounds of primitives [start, end) and of their centroids.
+static void ComputeRangeBounds( const std::vector< BVHPrimitiveInfo >& primitiveInfo, int start,
+                                int end, Bounds3f* bounds, Bounds3f* centroidBounds )
+{
+    const int chunkSize = ParallelBuildThreshold / 4;
+    int nChunks =
+      end - start < ParallelBuildThreshold ? 1 : ( end - start + chunkSize - 1 ) / chunkSize;
+    std::vector< Bounds3f > chunkBounds( nChunks ), chunkCentroidBounds( nChunks );
+    auto computeChunk = [&]( int64_t c ) {
+        int chunkEnd =
+          nChunks == 1 ? end : std::min( end, start + ( int )( c + 1 ) * chunkSize );
+        for ( int i = start + ( int )c * chunkSize; i < chunkEnd; ++i ) {
+            chunkBounds[ c ] = Union( chunkBounds[ c ], primitiveInfo[ i ].bounds );
+            chunkCentroidBounds[ c ] =
+              Union( chunkCentroidBounds[ c ], primitiveInfo[ i ].centroid );
+        }
+    };
+    if ( nChunks == 1 )
+        computeChunk( 0 );
+    else
+        ParallelFor( computeChunk, nChunks );
+
+    *bounds = chunkBounds[ 0 ];
+    *centroidBounds = chunkCentroidBounds[ 0 ];
+    for ( int c = 1; c < nChunks; ++c ) {
+        *bounds = Union( *bounds, chunkBounds[ c ] );
+        *centroidBounds = Union( *centroidBounds, chunkCentroidBounds[ c ] );
+    }
+}
+
+bool BVHPrimitive::IntersectP( const Ray& ray ) const
+{
+    if ( !mesh )
+        return shape->IntersectP( ray );
+    TriangleHit hit;
+    return mesh->IntersectTriangle( triIndex, ray, RayPrecomputed( ray ), &hit );
+}
+
+static Bounds3f PrimitiveBound( const BVHPrimitive& prim )
+{
+    return prim.mesh ? prim.mesh->TriangleBound( prim.triIndex ) : prim.shape->WorldBound();
+}
+
+BVHAccel::BVHAccel( const std::vector< std::shared_ptr< Shape > >& shapes, int maxPrimsInNode,
+                    SplitMethod splitMethod, const std::string& cacheFilename )
+: maxPrimsInNode{ std::min( 255, maxPrimsInNode ) },
+  splitMethod{ splitMethod },
+  shapes{ shapes }
+{
+    buildOrLoad( cacheFilename );
+}
+
+BVHAccel::BVHAccel( const std::vector< std::shared_ptr< Shape > >& shapes, Float time0,
+                    Float time1, int nTimeSegments, int maxPrimsInNode, SplitMethod splitMethod,
+                    const std::string& cacheFilename )
+: maxPrimsInNode{ std::min( 255, maxPrimsInNode ) },
+  splitMethod{ splitMethod },
+  shapes{ shapes },
+  time0{ time0 },
+  time1{ time1 },
+  nTimeSegments{ std::max( 1, nTimeSegments ) }
+{
+    CHECK_LT( time0, time1 );
+    buildOrLoad( cacheFilename );
+}
+
+void BVHAccel::buildOrLoad( const std::string& cacheFilename )
+{
+    if ( cacheFilename.empty() ) {
+        build();
+        return;
+    }
+    uint64_t hash = geometryHash();
+    if ( loadCache( cacheFilename, hash ) )
+        return;
+    build();
+    writeCache( cacheFilename, hash );
+}
+
+void BVHAccel::expandPrimitives( std::vector< BVHPrimitive >* prims ) const
+{
+    // triangle meshes are expanded into per-triangle references
+    prims->clear();
+    for ( const auto& shape : shapes ) {
+        if ( auto meshShape = dynamic_cast< const TriangleMeshShape* >( shape.get() ) ) {
+            const TriangleMesh* mesh = meshShape->mesh.get();
+            for ( int i = 0; i < mesh->nTriangles; ++i )
+                prims->push_back( BVHPrimitive{ shape.get(), mesh, i } );
+        } else
+            prims->push_back( BVHPrimitive{ shape.get(), nullptr, -1 } );
+    }
+}
+
+void BVHAccel::build()
+{
+    ProfilePhase _( Prof::AccelConstruction );
+    freeTree();
+    expandPrimitives( &primitives );
+    if ( primitives.empty() )
+        return;
+
+    // initialize primitiveInfo array for primitives
+    int nPrimitives = static_cast< int >( primitives.size() );
+    int duplicationBudget =
+      splitMethod == SplitMethod::SBVH ? ( int )( MaxSpatialSplitDuplication * nPrimitives ) : 0;
+    BVHBuildState state( nPrimitives, duplicationBudget );
+    ParallelFor(
+      [&]( int64_t i ) {
+          state.primitiveInfo[ i ] =
+            BVHPrimitiveInfo( static_cast< int >( i ), PrimitiveBound( primitives[ i ] ) );
+      },
+      primitives.size(), 4096 );
+
+    // build BVH tree for primitives using primitiveInfo
+    BVHBuildNode* root;
+    if ( splitMethod == SplitMethod::SBVH ) {
+        // spatial splits add references, so every node gets a list of its own
+        std::vector< BVHPrimitiveInfo > refs;
+        refs.swap( state.primitiveInfo );
+        Bounds3f bounds, centroidBounds;
+        ComputeRangeBounds( refs, 0, nPrimitives, &bounds, &centroidBounds );
+        state.rootSurfaceArea = bounds.SurfaceArea();
+        root = recursiveBuildSBVH( state, refs, 0 );
+        state.orderedPrims.resize( state.orderedPrimsOffset );
+        spatialSplitDuplicates += state.orderedPrimsOffset - nPrimitives;
+    } else if ( splitMethod == SplitMethod::HLBVH )
+        root = HLBVHBuild( state );
+    else
+        root = recursiveBuild( state, 0, nPrimitives, 0 );
+    primitives.swap( state.orderedPrims );
+
+    // compute representation of depth-first traversal of BVH tree
+    totalNodes = state.totalNodes;
+    nodes = AllocAligned< LinearBVHNode >( totalNodes );
+    int offset = 0;
+    flattenBVHTree( root, &offset );
+    finishTree();
+}
+
+// everything that is derived from the flattened tree, whether it was just built or loaded
+void BVHAccel::finishTree()
+{
+    builtSAHCost = SAHCost();
+    treeMemory = totalNodes * sizeof( LinearBVHNode ) + sizeof( *this ) +
+                 primitives.size() * sizeof( primitives[ 0 ] );
+    if ( nTimeSegments > 0 ) {
+        timeBounds = AllocAligned< Bounds3f >( totalNodes * ( nTimeSegments + 1 ) );
+        treeMemory += totalNodes * ( nTimeSegments + 1 ) * sizeof( Bounds3f );
+        computeTimeBounds( 0 );
+    }
+    treeBytes += treeMemory;
+}
+
+void BVHAccel::uncountTreeMemory()
+{
+    treeBytes -= treeMemory;
+    treeMemory = 0;
+}
+
+BVHAccel::~BVHAccel() { freeTree(); }
+
+Bounds3f BVHAccel::WorldBound() const { return nodes ? nodes[ 0 ].bounds : Bounds3f(); }
+
+bool BVHAccel::Refit()
+{
+    if ( !nodes )
+        return false;
+    ProfilePhase _( Prof::AccelConstruction );
+    ++refits;
+    refitSubtree( 0 );
+    if ( SAHCost() <= RefitRebuildRatio * builtSAHCost ) {
+        if ( timeBounds )
+            computeTimeBounds( 0 );
+        return false;
+    }
+    ++refitRebuilds;
+    build();
+    return true;
+}
+
+Bounds3f BVHAccel::refitSubtree( int nodeIndex )
+{
+    LinearBVHNode* node = &nodes[ nodeIndex ];
+    if ( node->nPrimitives > 0 ) {
+        Bounds3f bounds;
+        for ( int i = 0; i < node->nPrimitives; ++i )
+            bounds = Union( bounds, PrimitiveBound( primitives[ node->primitivesOffset + i ] ) );
+        node->bounds = bounds;
+        return bounds;
+    }
+
+    // the first child's subtree lies between this node and the second child, so its size is
+    // known up front; refit the children of large subtrees concurrently
+    Bounds3f childBounds[ 2 ];
+    int childIndex[ 2 ] = { nodeIndex + 1, node->secondChildOffset };
+    if ( node->secondChildOffset - nodeIndex >= ParallelBuildThreshold )
+        ParallelFor( [&]( int64_t i ) { childBounds[ i ] = refitSubtree( childIndex[ i ] ); }, 2 );
+    else {
+        childBounds[ 0 ] = refitSubtree( childIndex[ 0 ] );
+        childBounds[ 1 ] = refitSubtree( childIndex[ 1 ] );
+    }
+    node->bounds = Union( childBounds[ 0 ], childBounds[ 1 ] );
+    return node->bounds;
+}
+
+void BVHAccel::computeTimeBounds( int nodeIndex )
+{
+    const LinearBVHNode* node = &nodes[ nodeIndex ];
+    int nKeys = nTimeSegments + 1;
+    Bounds3f* keys = &timeBounds[ nodeIndex * nKeys ];
+    if ( node->nPrimitives > 0 ) {
+        for ( int k = 0; k < nKeys; ++k )
+            keys[ k ] = Bounds3f();
+        for ( int i = 0; i < node->nPrimitives; ++i ) {
+            const BVHPrimitive& prim = primitives[ node->primitivesOffset + i ];
+            if ( prim.mesh ) {
+                // meshes don't move
+                Bounds3f bounds = prim.mesh->TriangleBound( prim.triIndex );
+                for ( int k = 0; k < nKeys; ++k )
+                    keys[ k ] = Union( keys[ k ], bounds );
+                continue;
+            }
+            // a key shared by two segments has to hold the ends of both
+            for ( int k = 0; k < nTimeSegments; ++k ) {
+                Bounds3f bounds0, bounds1;
+                prim.shape->LinearMotionBounds( Lerp( Float( k ) / nTimeSegments, time0, time1 ),
+                                                Lerp( Float( k + 1 ) / nTimeSegments, time0,
+                                                      time1 ),
+                                                &bounds0, &bounds1 );
+                keys[ k ] = Union( keys[ k ], bounds0 );
+                keys[ k + 1 ] = Union( keys[ k + 1 ], bounds1 );
+            }
+        }
+        return;
+    }
+
+    int childIndex[ 2 ] = { nodeIndex + 1, node->secondChildOffset };
+    if ( node->secondChildOffset - nodeIndex >= ParallelBuildThreshold )
+        ParallelFor( [&]( int64_t i ) { computeTimeBounds( childIndex[ i ] ); }, 2 );
+    else {
+        computeTimeBounds( childIndex[ 0 ] );
+        computeTimeBounds( childIndex[ 1 ] );
+    }
+    const Bounds3f* keys0 = &timeBounds[ childIndex[ 0 ] * nKeys ];
+    const Bounds3f* keys1 = &timeBounds[ childIndex[ 1 ] * nKeys ];
+    for ( int k = 0; k < nKeys; ++k )
+        keys[ k ] = Union( keys0[ k ], keys1[ k ] );
+}
+
+Float BVHAccel::SAHCost() const
+{
+    // every node is weighted by the chance that a ray through the root also hits it; visiting an
+    // interior node costs as much as intersecting one primitive, as in the build
+    Float rootArea = nodes[ 0 ].bounds.SurfaceArea();
+    if ( rootArea == 0 )
+        return 0;
+    Float cost = 0;
+    for ( int i = 0; i < totalNodes; ++i )
+        cost += nodes[ i ].bounds.SurfaceArea() * std::max( 1, ( int )nodes[ i ].nPrimitives );
+    return cost / rootArea;
+}
+
+// Binned SAH: centroids are sorted into this many buckets along the split axis.
+static PBRT_CONSTEXPR int SAHBuckets = 12;
+
+static int SAHBucket( const Bounds3f& centroidBounds, int dim, const BVHPrimitiveInfo& pi )
+{
+    int b = static_cast< int >( SAHBuckets * centroidBounds.Offset( pi.centroid )[ dim ] );
+    return b == SAHBuckets ? SAHBuckets - 1 : b;
+}
+
+// The cheapest binned SAH split of a range: buckets up to and including bucket go to the first
+// child. The cost is relative to intersecting a single primitive, like a leaf's.
+struct ObjectSplit
+{
+    int bucket;
+    Float cost;
+    Bounds3f bounds[ 2 ];
+};
+
+static ObjectSplit FindObjectSplit( const std::vector< BVHPrimitiveInfo >& primitiveInfo,
+                                    int start, int end, const Bounds3f& bounds,
+                                    const Bounds3f& centroidBounds, int dim )
+{
+    struct BucketInfo
+    {
+        int count = 0;
+        Bounds3f bounds;
+    };
+
+    // initialize BucketInfo for SAH partition buckets, binning large ranges in parallel
+    int nPrimitives = end - start;
+    const int chunkSize = ParallelBuildThreshold / 4;
+    int nChunks =
+      nPrimitives < ParallelBuildThreshold ? 1 : ( nPrimitives + chunkSize - 1 ) / chunkSize;
+    std::vector< BucketInfo > chunkBuckets( nChunks * SAHBuckets );
+    auto binChunk = [&]( int64_t c ) {
+        BucketInfo* buckets = &chunkBuckets[ c * SAHBuckets ];
+        int chunkEnd = nChunks == 1 ? end : std::min( end, start + ( int )( c + 1 ) * chunkSize );
+        for ( int i = start + ( int )c * chunkSize; i < chunkEnd; ++i ) {
+            BucketInfo& bucket = buckets[ SAHBucket( centroidBounds, dim, primitiveInfo[ i ] ) ];
+            bucket.count++;
+            bucket.bounds = Union( bucket.bounds, primitiveInfo[ i ].bounds );
+        }
+    };
+    if ( nChunks == 1 )
+        binChunk( 0 );
+    else
+        ParallelFor( binChunk, nChunks );
+    BucketInfo buckets[ SAHBuckets ];
+    for ( int c = 0; c < nChunks; ++c )
+        for ( int b = 0; b < SAHBuckets; ++b ) {
+            buckets[ b ].count += chunkBuckets[ c * SAHBuckets + b ].count;
+            buckets[ b ].bounds =
+              Union( buckets[ b ].bounds, chunkBuckets[ c * SAHBuckets + b ].bounds );
+        }
+
+    // compute costs for splitting after each bucket with a forward and a backward sweep;
+    // empty sides contribute nothing (their bounds are degenerate)
+    Float cost[ SAHBuckets - 1 ];
+    Bounds3f below[ SAHBuckets - 1 ], above[ SAHBuckets - 1 ];
+    Bounds3f b0;
+    int count0 = 0;
+    for ( int i = 0; i < SAHBuckets - 1; ++i ) {
+        b0 = below[ i ] = Union( b0, buckets[ i ].bounds );
+        count0 += buckets[ i ].count;
+        cost[ i ] = count0 > 0 ? count0 * b0.SurfaceArea() : 0;
+    }
+    Bounds3f b1;
+    int count1 = 0;
+    Float invArea = 1 / bounds.SurfaceArea();
+    for ( int i = SAHBuckets - 1; i > 0; --i ) {
+        b1 = above[ i - 1 ] = Union( b1, buckets[ i ].bounds );
+        count1 += buckets[ i ].count;
+        Float cost1 = count1 > 0 ? count1 * b1.SurfaceArea() : 0;
+        cost[ i - 1 ] = 1 + ( cost[ i - 1 ] + cost1 ) * invArea;
+    }
+
+    // find bucket to split at that minimizes SAH metric
+    ObjectSplit split;
+    split.bucket = 0;
+    for ( int i = 1; i < SAHBuckets - 1; ++i )
+        if ( cost[ i ] < cost[ split.bucket ] )
+            split.bucket = i;
+    split.cost = cost[ split.bucket ];
+    split.bounds[ 0 ] = below[ split.bucket ];
+    split.bounds[ 1 ] = above[ split.bucket ];
+    return split;
+}
+
+BVHBuildNode* BVHAccel::recursiveBuild( BVHBuildState& state, int start, int end, int depth )
+{
+    BVHBuildNode* node = ARENA_ALLOC( state.arenas[ ThreadIndex ], BVHBuildNode )();
+    ++state.totalNodes;
+    std::vector< BVHPrimitiveInfo >& primitiveInfo = state.primitiveInfo;
+
+    // compute bounds of all primitives and of their centroids in BVH node
+    Bounds3f bounds, centroidBounds;
+    ComputeRangeBounds( primitiveInfo, start, end, &bounds, &centroidBounds );
+
+    int nPrimitives = end - start;
+    auto createLeaf = [&]() {
+        int firstPrimOffset = state.orderedPrimsOffset.fetch_add( nPrimitives );
+        for ( int i = start; i < end; ++i ) {
+            int primNum = primitiveInfo[ i ].primitiveNumber;
+            state.orderedPrims[ firstPrimOffset + i - start ] = primitives[ primNum ];
+        }
+        node->InitLeaf( firstPrimOffset, nPrimitives, bounds );
+        return node;
+    };
+    if ( nPrimitives == 1 )
+        return createLeaf();
+
+    // choose split dimension; with all centroids coincident or the tree getting too deep, fall
+    // back to equal counts
+    int dim = centroidBounds.MaximumExtent();
+    int mid = ( start + end ) / 2;
+    SplitMethod method = splitMethod;
+    if ( centroidBounds.pMax[ dim ] == centroidBounds.pMin[ dim ] ||
+         !CanSplitBySAH( depth, nPrimitives ) ) {
+        if ( nPrimitives <= maxPrimsInNode )
+            return createLeaf();
+        method = SplitMethod::EqualCounts;
+    }
+
+    // partition primitives into two sets
+    if ( method == SplitMethod::Middle ) {
+        Float pmid = ( centroidBounds.pMin[ dim ] + centroidBounds.pMax[ dim ] ) / 2;
+        BVHPrimitiveInfo* midPtr = std::partition(
+          &primitiveInfo[ start ], &primitiveInfo[ end - 1 ] + 1,
+          [dim, pmid]( const BVHPrimitiveInfo& pi ) { return pi.centroid[ dim ] < pmid; } );
+        mid = static_cast< int >( midPtr - &primitiveInfo[ 0 ] );
+        // fall through to equal counts when the midpoint doesn't separate anything
+        if ( mid == start || mid == end )
+            method = SplitMethod::EqualCounts;
+    } else if ( method == SplitMethod::SAH && nPrimitives <= 2 )
+        method = SplitMethod::EqualCounts;
+
+    if ( method == SplitMethod::SAH ) {
+        ObjectSplit split =
+          FindObjectSplit( primitiveInfo, start, end, bounds, centroidBounds, dim );
+
+        // either create leaf or split primitives at selected SAH bucket
+        Float leafCost = nPrimitives;
+        if ( nPrimitives <= maxPrimsInNode && split.cost >= leafCost )
+            return createLeaf();
+        BVHPrimitiveInfo* pmid =
+          std::partition( &primitiveInfo[ start ], &primitiveInfo[ end - 1 ] + 1,
+                          [&]( const BVHPrimitiveInfo& pi ) {
+                              return SAHBucket( centroidBounds, dim, pi ) <= split.bucket;
+                          } );
+        mid = static_cast< int >( pmid - &primitiveInfo[ 0 ] );
+        if ( mid == start || mid == end )
+            method = SplitMethod::EqualCounts;
+    }
+
+    if ( method == SplitMethod::EqualCounts ) {
+        mid = ( start + end ) / 2;
+        std::nth_element( &primitiveInfo[ start ], &primitiveInfo[ mid ],
+                          &primitiveInfo[ end - 1 ] + 1,
+                          [dim]( const BVHPrimitiveInfo& a, const BVHPrimitiveInfo& b ) {
+                              return a.centroid[ dim ] < b.centroid[ dim ];
+                          } );
+    }
+
+    // build the two children, concurrently for large ranges
+    BVHBuildNode* children[ 2 ];
+    if ( nPrimitives >= ParallelBuildThreshold )
+        ParallelFor(
+          [&]( int64_t i ) {
+              children[ i ] = i == 0 ? recursiveBuild( state, start, mid, depth + 1 )
+                                     : recursiveBuild( state, mid, end, depth + 1 );
+          },
+          2 );
+    else {
+        children[ 0 ] = recursiveBuild( state, start, mid, depth + 1 );
+        children[ 1 ] = recursiveBuild( state, mid, end, depth + 1 );
+    }
+    node->InitInterior( dim, children[ 0 ], children[ 1 ] );
+    return node;
+}
+
+static bool IsEmpty( const Bounds3f& b )
+{
+    return b.pMin.x > b.pMax.x || b.pMin.y > b.pMax.y || b.pMin.z > b.pMax.z;
+}
+
+// Bounds of the part of a reference that lies in the slab lo <= p[ axis ] <= hi. Triangles are
+// clipped exactly; other shapes only have their (already clipped) bounds cut by the slab.
+static Bounds3f ClipReference( const BVHPrimitive& prim, const Bounds3f& refBounds, int axis,
+                               Float lo, Float hi )
+{
+    Bounds3f clipped;
+    if ( prim.mesh ) {
+        const int* v = &prim.mesh->vertexIndices[ 3 * prim.triIndex ];
+        for ( int e = 0; e < 3; ++e ) {
+            const Point3f& p0 = prim.mesh->p[ v[ e ] ];
+            const Point3f& p1 = prim.mesh->p[ v[ e == 2 ? 0 : e + 1 ] ];
+            Float a0 = p0[ axis ], a1 = p1[ axis ];
+            if ( a0 >= lo && a0 <= hi )
+                clipped = Union( clipped, p0 );
+            // add the points where the edge crosses either plane of the slab
+            for ( Float plane : { lo, hi } ) {
+                if ( ( a0 < plane && a1 > plane ) || ( a0 > plane && a1 < plane ) ) {
+                    Point3f p = Lerp( ( plane - a0 ) / ( a1 - a0 ), p0, p1 );
+                    p[ axis ] = plane;
+                    clipped = Union( clipped, p );
+                }
+            }
+        }
+    } else
+        clipped = refBounds;
+
+    // earlier splits may already have cut the reference
+    Bounds3f slab = refBounds;
+    slab.pMin[ axis ] = std::max( slab.pMin[ axis ], lo );
+    slab.pMax[ axis ] = std::min( slab.pMax[ axis ], hi );
+    return Intersect( clipped, slab );
+}
+
+// The cheapest split of refs by a plane perpendicular to axis, at one of the boundaries between
+// SpatialSplitBins equal bins spanning bounds. References that straddle the plane go to both
+// sides, clipped.
+struct SpatialSplit
+{
+    Float cost;
+    Float position;
+};
+
+static SpatialSplit FindSpatialSplit( const std::vector< BVHPrimitive >& primitives,
+                                      const std::vector< BVHPrimitiveInfo >& refs,
+                                      const Bounds3f& bounds, int axis )
+{
+    struct BinInfo
+    {
+        int entries = 0, exits = 0;
+        Bounds3f bounds;
+    };
+    BinInfo bins[ SpatialSplitBins ];
+    Float origin = bounds.pMin[ axis ];
+    Float binWidth = ( bounds.pMax[ axis ] - origin ) / SpatialSplitBins;
+    auto binIndex = [&]( Float p ) {
+        return Clamp( ( int )( ( p - origin ) / binWidth ), 0, SpatialSplitBins - 1 );
+    };
+
+    // clip every reference to each bin it overlaps; count where it enters and where it leaves
+    for ( const BVHPrimitiveInfo& ref : refs ) {
+        int first = binIndex( ref.bounds.pMin[ axis ] ), last = binIndex( ref.bounds.pMax[ axis ] );
+        for ( int b = first; b <= last; ++b ) {
+            Float lo = b == first ? ref.bounds.pMin[ axis ] : origin + b * binWidth;
+            Float hi = b == last ? ref.bounds.pMax[ axis ] : origin + ( b + 1 ) * binWidth;
+            Bounds3f clipped =
+              ClipReference( primitives[ ref.primitiveNumber ], ref.bounds, axis, lo, hi );
+            if ( !IsEmpty( clipped ) )
+                bins[ b ].bounds = Union( bins[ b ].bounds, clipped );
+        }
+        bins[ first ].entries++;
+        bins[ last ].exits++;
+    }
+
+    // sweep as for the object split: a reference is on the left of the plane after bin i if it
+    // enters at or before i, and on the right if it leaves after i
+    Float cost[ SpatialSplitBins - 1 ];
+    Bounds3f b0;
+    int count0 = 0;
+    for ( int i = 0; i < SpatialSplitBins - 1; ++i ) {
+        b0 = Union( b0, bins[ i ].bounds );
+        count0 += bins[ i ].entries;
+        cost[ i ] = count0 > 0 ? count0 * b0.SurfaceArea() : 0;
+    }
+    Bounds3f b1;
+    int count1 = 0;
+    Float invArea = 1 / bounds.SurfaceArea();
+    for ( int i = SpatialSplitBins - 1; i > 0; --i ) {
+        b1 = Union( b1, bins[ i ].bounds );
+        count1 += bins[ i ].exits;
+        Float cost1 = count1 > 0 ? count1 * b1.SurfaceArea() : 0;
+        cost[ i - 1 ] = 1 + ( cost[ i - 1 ] + cost1 ) * invArea;
+    }
+
+    int best = 0;
+    for ( int i = 1; i < SpatialSplitBins - 1; ++i )
+        if ( cost[ i ] < cost[ best ] )
+            best = i;
+    return SpatialSplit{ cost[ best ], origin + ( best + 1 ) * binWidth };
+}
+
+BVHBuildNode* BVHAccel::recursiveBuildSBVH( BVHBuildState& state,
+                                            std::vector< BVHPrimitiveInfo >& refs, int depth )
+{
+    BVHBuildNode* node = ARENA_ALLOC( state.arenas[ ThreadIndex ], BVHBuildNode )();
+    ++state.totalNodes;
+
+    // compute bounds of all references and of their centroids in BVH node
+    int nRefs = static_cast< int >( refs.size() );
+    Bounds3f bounds, centroidBounds;
+    ComputeRangeBounds( refs, 0, nRefs, &bounds, &centroidBounds );
+
+    auto createLeaf = [&]() {
+        int firstPrimOffset = state.orderedPrimsOffset.fetch_add( nRefs );
+        for ( int i = 0; i < nRefs; ++i )
+            state.orderedPrims[ firstPrimOffset + i ] = primitives[ refs[ i ].primitiveNumber ];
+        node->InitLeaf( firstPrimOffset, nRefs, bounds );
+        return node;
+    };
+    if ( nRefs == 1 )
+        return createLeaf();
+
+    // find the best object split, unless all centroids coincide or the tree is getting too deep
+    // (which also rules out spatial splits below)
+    int dim = centroidBounds.MaximumExtent();
+    bool useSAH = CanSplitBySAH( depth, nRefs );
+    bool haveObjectSplit = useSAH && centroidBounds.pMax[ dim ] > centroidBounds.pMin[ dim ];
+    ObjectSplit objectSplit;
+    if ( haveObjectSplit )
+        objectSplit = FindObjectSplit( refs, 0, nRefs, bounds, centroidBounds, dim );
+
+    // try a spatial split where the object split's children overlap significantly
+    int spatialAxis = bounds.MaximumExtent();
+    bool haveSpatialSplit = false;
+    SpatialSplit spatialSplit;
+    if ( useSAH && state.duplicationBudget > 0 &&
+         bounds.pMax[ spatialAxis ] > bounds.pMin[ spatialAxis ] ) {
+        Bounds3f overlap = bounds;
+        if ( haveObjectSplit )
+            overlap = pbrt::Intersect( objectSplit.bounds[ 0 ], objectSplit.bounds[ 1 ] );
+        if ( !IsEmpty( overlap ) &&
+             overlap.SurfaceArea() > SpatialSplitAlpha * state.rootSurfaceArea ) {
+            spatialSplit = FindSpatialSplit( primitives, refs, bounds, spatialAxis );
+            haveSpatialSplit = !haveObjectSplit || spatialSplit.cost < objectSplit.cost;
+        }
+    }
+
+    // either create leaf or split references
+    Float leafCost = nRefs;
+    Float splitCost = haveSpatialSplit ? spatialSplit.cost
+                                       : haveObjectSplit ? objectSplit.cost : Infinity;
+    if ( nRefs <= maxPrimsInNode && splitCost >= leafCost )
+        return createLeaf();
+
+    std::vector< BVHPrimitiveInfo > refs0, refs1;
+    int axis = dim;
+    if ( haveSpatialSplit ) {
+        // references that straddle the plane are clipped to both sides
+        Float position = spatialSplit.position;
+        for ( const BVHPrimitiveInfo& ref : refs ) {
+            if ( ref.bounds.pMax[ spatialAxis ] <= position )
+                refs0.push_back( ref );
+            else if ( ref.bounds.pMin[ spatialAxis ] >= position )
+                refs1.push_back( ref );
+            else {
+                const BVHPrimitive& prim = primitives[ ref.primitiveNumber ];
+                Bounds3f b0 = ClipReference( prim, ref.bounds, spatialAxis, -Infinity, position );
+                Bounds3f b1 = ClipReference( prim, ref.bounds, spatialAxis, position, Infinity );
+                if ( IsEmpty( b0 ) && IsEmpty( b1 ) )
+                    b1 = ref.bounds;
+                if ( !IsEmpty( b0 ) )
+                    refs0.push_back( BVHPrimitiveInfo( ref.primitiveNumber, b0 ) );
+                if ( !IsEmpty( b1 ) )
+                    refs1.push_back( BVHPrimitiveInfo( ref.primitiveNumber, b1 ) );
+            }
+        }
+
+        // take the new references out of the budget; give up on the spatial split if it
+        // would be exceeded, or if the split didn't separate anything after all
+        int nDuplicates = static_cast< int >( refs0.size() + refs1.size() ) - nRefs;
+        bool separated = !refs0.empty() && !refs1.empty();
+        bool accepted =
+          separated && state.duplicationBudget.fetch_sub( nDuplicates ) >= nDuplicates;
+        if ( separated && !accepted )
+            state.duplicationBudget += nDuplicates;
+        if ( !accepted ) {
+            refs0.clear();
+            refs1.clear();
+            haveSpatialSplit = false;
+            if ( nRefs <= maxPrimsInNode && ( !haveObjectSplit || objectSplit.cost >= leafCost ) )
+                return createLeaf();
+        } else
+            axis = spatialAxis;
+    }
+    if ( !haveSpatialSplit ) {
+        if ( haveObjectSplit ) {
+            for ( const BVHPrimitiveInfo& ref : refs )
+                ( SAHBucket( centroidBounds, dim, ref ) <= objectSplit.bucket ? refs0 : refs1 )
+                  .push_back( ref );
+        }
+        // fall back to equal counts when the buckets don't separate anything
+        if ( refs0.empty() || refs1.empty() ) {
+            int mid = nRefs / 2;
+            std::nth_element( refs.begin(), refs.begin() + mid, refs.end(),
+                              [dim]( const BVHPrimitiveInfo& a, const BVHPrimitiveInfo& b ) {
+                                  return a.centroid[ dim ] < b.centroid[ dim ];
+                              } );
+            refs0.assign( refs.begin(), refs.begin() + mid );
+            refs1.assign( refs.begin() + mid, refs.end() );
+        }
+    }
+    std::vector< BVHPrimitiveInfo >().swap( refs );
+
+    // build the two children, concurrently for large ranges
+    BVHBuildNode* children[ 2 ];
+    if ( nRefs >= ParallelBuildThreshold )
+        ParallelFor(
+          [&]( int64_t i ) {
+              children[ i ] = recursiveBuildSBVH( state, i == 0 ? refs0 : refs1, depth + 1 );
+          },
+          2 );
+    else {
+        children[ 0 ] = recursiveBuildSBVH( state, refs0, depth + 1 );
+        children[ 1 ] = recursiveBuildSBVH( state, refs1, depth + 1 );
+    }
+    node->InitInterior( axis, children[ 0 ], children[ 1 ] );
+    return node;
+}
+
+// HLBVH (Pantaleoni and Luebke): primitives are sorted by the 30-bit Morton code of their
+// centroid. Runs sharing the top 12 bits become treelets, built independently by splitting on
+// the remaining bits; the treelets are then joined with a SAH build over their bounds.
+struct MortonPrimitive
+{
+    int primitiveIndex;
+    uint32_t mortonCode;
+};
+
+static PBRT_CONSTEXPR int MortonBits = 10;
+static PBRT_CONSTEXPR int TreeletBits = 12;
+
+// Least significant digit radix sort by mortonCode, 6 bits per pass. Each pass counts digits
+// per chunk in parallel, turns the counts into per-chunk output offsets, and scatters the chunks
+// in parallel, which keeps every pass stable.
+static void RadixSort( std::vector< MortonPrimitive >* v )
+{
+    PBRT_CONSTEXPR int bitsPerPass = 6;
+    PBRT_CONSTEXPR int nBits = 3 * MortonBits;
+    PBRT_CONSTEXPR int nPasses = nBits / bitsPerPass;
+    PBRT_CONSTEXPR int nBuckets = 1 << bitsPerPass;
+    PBRT_CONSTEXPR int bitMask = nBuckets - 1;
+
+    int n = static_cast< int >( v->size() );
+    const int chunkSize = ParallelBuildThreshold / 4;
+    int nChunks = std::max( 1, ( n + chunkSize - 1 ) / chunkSize );
+    std::vector< MortonPrimitive > tempVector( n );
+    std::vector< int > chunkOffsets( nChunks * nBuckets );
+    for ( int pass = 0; pass < nPasses; ++pass ) {
+        int lowBit = pass * bitsPerPass;
+        const std::vector< MortonPrimitive >& in = ( pass & 1 ) ? tempVector : *v;
+        std::vector< MortonPrimitive >& out = ( pass & 1 ) ? *v : tempVector;
+
+        // count the number of zero bits in array for current radix sort bit
+        ParallelFor(
+          [&]( int64_t c ) {
+              int* counts = &chunkOffsets[ c * nBuckets ];
+              std::fill( counts, counts + nBuckets, 0 );
+              int chunkEnd = std::min( n, ( int )( c + 1 ) * chunkSize );
+              for ( int i = ( int )c * chunkSize; i < chunkEnd; ++i )
+                  ++counts[ ( in[ i ].mortonCode >> lowBit ) & bitMask ];
+          },
+          nChunks );
+
+        // compute starting index in output array for each bucket of each chunk
+        int offset = 0;
+        for ( int b = 0; b < nBuckets; ++b )
+            for ( int c = 0; c < nChunks; ++c ) {
+                int count = chunkOffsets[ c * nBuckets + b ];
+                chunkOffsets[ c * nBuckets + b ] = offset;
+                offset += count;
+            }
+
+        // store sorted values in output array
+        ParallelFor(
+          [&]( int64_t c ) {
+              int* offsets = &chunkOffsets[ c * nBuckets ];
+              int chunkEnd = std::min( n, ( int )( c + 1 ) * chunkSize );
+              for ( int i = ( int )c * chunkSize; i < chunkEnd; ++i )
+                  out[ offsets[ ( in[ i ].mortonCode >> lowBit ) & bitMask ]++ ] = in[ i ];
+          },
+          nChunks );
+    }
+    // copy final result from tempVector, if needed
+    if ( nPasses & 1 )
+        std::swap( *v, tempVector );
+}
+
+BVHBuildNode* BVHAccel::HLBVHBuild( BVHBuildState& state )
+{
+    int nPrimitives = static_cast< int >( state.primitiveInfo.size() );
+
+    // compute bounding box of all primitive centroids
+    Bounds3f bounds, centroidBounds;
+    ComputeRangeBounds( state.primitiveInfo, 0, nPrimitives, &bounds, &centroidBounds );
+
+    // compute Morton indices of primitives
+    std::vector< MortonPrimitive > mortonPrims( nPrimitives );
+    ParallelFor(
+      [&]( int64_t i ) {
+          PBRT_CONSTEXPR int mortonScale = 1 << MortonBits;
+          mortonPrims[ i ].primitiveIndex = state.primitiveInfo[ i ].primitiveNumber;
+          Vector3f centroidOffset = centroidBounds.Offset( state.primitiveInfo[ i ].centroid );
+          mortonPrims[ i ].mortonCode = EncodeMorton3( centroidOffset * mortonScale );
+      },
+      nPrimitives, 512 );
+
+    // radix sort primitive Morton indices
+    RadixSort( &mortonPrims );
+
+    // find intervals of primitives for each treelet
+    PBRT_CONSTEXPR int treeletShift = 3 * MortonBits - TreeletBits;
+    std::vector< std::pair< int, int > > treelets;
+    for ( int start = 0, end = 1; end <= nPrimitives; ++end ) {
+        if ( end == nPrimitives || ( mortonPrims[ start ].mortonCode >> treeletShift ) !=
+                                     ( mortonPrims[ end ].mortonCode >> treeletShift ) ) {
+            treelets.push_back( std::make_pair( start, end - start ) );
+            start = end;
+        }
+    }
+
+    // create LBVHs for treelets in parallel
+    std::vector< BVHBuildNode* > treeletRoots( treelets.size() );
+    std::vector< int > treeletHeights( treelets.size() );
+    ParallelFor(
+      [&]( int64_t i ) {
+          treeletRoots[ i ] = emitLBVH( state, &mortonPrims[ treelets[ i ].first ],
+                                        treelets[ i ].second, treeletShift - 1,
+                                        &treeletHeights[ i ] );
+      },
+      treelets.size() );
+
+    // create and return SAH BVH from LBVH treelets
+    std::vector< BVHPrimitiveInfo > treeletInfo( treeletRoots.size() );
+    for ( size_t i = 0; i < treeletRoots.size(); ++i )
+        treeletInfo[ i ] = BVHPrimitiveInfo( static_cast< int >( i ), treeletRoots[ i ]->bounds );
+    // the upper tree is built as if every treelet were as tall as the tallest one, which keeps
+    // the whole tree within MaxBVHDepth
+    int maxTreeletHeight = *std::max_element( treeletHeights.begin(), treeletHeights.end() );
+    return buildUpperSAH( state, treeletRoots, treeletInfo, 0,
+                          static_cast< int >( treeletInfo.size() ), maxTreeletHeight );
+}
+
+BVHBuildNode* BVHAccel::emitLBVH( BVHBuildState& state, const MortonPrimitive* mortonPrims,
+                                  int nPrimitives, int bitIndex, int* height )
+{
+    BVHBuildNode* node = ARENA_ALLOC( state.arenas[ ThreadIndex ], BVHBuildNode )();
+    ++state.totalNodes;
+    if ( nPrimitives <= maxPrimsInNode ) {
+        // create and return leaf node of LBVH treelet
+        Bounds3f bounds;
+        int firstPrimOffset = state.orderedPrimsOffset.fetch_add( nPrimitives );
+        for ( int i = 0; i < nPrimitives; ++i ) {
+            int primitiveIndex = mortonPrims[ i ].primitiveIndex;
+            state.orderedPrims[ firstPrimOffset + i ] = primitives[ primitiveIndex ];
+            bounds = Union( bounds, state.primitiveInfo[ primitiveIndex ].bounds );
+        }
+        node->InitLeaf( firstPrimOffset, nPrimitives, bounds );
+        *height = 0;
+        return node;
+    }
+
+    // advance to the first bit that separates the primitives; once the codes are exhausted,
+    // identical codes are simply split in half
+    int mask = 0;
+    for ( ; bitIndex >= 0; --bitIndex ) {
+        mask = 1 << bitIndex;
+        if ( ( mortonPrims[ 0 ].mortonCode & mask ) !=
+             ( mortonPrims[ nPrimitives - 1 ].mortonCode & mask ) )
+            break;
+    }
+    int splitOffset = nPrimitives / 2;
+    if ( bitIndex >= 0 ) {
+        // find LBVH split point for this dimension
+        int searchStart = 0, searchEnd = nPrimitives - 1;
+        while ( searchStart + 1 != searchEnd ) {
+            int mid = ( searchStart + searchEnd ) / 2;
+            if ( ( mortonPrims[ searchStart ].mortonCode & mask ) ==
+                 ( mortonPrims[ mid ].mortonCode & mask ) )
+                searchStart = mid;
+            else
+                searchEnd = mid;
+        }
+        splitOffset = searchEnd;
+    }
+
+    // create and return interior LBVH node
+    int heights[ 2 ];
+    BVHBuildNode* lbvh[ 2 ] = {
+        emitLBVH( state, mortonPrims, splitOffset, bitIndex - 1, &heights[ 0 ] ),
+        emitLBVH( state, &mortonPrims[ splitOffset ], nPrimitives - splitOffset, bitIndex - 1,
+                  &heights[ 1 ] )
+    };
+    node->InitInterior( bitIndex >= 0 ? bitIndex % 3 : 0, lbvh[ 0 ], lbvh[ 1 ] );
+    *height = 1 + std::max( heights[ 0 ], heights[ 1 ] );
+    return node;
+}
+
+BVHBuildNode* BVHAccel::buildUpperSAH( BVHBuildState& state,
+                                       const std::vector< BVHBuildNode* >& treeletRoots,
+                                       std::vector< BVHPrimitiveInfo >& treeletInfo, int start,
+                                       int end, int depth )
+{
+    if ( end - start == 1 )
+        return treeletRoots[ treeletInfo[ start ].primitiveNumber ];
+    BVHBuildNode* node = ARENA_ALLOC( state.arenas[ ThreadIndex ], BVHBuildNode )();
+    ++state.totalNodes;
+
+    // split the treelets as in recursiveBuild, never creating leaves
+    Bounds3f bounds, centroidBounds;
+    ComputeRangeBounds( treeletInfo, start, end, &bounds, &centroidBounds );
+    int dim = centroidBounds.MaximumExtent();
+    int mid = start;
+    if ( centroidBounds.pMax[ dim ] > centroidBounds.pMin[ dim ] &&
+         CanSplitBySAH( depth, end - start ) ) {
+        ObjectSplit split =
+          FindObjectSplit( treeletInfo, start, end, bounds, centroidBounds, dim );
+        BVHPrimitiveInfo* pmid =
+          std::partition( &treeletInfo[ start ], &treeletInfo[ end - 1 ] + 1,
+                          [&]( const BVHPrimitiveInfo& pi ) {
+                              return SAHBucket( centroidBounds, dim, pi ) <= split.bucket;
+                          } );
+        mid = static_cast< int >( pmid - &treeletInfo[ 0 ] );
+    }
+    if ( mid == start || mid == end ) {
+        mid = ( start + end ) / 2;
+        std::nth_element( &treeletInfo[ start ], &treeletInfo[ mid ],
+                          &treeletInfo[ end - 1 ] + 1,
+                          [dim]( const BVHPrimitiveInfo& a, const BVHPrimitiveInfo& b ) {
+                              return a.centroid[ dim ] < b.centroid[ dim ];
+                          } );
+    }
+    node->InitInterior( dim,
+                        buildUpperSAH( state, treeletRoots, treeletInfo, start, mid, depth + 1 ),
+                        buildUpperSAH( state, treeletRoots, treeletInfo, mid, end, depth + 1 ) );
+    return node;
+}
+
+int BVHAccel::flattenBVHTree( BVHBuildNode* node, int* offset )
+{
+    LinearBVHNode* linearNode = &nodes[ *offset ];
+    linearNode->bounds = node->bounds;
+    int myOffset = ( *offset )++;
+    if ( node->nPrimitives > 0 ) {
+        linearNode->primitivesOffset = node->firstPrimOffset;
+        linearNode->nPrimitives = node->nPrimitives;
+    } else {
+        // create interior flattened BVH node
+        linearNode->axis = node->splitAxis;
+        linearNode->nPrimitives = 0;
+        flattenBVHTree( node->children[ 0 ], offset );
+        linearNode->secondChildOffset = flattenBVHTree( node->children[ 1 ], offset );
+    }
+    return myOffset;
+}
+
+// Node bounds for traversal: StaticNodeBounds reads the node itself; MotionNodeBounds interpolates
+// a motion BVH's per-node keys to the ray's time.
+struct StaticNodeBounds
+{
+    const LinearBVHNode* nodes;
+
+    const Bounds3f& operator()( int nodeIndex ) const { return nodes[ nodeIndex ].bounds; }
+};
+
+struct MotionNodeBounds
+{
+    const Bounds3f* keys;
+    int nKeys, segment;
+    Float t;
+
+    MotionNodeBounds( const Bounds3f* timeBounds, int nTimeSegments, Float time0, Float time1,
+                      Float time )
+    : keys{ timeBounds }, nKeys{ nTimeSegments + 1 }
+    {
+        Float u = Clamp( ( time - time0 ) / ( time1 - time0 ), 0, 1 ) * nTimeSegments;
+        segment = std::min( ( int )u, nTimeSegments - 1 );
+        t = u - segment;
+    }
+    Bounds3f operator()( int nodeIndex ) const
+    {
+        const Bounds3f* k = &keys[ nodeIndex * nKeys + segment ];
+        Bounds3f b;
+        b.pMin = Lerp( t, k[ 0 ].pMin, k[ 1 ].pMin );
+        b.pMax = Lerp( t, k[ 0 ].pMax, k[ 1 ].pMax );
+        return b;
+    }
+};
+
+template < typename NodeBounds >
+bool BVHAccel::intersect( const Ray& ray, SurfaceInteraction* isect, const NodeBounds& nodeBounds,
+                          int rootIndex ) const
+{
+    RayPrecomputed pre( ray );
+
+    // the closest triangle's SurfaceInteraction is only built once traversal is done; other
+    // shapes fill in isect directly when they are hit
+    TriangleHit hit, closestHit;
+    const BVHPrimitive* closestTriangle = nullptr;
+    bool hitAnything = false;
+    BVHMailbox mailbox;
+    bool useMailbox = splitMethod == SplitMethod::SBVH;
+
+    // follow ray through BVH nodes to find primitive intersections
+    int toVisitOffset = 0, currentNodeIndex = rootIndex;
+    int nodesToVisit[ MaxBVHDepth ];
+    while ( true ) {
+        const LinearBVHNode* node = &nodes[ currentNodeIndex ];
+        if ( nodeBounds( currentNodeIndex ).IntersectP( ray, pre ) ) {
+            if ( node->nPrimitives > 0 ) {
+                // intersect ray with primitives in leaf BVH node
+                for ( int i = 0; i < node->nPrimitives; ++i ) {
+                    const BVHPrimitive& prim = primitives[ node->primitivesOffset + i ];
+                    if ( useMailbox && mailbox.Visit( prim ) )
+                        continue;
+                    if ( prim.mesh ) {
+                        if ( prim.mesh->IntersectTriangle( prim.triIndex, ray, pre, &hit ) ) {
+                            ray.tMax = hit.t;
+                            closestHit = hit;
+                            closestTriangle = &prim;
+                            hitAnything = true;
+                        }
+                    } else {
+                        Float tHit;
+                        if ( prim.shape->Intersect( ray, &tHit, isect ) ) {
+                            ray.tMax = tHit;
+                            closestTriangle = nullptr;
+                            hitAnything = true;
+                        }
+                    }
+                }
+                if ( toVisitOffset == 0 )
+                    break;
+                currentNodeIndex = nodesToVisit[ --toVisitOffset ];
+            } else {
+                // put far BVH node on nodesToVisit stack, advance to near node
+                CHECK_LT( toVisitOffset, MaxBVHDepth );
+                if ( pre.dirIsNeg[ node->axis ] ) {
+                    nodesToVisit[ toVisitOffset++ ] = currentNodeIndex + 1;
+                    currentNodeIndex = node->secondChildOffset;
+                } else {
+                    nodesToVisit[ toVisitOffset++ ] = node->secondChildOffset;
+                    currentNodeIndex = currentNodeIndex + 1;
+                }
+            }
+        } else {
+            if ( toVisitOffset == 0 )
+                break;
+            currentNodeIndex = nodesToVisit[ --toVisitOffset ];
+        }
+    }
+    if ( closestTriangle )
+        closestTriangle->mesh->ComputeSurfaceInteraction( *closestTriangle->shape, ray,
+                                                          closestHit, isect );
+    return hitAnything;
+}
+
+template < typename NodeBounds >
+bool BVHAccel::intersectP( const Ray& ray, const NodeBounds& nodeBounds, int rootIndex,
+                           BVHPrimitive* occluder ) const
+{
+    RayPrecomputed pre( ray );
+
+    // any hit will do, so the first one found ends traversal
+    TriangleHit hit;
+    BVHMailbox mailbox;
+    bool useMailbox = splitMethod == SplitMethod::SBVH;
+    int toVisitOffset = 0, currentNodeIndex = rootIndex;
+    int nodesToVisit[ MaxBVHDepth ];
+    while ( true ) {
+        const LinearBVHNode* node = &nodes[ currentNodeIndex ];
+        if ( nodeBounds( currentNodeIndex ).IntersectP( ray, pre ) ) {
+            if ( node->nPrimitives > 0 ) {
+                for ( int i = 0; i < node->nPrimitives; ++i ) {
+                    const BVHPrimitive& prim = primitives[ node->primitivesOffset + i ];
+                    if ( useMailbox && mailbox.Visit( prim ) )
+                        continue;
+                    if ( prim.mesh ? prim.mesh->IntersectTriangle( prim.triIndex, ray, pre, &hit )
+                                   : prim.shape->IntersectP( ray ) ) {
+                        if ( occluder )
+                            *occluder = prim;
+                        return true;
+                    }
+                }
+                if ( toVisitOffset == 0 )
+                    break;
+                currentNodeIndex = nodesToVisit[ --toVisitOffset ];
+            } else {
+                CHECK_LT( toVisitOffset, MaxBVHDepth );
+                if ( pre.dirIsNeg[ node->axis ] ) {
+                    nodesToVisit[ toVisitOffset++ ] = currentNodeIndex + 1;
+                    currentNodeIndex = node->secondChildOffset;
+                } else {
+                    nodesToVisit[ toVisitOffset++ ] = node->secondChildOffset;
+                    currentNodeIndex = currentNodeIndex + 1;
+                }
+            }
+        } else {
+            if ( toVisitOffset == 0 )
+                break;
+            currentNodeIndex = nodesToVisit[ --toVisitOffset ];
+        }
+    }
+    return false;
+}
+
+bool BVHAccel::Intersect( const Ray& ray, SurfaceInteraction* isect ) const
+{
+    if ( !nodes )
+        return false;
+    ProfilePhase _( Prof::AccelIntersect );
+    if ( timeBounds )
+        return intersect( ray, isect,
+                          MotionNodeBounds( timeBounds, nTimeSegments, time0, time1, ray.time ),
+                          0 );
+    return intersect( ray, isect, StaticNodeBounds{ nodes }, 0 );
+}
+
+bool BVHAccel::IntersectP( const Ray& ray ) const { return IntersectP( ray, nullptr ); }
+
+bool BVHAccel::IntersectP( const Ray& ray, BVHPrimitive* occluder ) const
+{
+    if ( !nodes )
+        return false;
+    ProfilePhase _( Prof::AccelIntersectP );
+    if ( timeBounds )
+        return intersectP(
+          ray, MotionNodeBounds( timeBounds, nTimeSegments, time0, time1, ray.time ), 0,
+          occluder );
+    return intersectP( ray, StaticNodeBounds{ nodes }, 0, occluder );
+}
+
+bool BVHAccel::intersectSubtree( const Ray& ray, SurfaceInteraction* isect, int rootIndex ) const
+{
+    return intersect( ray, isect, StaticNodeBounds{ nodes }, rootIndex );
+}
+
+bool BVHAccel::intersectSubtreeP( const Ray& ray, int rootIndex ) const
+{
+    return intersectP( ray, StaticNodeBounds{ nodes }, rootIndex, nullptr );
+}
+
+} /* namespace pbrt */
@@ -0,0 +1,163 @@
+//
+//  bvh.hpp
+//  pbrt3
+//
+//  Created by Ilya Rostovtsev on 10/17/26.
+//  Copyright © 2017 Ilya Rostovtsev. All rights reserved.
+//
+
+#ifndef bvh_hpp
+#define bvh_hpp
+
+#include "geometry.hpp"
+#include "pbrt.hpp"
+#include "shape.hpp"
+
+namespace pbrt {
+
+struct TriangleMesh;
+struct BVHBuildNode;
+struct BVHBuildState;
+struct BVHPrimitiveInfo;
+struct MortonPrimitive;
+
+// Size of the traversal stacks: the builders keep every leaf less than MaxBVHDepth levels deep.
+static PBRT_CONSTEXPR int MaxBVHDepth = 64;
+
+// What a BVH leaf refers to: one triangle of a TriangleMeshShape (mesh != nullptr), or any other
+// Shape as a whole.
+struct BVHPrimitive
+{
+    const Shape* shape;
+    const TriangleMesh* mesh;
+    int triIndex;
+
+    bool IntersectP( const Ray& ray ) const;
+};
+
+// 32 bytes, so the cache-line-aligned node array holds exactly two per line; the first child of an
+// interior node always directly follows it.
+struct
+#ifdef PBRT_HAVE_ALIGNAS
+  alignas( 32 )
+#endif // PBRT_HAVE_ALIGNAS
+    LinearBVHNode
+{
+    Bounds3f bounds;
+    union {
+        int primitivesOffset;  // leaf
+        int secondChildOffset; // interior
+    };
+    uint16_t nPrimitives; // 0 -> interior node
+    uint8_t axis;         // interior node: xyz
+    uint8_t pad[ 1 ];     // ensure 32 byte total size
+};
+
+class BVHAccel {
+  public:
+    // SBVH adds spatial splits to SAH: primitives that straddle a split plane are clipped and
+    // referenced from both children, within a budget on the number of extra references. HLBVH
+    // sorts primitives along a Morton curve and builds much faster, at some cost in tree quality.
+    enum class SplitMethod { SAH, Middle, EqualCounts, SBVH, HLBVH };
+
+    // With a cacheFilename, the tree is loaded from that file when it was written for the same
+    // geometry and build parameters; otherwise it is built and the file (re)written. The node
+    // array is used straight from the memory-mapped file.
+    BVHAccel( const std::vector< std::shared_ptr< Shape > >& shapes, int maxPrimsInNode = 4,
+              SplitMethod splitMethod = SplitMethod::SAH, const std::string& cacheFilename = "" );
+    // A motion BVH: the tree is built on the primitives' bounds over the whole [time0, time1]
+    // interval, but each node also stores its bounds at nTimeSegments + 1 evenly spaced times,
+    // from Shape::LinearMotionBounds(). Traversal interpolates them to Ray::time, so a fast-moving
+    // primitive is only found where it actually is at that time.
+    BVHAccel( const std::vector< std::shared_ptr< Shape > >& shapes, Float time0, Float time1,
+              int nTimeSegments, int maxPrimsInNode = 4,
+              SplitMethod splitMethod = SplitMethod::SAH, const std::string& cacheFilename = "" );
+    ~BVHAccel();
+
+    Bounds3f WorldBound() const;
+    // on a hit, ray.tMax is shortened to the distance of the closest intersection
+    bool Intersect( const Ray& ray, SurfaceInteraction* isect ) const;
+    bool IntersectP( const Ray& ray ) const;
+    // also reports the primitive that blocked the ray, for OcclusionCache
+    bool IntersectP( const Ray& ray, BVHPrimitive* occluder ) const;
+    // Batched versions for coherent rays (camera rays, shadow rays toward one light): rays are
+    // grouped by direction octant and traced through the tree in packets, with one SIMD slab test
+    // per SimdWidth rays at each node. hits[ i ] and isects[ i ] are what Intersect() or
+    // IntersectP() would return for rays[ i ].
+    void Intersect( const Ray* rays, int nRays, SurfaceInteraction* isects, bool* hits ) const;
+    void IntersectP( const Ray* rays, int nRays, bool* hits ) const;
+    // RayDifferential arrays need overloads of their own: converted to const Ray*, they would be
+    // walked with the wrong stride
+    void Intersect( const RayDifferential* rays, int nRays, SurfaceInteraction* isects,
+                    bool* hits ) const;
+    void IntersectP( const RayDifferential* rays, int nRays, bool* hits ) const;
+
+    // Recomputes node bounds bottom-up from the primitives' current geometry (TriangleMesh::p
+    // updated in place, shapes whose transforms or motion bounds changed, refit instances),
+    // keeping the topology. Once that has degraded the tree's SAH cost too far, the tree is
+    // rebuilt instead; returns true in that case.
+    bool Refit();
+
+  private:
+    friend class WideBVHAccel;
+
+    void buildOrLoad( const std::string& cacheFilename );
+    void build();
+    void expandPrimitives( std::vector< BVHPrimitive >* prims ) const;
+    void finishTree();
+    void freeTree();
+    void uncountTreeMemory();
+    uint64_t geometryHash() const;
+    bool loadCache( const std::string& filename, uint64_t hash );
+    void writeCache( const std::string& filename, uint64_t hash ) const;
+    Bounds3f refitSubtree( int nodeIndex );
+    void computeTimeBounds( int nodeIndex );
+    Float SAHCost() const;
+    template < typename NodeBounds >
+    bool intersect( const Ray& ray, SurfaceInteraction* isect, const NodeBounds& nodeBounds,
+                    int rootIndex ) const;
+    template < typename NodeBounds >
+    bool intersectP( const Ray& ray, const NodeBounds& nodeBounds, int rootIndex,
+                     BVHPrimitive* occluder ) const;
+    template < typename RayType >
+    void intersectPackets( const RayType* rays, int nRays, SurfaceInteraction* isects,
+                           bool* hits ) const;
+    template < typename RayType >
+    void intersectPacketsP( const RayType* rays, int nRays, bool* hits ) const;
+    // single-ray traversal of the subtree below rootIndex, for packets that lost coherence
+    bool intersectSubtree( const Ray& ray, SurfaceInteraction* isect, int rootIndex ) const;
+    bool intersectSubtreeP( const Ray& ray, int rootIndex ) const;
+
+    BVHBuildNode* recursiveBuild( BVHBuildState& state, int start, int end, int depth );
+    BVHBuildNode* recursiveBuildSBVH( BVHBuildState& state, std::vector< BVHPrimitiveInfo >& refs,
+                                      int depth );
+    BVHBuildNode* HLBVHBuild( BVHBuildState& state );
+    BVHBuildNode* emitLBVH( BVHBuildState& state, const MortonPrimitive* mortonPrims,
+                            int nPrimitives, int bitIndex, int* height );
+    BVHBuildNode* buildUpperSAH( BVHBuildState& state,
+                                 const std::vector< BVHBuildNode* >& treeletRoots,
+                                 std::vector< BVHPrimitiveInfo >& treeletInfo, int start, int end,
+                                 int depth );
+    int flattenBVHTree( BVHBuildNode* node, int* offset );
+
+    const int maxPrimsInNode;
+    const SplitMethod splitMethod;
+    std::vector< std::shared_ptr< Shape > > shapes;
+    std::vector< BVHPrimitive > primitives;
+    LinearBVHNode* nodes = nullptr;
+    int totalNodes = 0;
+    // this tree's part of the "Memory/BVH tree" stat, added by finishTree() and taken back out by
+    // freeTree()
+    int64_t treeMemory = 0;
+    Float builtSAHCost = 0;
+    // set when nodes points into a loaded cache file rather than an AllocAligned() array
+    void* cacheMapping = nullptr;
+    size_t cacheMappingSize = 0;
+    // motion BVH only: nTimeSegments + 1 bounds per node, stored node by node
+    const Float time0 = 0, time1 = 1;
+    const int nTimeSegments = 0;
+    Bounds3f* timeBounds = nullptr;
+};
+
+} /* namespace pbrt */
+#endif /* bvh_hpp */
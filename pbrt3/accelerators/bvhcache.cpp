@@ -0,0 +1,289 @@
+//
+//  bvhcache.cpp
+//  pbrt3
+//
+//  Created by Ilya Rostovtsev on 10/17/26.
+//  Copyright © 2017 Ilya Rostovtsev. All rights reserved.
+//
+
+#include "bvh.hpp"
+#include "error.hpp"
+#include "memory.hpp"
+#include "stats.hpp"
+#include "trianglemesh.hpp"
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+#ifndef PBRT_IS_WINDOWS
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <atomic>
+#include <process.h>
+#endif // !PBRT_IS_WINDOWS
+
+namespace pbrt {
+
+STAT_COUNTER( "BVH/Trees loaded from cache", cacheHits );
+STAT_COUNTER( "BVH/Cache files rebuilt", cacheMisses );
+
+// Bump whenever the layout of LinearBVHNode, the file or the builders' output changes.
+static PBRT_CONSTEXPR uint32_t BVHCacheVersion = 2;
+
+// The file is this header, the LinearBVHNode array at the next cache-line boundary, and then one
+// int32_t per entry of BVHAccel::primitives: its index in the order expandPrimitives() produces.
+struct BVHCacheHeader
+{
+    char magic[ 8 ];
+    uint64_t hash;
+    uint32_t version, nodeSize;
+    int32_t totalNodes, nPrimitives;
+    uint64_t nodesOffset, primitivesOffset, fileSize;
+};
+
+static const char BVHCacheMagic[ 8 ] = { 'p', 'b', 'r', 't', 'B', 'V', 'H', '\0' };
+
+uint64_t BVHAccel::geometryHash() const
+{
+    // the tree only depends on the build parameters and on primitive bounds, so meshes are hashed
+    // by their (world-space) vertices and other shapes by their bounds
+    uint64_t params[] = { BVHCacheVersion, sizeof( Float ), sizeof( LinearBVHNode ),
+                          ( uint64_t )maxPrimsInNode, ( uint64_t )splitMethod, shapes.size() };
+    uint64_t h = HashBytes( params, sizeof( params ), 0 );
+    for ( const auto& shape : shapes ) {
+        if ( auto meshShape = dynamic_cast< const TriangleMeshShape* >( shape.get() ) ) {
+            const TriangleMesh* mesh = meshShape->mesh.get();
+            h = HashBytes( mesh->vertexIndices.data(), mesh->vertexIndices.size() * sizeof( int ),
+                           h );
+            h = HashBytes( mesh->p.get(), mesh->nVertices * sizeof( Point3f ), h );
+        } else {
+            Bounds3f bounds = shape->WorldBound();
+            h = HashBytes( &bounds, sizeof( bounds ), h );
+        }
+    }
+    return h;
+}
+
+// Maps the whole file privately, so Refit() can still write to the nodes (copy-on-write);
+// Windows builds read it into memory instead.
+static void* MapFile( const std::string& filename, size_t* size )
+{
+#ifdef PBRT_IS_WINDOWS
+    FILE* f = fopen( filename.c_str(), "rb" );
+    if ( !f )
+        return nullptr;
+    _fseeki64( f, 0, SEEK_END );
+    *size = ( size_t )_ftelli64( f );
+    _fseeki64( f, 0, SEEK_SET );
+    void* data = *size > 0 ? AllocAligned( *size ) : nullptr;
+    if ( data && fread( data, 1, *size, f ) != *size ) {
+        FreeAligned( data );
+        data = nullptr;
+    }
+    fclose( f );
+    return data;
+#else
+    int fd = open( filename.c_str(), O_RDONLY );
+    if ( fd < 0 )
+        return nullptr;
+    struct stat st;
+    void* data = nullptr;
+    if ( fstat( fd, &st ) == 0 && st.st_size > 0 ) {
+        *size = ( size_t )st.st_size;
+        data = mmap( nullptr, *size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0 );
+        if ( data == MAP_FAILED )
+            data = nullptr;
+    }
+    close( fd );
+    return data;
+#endif // !PBRT_IS_WINDOWS
+}
+
+// Creates a new file next to filename and opens it for writing. Every call gets a file of its own,
+// so concurrent writers of the same cache never share one.
+static FILE* CreateTempFile( const std::string& filename, std::string* tempFilename )
+{
+#ifdef PBRT_IS_WINDOWS
+    static std::atomic< int > counter{ 0 };
+    *tempFilename = filename + "." + std::to_string( _getpid() ) + "." +
+                    std::to_string( counter++ ) + ".tmp";
+    return fopen( tempFilename->c_str(), "wb" );
+#else
+    std::vector< char > name( filename.begin(), filename.end() );
+    const char suffix[] = ".XXXXXX";
+    name.insert( name.end(), suffix, suffix + sizeof( suffix ) );
+    int fd = mkstemp( name.data() );
+    if ( fd < 0 )
+        return nullptr;
+    *tempFilename = name.data();
+    // mkstemp() creates the file readable by its owner only
+    fchmod( fd, 0644 );
+    FILE* f = fdopen( fd, "wb" );
+    if ( !f ) {
+        close( fd );
+        std::remove( tempFilename->c_str() );
+    }
+    return f;
+#endif // !PBRT_IS_WINDOWS
+}
+
+static void UnmapFile( void* data, size_t size )
+{
+#ifdef PBRT_IS_WINDOWS
+    FreeAligned( data );
+#else
+    munmap( data, size );
+#endif // !PBRT_IS_WINDOWS
+}
+
+void BVHAccel::freeTree()
+{
+    if ( cacheMapping )
+        UnmapFile( cacheMapping, cacheMappingSize );
+    else
+        FreeAligned( nodes );
+    FreeAligned( timeBounds );
+    uncountTreeMemory();
+    cacheMapping = nullptr;
+    cacheMappingSize = 0;
+    nodes = nullptr;
+    timeBounds = nullptr;
+    totalNodes = 0;
+}
+
+bool BVHAccel::loadCache( const std::string& filename, uint64_t hash )
+{
+    ProfilePhase _( Prof::AccelConstruction );
+    size_t size = 0;
+    char* data = static_cast< char* >( MapFile( filename, &size ) );
+    if ( !data ) {
+        ++cacheMisses;
+        return false;
+    }
+
+    // only trust the file if it was written for this geometry and is complete
+    BVHCacheHeader header;
+    bool valid = size >= sizeof( header );
+    if ( valid ) {
+        std::memcpy( &header, data, sizeof( header ) );
+        valid = std::memcmp( header.magic, BVHCacheMagic, sizeof( BVHCacheMagic ) ) == 0 &&
+                header.version == BVHCacheVersion && header.hash == hash &&
+                header.nodeSize == sizeof( LinearBVHNode ) && header.fileSize == size &&
+                header.totalNodes > 0 && header.nPrimitives > 0 &&
+                header.nodesOffset % PBRT_L1_CACHE_LINE_SIZE == 0 &&
+                header.primitivesOffset ==
+                  header.nodesOffset + ( uint64_t )header.totalNodes * sizeof( LinearBVHNode ) &&
+                header.fileSize ==
+                  header.primitivesOffset + ( uint64_t )header.nPrimitives * sizeof( int32_t );
+    }
+    if ( valid ) {
+        // a file can match the hash and still be inconsistent; make sure traversal can't leave
+        // the node and primitive arrays or overflow its stack. Children always follow their
+        // parents, so a node's depth is final by the time it is reached.
+        const LinearBVHNode* fileNodes =
+          reinterpret_cast< const LinearBVHNode* >( data + header.nodesOffset );
+        std::vector< uint8_t > depth( header.totalNodes, 0 );
+        for ( int i = 0; i < header.totalNodes && valid; ++i ) {
+            const LinearBVHNode& node = fileNodes[ i ];
+            if ( node.nPrimitives > 0 )
+                valid = node.primitivesOffset >= 0 &&
+                        ( int64_t )node.primitivesOffset + node.nPrimitives <= header.nPrimitives;
+            else {
+                valid = node.secondChildOffset > i && node.secondChildOffset < header.totalNodes &&
+                        node.axis < 3 && depth[ i ] + 1 < MaxBVHDepth;
+                for ( int child : { i + 1, node.secondChildOffset } )
+                    if ( valid )
+                        depth[ child ] = std::max< int >( depth[ child ], depth[ i ] + 1 );
+            }
+        }
+    }
+    std::vector< BVHPrimitive > canonical;
+    if ( valid ) {
+        // BVHPrimitives hold pointers, so they are recreated from the stored indices
+        expandPrimitives( &canonical );
+        const int32_t* primitiveIndices =
+          reinterpret_cast< const int32_t* >( data + header.primitivesOffset );
+        primitives.resize( header.nPrimitives );
+        for ( int i = 0; i < header.nPrimitives && valid; ++i ) {
+            int32_t index = primitiveIndices[ i ];
+            valid = index >= 0 && index < ( int32_t )canonical.size();
+            if ( valid )
+                primitives[ i ] = canonical[ index ];
+        }
+    }
+    if ( !valid ) {
+        UnmapFile( data, size );
+        primitives.clear();
+        ++cacheMisses;
+        return false;
+    }
+
+    cacheMapping = data;
+    cacheMappingSize = size;
+    nodes = reinterpret_cast< LinearBVHNode* >( data + header.nodesOffset );
+    totalNodes = header.totalNodes;
+    finishTree();
+    ++cacheHits;
+    return true;
+}
+
+void BVHAccel::writeCache( const std::string& filename, uint64_t hash ) const
+{
+    if ( !nodes )
+        return;
+    // index of each primitive in expandPrimitives() order
+    std::unordered_map< const Shape*, int32_t > firstPrimitive;
+    int32_t nCanonical = 0;
+    for ( const auto& shape : shapes ) {
+        firstPrimitive.emplace( shape.get(), nCanonical );
+        auto meshShape = dynamic_cast< const TriangleMeshShape* >( shape.get() );
+        nCanonical += meshShape ? meshShape->mesh->nTriangles : 1;
+    }
+    std::vector< int32_t > primitiveIndices( primitives.size() );
+    for ( size_t i = 0; i < primitives.size(); ++i )
+        primitiveIndices[ i ] = firstPrimitive[ primitives[ i ].shape ] +
+                                ( primitives[ i ].mesh ? primitives[ i ].triIndex : 0 );
+
+    BVHCacheHeader header;
+    std::memset( &header, 0, sizeof( header ) );
+    std::memcpy( header.magic, BVHCacheMagic, sizeof( BVHCacheMagic ) );
+    header.hash = hash;
+    header.version = BVHCacheVersion;
+    header.nodeSize = sizeof( LinearBVHNode );
+    header.totalNodes = totalNodes;
+    header.nPrimitives = ( int32_t )primitives.size();
+    header.nodesOffset = ( sizeof( header ) + PBRT_L1_CACHE_LINE_SIZE - 1 ) /
+                         PBRT_L1_CACHE_LINE_SIZE * PBRT_L1_CACHE_LINE_SIZE;
+    header.primitivesOffset = header.nodesOffset + totalNodes * sizeof( LinearBVHNode );
+    header.fileSize = header.primitivesOffset + primitiveIndices.size() * sizeof( int32_t );
+
+    // write to a temporary file of our own and rename it, so concurrent renders never map a
+    // partial or interleaved file
+    std::string tempFilename;
+    FILE* f = CreateTempFile( filename, &tempFilename );
+    if ( !f ) {
+        Warning( "%s: unable to create a temporary BVH cache file", filename.c_str() );
+        return;
+    }
+    char padding[ PBRT_L1_CACHE_LINE_SIZE ] = {};
+    bool ok = fwrite( &header, sizeof( header ), 1, f ) == 1 &&
+              fwrite( padding, 1, header.nodesOffset - sizeof( header ), f ) ==
+                header.nodesOffset - sizeof( header ) &&
+              fwrite( nodes, sizeof( LinearBVHNode ), totalNodes, f ) == ( size_t )totalNodes &&
+              fwrite( primitiveIndices.data(), sizeof( int32_t ), primitiveIndices.size(), f ) ==
+                primitiveIndices.size();
+    ok = fclose( f ) == 0 && ok;
+#ifdef PBRT_IS_WINDOWS
+    // rename() doesn't replace an existing file on Windows
+    if ( ok )
+        std::remove( filename.c_str() );
+#endif // PBRT_IS_WINDOWS
+    if ( !ok || std::rename( tempFilename.c_str(), filename.c_str() ) != 0 ) {
+        Warning( "%s: unable to write BVH cache file", filename.c_str() );
+        std::remove( tempFilename.c_str() );
+    }
+}
+
+} /* namespace pbrt */
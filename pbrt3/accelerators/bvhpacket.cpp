@@ -0,0 +1,314 @@
+//
+//  bvhpacket.cpp
+//  pbrt3
+//
+//  Created by Ilya Rostovtsev on 10/17/26.
+//  Copyright © 2017 Ilya Rostovtsev. All rights reserved.
+//
+
+#include "bvh.hpp"
+#include "interaction.hpp"
+#include "simd.hpp"
+#include "stats.hpp"
+#include "trianglemesh.hpp"
+
+namespace pbrt {
+
+STAT_COUNTER( "BVH/Ray packets", nPackets );
+STAT_COUNTER( "BVH/Packet subtrees finished ray by ray", nPacketFallbacks );
+
+// 16 rays with AVX, 8 with SSE: two SIMD slab tests per node
+static PBRT_CONSTEXPR int PacketVectors = 2;
+static PBRT_CONSTEXPR int PacketSize = PacketVectors * SimdWidth;
+
+// Once fewer than this many of a packet's rays reach a node, its subtree is traversed one ray at
+// a time; the SIMD tests would mostly be evaluating inactive lanes.
+static PBRT_CONSTEXPR int MinActiveRays = PacketSize / 4;
+
+// Up to PacketSize rays that share a direction octant, so that near and far slab planes are the
+// same for all of them. Lanes past nRays are never active.
+struct PBRT_SIMD_ALIGN RayPacket
+{
+    Float o[ 3 ][ PacketSize ], invDir[ 3 ][ PacketSize ], tMax[ PacketSize ];
+    int dirIsNeg[ 3 ];
+    int nRays;
+    int index[ PacketSize ];
+    RayPrecomputed pre[ PacketSize ];
+
+    template < typename RayType >
+    RayPacket( const RayType* rays, const int* rayIndices, int n )
+    : nRays{ n }
+    {
+        for ( int i = 0; i < PacketSize; ++i ) {
+            // unused lanes repeat the first ray, which keeps them finite
+            int r = rayIndices[ i < n ? i : 0 ];
+            const Ray& ray = rays[ r ];
+            index[ i ] = r;
+            pre[ i ] = RayPrecomputed( ray );
+            for ( int c = 0; c < 3; ++c ) {
+                o[ c ][ i ] = ray.o[ c ];
+                invDir[ c ][ i ] = pre[ i ].invDir[ c ];
+            }
+            tMax[ i ] = ray.tMax;
+        }
+        for ( int c = 0; c < 3; ++c )
+            dirIsNeg[ c ] = pre[ 0 ].dirIsNeg[ c ];
+    }
+    uint32_t AllRays() const { return ( 1u << nRays ) - 1; }
+};
+
+// Bit i of the result is set if ray i is active and hits b, using the same robust slab test as
+// SimdBoundsIntersectP() with the roles of rays and boxes swapped.
+static uint32_t PacketIntersectP( const Bounds3f& b, const RayPacket& packet, uint32_t active )
+{
+    const int* dirIsNeg = packet.dirIsNeg;
+    SimdFloat robust = 1 + 2 * gamma( 3 );
+    uint32_t hits = 0;
+    for ( int v = 0; v < PacketVectors; ++v ) {
+        int lane = v * SimdWidth;
+        if ( ( ( active >> lane ) & ( ( 1u << SimdWidth ) - 1 ) ) == 0 )
+            continue;
+        SimdFloat ox = SimdFloat::Load( &packet.o[ 0 ][ lane ] );
+        SimdFloat oy = SimdFloat::Load( &packet.o[ 1 ][ lane ] );
+        SimdFloat oz = SimdFloat::Load( &packet.o[ 2 ][ lane ] );
+        SimdFloat invDirX = SimdFloat::Load( &packet.invDir[ 0 ][ lane ] );
+        SimdFloat invDirY = SimdFloat::Load( &packet.invDir[ 1 ][ lane ] );
+        SimdFloat invDirZ = SimdFloat::Load( &packet.invDir[ 2 ][ lane ] );
+        SimdFloat tMin = ( SimdFloat( b[ dirIsNeg[ 0 ] ].x ) - ox ) * invDirX;
+        SimdFloat tMax = ( SimdFloat( b[ 1 - dirIsNeg[ 0 ] ].x ) - ox ) * invDirX;
+        SimdFloat tyMin = ( SimdFloat( b[ dirIsNeg[ 1 ] ].y ) - oy ) * invDirY;
+        SimdFloat tyMax = ( SimdFloat( b[ 1 - dirIsNeg[ 1 ] ].y ) - oy ) * invDirY;
+        SimdFloat tzMin = ( SimdFloat( b[ dirIsNeg[ 2 ] ].z ) - oz ) * invDirZ;
+        SimdFloat tzMax = ( SimdFloat( b[ 1 - dirIsNeg[ 2 ] ].z ) - oz ) * invDirZ;
+        tMin = Max( tMin, Max( tyMin, tzMin ) );
+        tMax = Min( tMax * robust, Min( tyMax * robust, tzMax * robust ) );
+        SimdMask hit = ( tMin <= tMax ) & ( tMin < SimdFloat::Load( &packet.tMax[ lane ] ) ) &
+                       ( tMax > 0.f );
+        hits |= ( uint32_t )hit.Bits() << lane;
+    }
+    return hits & active;
+}
+
+// Sorts the indices of rays into runs that share a direction octant; octantStart[ o ] is where
+// octant o's run begins.
+template < typename RayType >
+static void SortByOctant( const RayType* rays, int nRays, std::vector< int >* sorted,
+                          int octantStart[ 9 ] )
+{
+    std::vector< uint8_t > octant( nRays );
+    int count[ 8 ] = {};
+    for ( int i = 0; i < nRays; ++i ) {
+        // same sign convention as RayPrecomputed::dirIsNeg
+        const Vector3f& d = rays[ i ].d;
+        octant[ i ] = ( 1 / d.x < 0 ) | ( ( 1 / d.y < 0 ) << 1 ) | ( ( 1 / d.z < 0 ) << 2 );
+        ++count[ octant[ i ] ];
+    }
+    octantStart[ 0 ] = 0;
+    for ( int o = 0; o < 8; ++o )
+        octantStart[ o + 1 ] = octantStart[ o ] + count[ o ];
+    int offset[ 8 ];
+    std::copy( octantStart, octantStart + 8, offset );
+    sorted->resize( nRays );
+    for ( int i = 0; i < nRays; ++i )
+        ( *sorted )[ offset[ octant[ i ] ]++ ] = i;
+}
+
+// Both children of a node are pushed before either is visited, which leaves depth + 2 entries on
+// the stack; interior nodes are at most MaxBVHDepth - 2 levels deep.
+struct PacketStackEntry
+{
+    int node;
+    uint32_t active;
+};
+
+void BVHAccel::Intersect( const Ray* rays, int nRays, SurfaceInteraction* isects,
+                          bool* hits ) const
+{
+    intersectPackets( rays, nRays, isects, hits );
+}
+
+void BVHAccel::Intersect( const RayDifferential* rays, int nRays, SurfaceInteraction* isects,
+                          bool* hits ) const
+{
+    intersectPackets( rays, nRays, isects, hits );
+}
+
+void BVHAccel::IntersectP( const Ray* rays, int nRays, bool* hits ) const
+{
+    intersectPacketsP( rays, nRays, hits );
+}
+
+void BVHAccel::IntersectP( const RayDifferential* rays, int nRays, bool* hits ) const
+{
+    intersectPacketsP( rays, nRays, hits );
+}
+
+template < typename RayType >
+void BVHAccel::intersectPackets( const RayType* rays, int nRays, SurfaceInteraction* isects,
+                                 bool* hits ) const
+{
+    // rays in a packet may differ in time, so motion trees are always traversed ray by ray
+    if ( !nodes || timeBounds ) {
+        for ( int i = 0; i < nRays; ++i )
+            hits[ i ] = Intersect( rays[ i ], &isects[ i ] );
+        return;
+    }
+    ProfilePhase _( Prof::AccelIntersect );
+    std::vector< int > sorted;
+    int octantStart[ 9 ];
+    SortByOctant( rays, nRays, &sorted, octantStart );
+
+    for ( int o = 0; o < 8; ++o ) {
+        for ( int start = octantStart[ o ]; start < octantStart[ o + 1 ]; start += PacketSize ) {
+            ++nPackets;
+            RayPacket packet( rays, &sorted[ start ],
+                              std::min( PacketSize, octantStart[ o + 1 ] - start ) );
+            // as in the single-ray traversal, SurfaceInteractions for triangle hits are only
+            // built once the closest one is known
+            TriangleHit closestHit[ PacketSize ];
+            const BVHPrimitive* closestTriangle[ PacketSize ] = {};
+            for ( int i = 0; i < packet.nRays; ++i )
+                hits[ packet.index[ i ] ] = false;
+
+            PacketStackEntry toVisit[ MaxBVHDepth ];
+            int toVisitOffset = 0;
+            toVisit[ toVisitOffset++ ] = PacketStackEntry{ 0, packet.AllRays() };
+            while ( toVisitOffset > 0 ) {
+                PacketStackEntry entry = toVisit[ --toVisitOffset ];
+                const LinearBVHNode* node = &nodes[ entry.node ];
+                uint32_t active = PacketIntersectP( node->bounds, packet, entry.active );
+                if ( active == 0 )
+                    continue;
+
+                if ( PopCount( active ) < MinActiveRays ) {
+                    ++nPacketFallbacks;
+                    for ( ; active; active &= active - 1 ) {
+                        int i = CountTrailingZeros( active );
+                        const Ray& ray = rays[ packet.index[ i ] ];
+                        // a hit here is closer than anything found so far and fills in isect
+                        if ( intersectSubtree( ray, &isects[ packet.index[ i ] ], entry.node ) ) {
+                            hits[ packet.index[ i ] ] = true;
+                            closestTriangle[ i ] = nullptr;
+                            packet.tMax[ i ] = ray.tMax;
+                        }
+                    }
+                    continue;
+                }
+
+                if ( node->nPrimitives > 0 ) {
+                    // each primitive is tested against all active rays while it is in cache
+                    for ( int p = 0; p < node->nPrimitives; ++p ) {
+                        const BVHPrimitive& prim = primitives[ node->primitivesOffset + p ];
+                        for ( uint32_t bits = active; bits; bits &= bits - 1 ) {
+                            int i = CountTrailingZeros( bits );
+                            const Ray& ray = rays[ packet.index[ i ] ];
+                            if ( prim.mesh ) {
+                                TriangleHit hit;
+                                if ( !prim.mesh->IntersectTriangle( prim.triIndex, ray,
+                                                                    packet.pre[ i ], &hit ) )
+                                    continue;
+                                ray.tMax = hit.t;
+                                closestHit[ i ] = hit;
+                                closestTriangle[ i ] = &prim;
+                            } else {
+                                Float tHit;
+                                if ( !prim.shape->Intersect( ray, &tHit,
+                                                             &isects[ packet.index[ i ] ] ) )
+                                    continue;
+                                ray.tMax = tHit;
+                                closestTriangle[ i ] = nullptr;
+                            }
+                            hits[ packet.index[ i ] ] = true;
+                            packet.tMax[ i ] = ray.tMax;
+                        }
+                    }
+                } else {
+                    // all rays share dirIsNeg, so the near child is the same for the whole packet
+                    int first = entry.node + 1, second = node->secondChildOffset;
+                    if ( packet.dirIsNeg[ node->axis ] )
+                        std::swap( first, second );
+                    CHECK_LE( toVisitOffset + 2, MaxBVHDepth );
+                    toVisit[ toVisitOffset++ ] = PacketStackEntry{ second, active };
+                    toVisit[ toVisitOffset++ ] = PacketStackEntry{ first, active };
+                }
+            }
+
+            for ( int i = 0; i < packet.nRays; ++i )
+                if ( closestTriangle[ i ] )
+                    closestTriangle[ i ]->mesh->ComputeSurfaceInteraction(
+                      *closestTriangle[ i ]->shape, rays[ packet.index[ i ] ], closestHit[ i ],
+                      &isects[ packet.index[ i ] ] );
+        }
+    }
+}
+
+template < typename RayType >
+void BVHAccel::intersectPacketsP( const RayType* rays, int nRays, bool* hits ) const
+{
+    if ( !nodes || timeBounds ) {
+        for ( int i = 0; i < nRays; ++i )
+            hits[ i ] = IntersectP( rays[ i ] );
+        return;
+    }
+    ProfilePhase _( Prof::AccelIntersectP );
+    std::vector< int > sorted;
+    int octantStart[ 9 ];
+    SortByOctant( rays, nRays, &sorted, octantStart );
+
+    for ( int o = 0; o < 8; ++o ) {
+        for ( int start = octantStart[ o ]; start < octantStart[ o + 1 ]; start += PacketSize ) {
+            ++nPackets;
+            RayPacket packet( rays, &sorted[ start ],
+                              std::min( PacketSize, octantStart[ o + 1 ] - start ) );
+            // rays leave the packet as soon as they hit anything
+            uint32_t unoccluded = packet.AllRays();
+            PacketStackEntry toVisit[ MaxBVHDepth ];
+            int toVisitOffset = 0;
+            toVisit[ toVisitOffset++ ] = PacketStackEntry{ 0, unoccluded };
+            while ( toVisitOffset > 0 && unoccluded ) {
+                PacketStackEntry entry = toVisit[ --toVisitOffset ];
+                const LinearBVHNode* node = &nodes[ entry.node ];
+                uint32_t active =
+                  PacketIntersectP( node->bounds, packet, entry.active & unoccluded );
+                if ( active == 0 )
+                    continue;
+
+                if ( PopCount( active ) < MinActiveRays ) {
+                    ++nPacketFallbacks;
+                    for ( ; active; active &= active - 1 ) {
+                        int i = CountTrailingZeros( active );
+                        if ( intersectSubtreeP( rays[ packet.index[ i ] ], entry.node ) )
+                            unoccluded &= ~( 1u << i );
+                    }
+                    continue;
+                }
+
+                if ( node->nPrimitives > 0 ) {
+                    for ( int p = 0; p < node->nPrimitives; ++p ) {
+                        const BVHPrimitive& prim = primitives[ node->primitivesOffset + p ];
+                        for ( uint32_t bits = active & unoccluded; bits; bits &= bits - 1 ) {
+                            int i = CountTrailingZeros( bits );
+                            const Ray& ray = rays[ packet.index[ i ] ];
+                            TriangleHit hit;
+                            if ( prim.mesh ? prim.mesh->IntersectTriangle( prim.triIndex, ray,
+                                                                           packet.pre[ i ], &hit )
+                                           : prim.shape->IntersectP( ray ) )
+                                unoccluded &= ~( 1u << i );
+                        }
+                    }
+                } else {
+                    int first = entry.node + 1, second = node->secondChildOffset;
+                    if ( packet.dirIsNeg[ node->axis ] )
+                        std::swap( first, second );
+                    CHECK_LE( toVisitOffset + 2, MaxBVHDepth );
+                    toVisit[ toVisitOffset++ ] = PacketStackEntry{ second, active };
+                    toVisit[ toVisitOffset++ ] = PacketStackEntry{ first, active };
+                }
+            }
+            for ( int i = 0; i < packet.nRays; ++i )
+                hits[ packet.index[ i ] ] = !( unoccluded & ( 1u << i ) );
+        }
+    }
+}
+
+} /* namespace pbrt */
@@ -0,0 +1,79 @@
+//
+//  instance.cpp
+//  pbrt3
+//
+//  Created by Ilya Rostovtsev on 10/17/26.
+//  Copyright © 2017 Ilya Rostovtsev. All rights reserved.
+//
+
+#include "instance.hpp"
+#include "interaction.hpp"
+#include "stats.hpp"
+
+namespace pbrt {
+
+STAT_COUNTER( "Scene/Instance intersection tests", nInstanceTests );
+
+BVHInstance::BVHInstance( const Transform* ObjectToWorld, const Transform* WorldToObject,
+                          const std::shared_ptr< BVHAccel >& bvh,
+                          const AnimatedTransform* animatedObjectToWorld )
+: Shape{ ObjectToWorld, WorldToObject, false },
+  bvh{ bvh },
+  animatedObjectToWorld{ animatedObjectToWorld }
+{
+}
+
+Bounds3f BVHInstance::WorldBound() const
+{
+    if ( !animatedObjectToWorld )
+        return Shape::WorldBound();
+    Bounds3f bounds0, bounds1;
+    animatedObjectToWorld->LinearMotionBounds( ObjectBound(), -Infinity, Infinity, &bounds0,
+                                               &bounds1 );
+    return Union( bounds0, bounds1 );
+}
+
+void BVHInstance::LinearMotionBounds( Float time0, Float time1, Bounds3f* bounds0,
+                                      Bounds3f* bounds1 ) const
+{
+    if ( !animatedObjectToWorld )
+        Shape::LinearMotionBounds( time0, time1, bounds0, bounds1 );
+    else
+        animatedObjectToWorld->LinearMotionBounds( ObjectBound(), time0, time1, bounds0,
+                                                   bounds1 );
+}
+
+// BVHAccel always consults alpha masks, so testAlphaTexture has nothing to be forwarded to
+bool BVHInstance::Intersect( const Ray& r, Float* tHit, SurfaceInteraction* isect,
+                             bool /*testAlphaTexture*/ ) const
+{
+    ++nInstanceTests;
+    // transform ray to the instance's object space; the parametric distance is unchanged
+    Transform interpolatedObjectToWorld;
+    const Transform* objectToWorld = ObjectToWorld;
+    Ray ray;
+    if ( animatedObjectToWorld && animatedObjectToWorld->IsAnimated() ) {
+        animatedObjectToWorld->Interpolate( r.time, &interpolatedObjectToWorld );
+        objectToWorld = &interpolatedObjectToWorld;
+        ray = Inverse( interpolatedObjectToWorld )( r );
+    } else
+        ray = ( *WorldToObject )( r );
+    if ( !bvh->Intersect( ray, isect ) )
+        return false;
+    *tHit = ray.tMax;
+    *isect = ( *objectToWorld )( *isect );
+    return true;
+}
+
+bool BVHInstance::IntersectP( const Ray& r, bool /*testAlphaTexture*/ ) const
+{
+    ++nInstanceTests;
+    if ( animatedObjectToWorld && animatedObjectToWorld->IsAnimated() ) {
+        Transform objectToWorld;
+        animatedObjectToWorld->Interpolate( r.time, &objectToWorld );
+        return bvh->IntersectP( Inverse( objectToWorld )( r ) );
+    }
+    return bvh->IntersectP( ( *WorldToObject )( r ) );
+}
+
+} /* namespace pbrt */
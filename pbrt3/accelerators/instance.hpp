@@ -0,0 +1,45 @@
+//
+//  instance.hpp
+//  pbrt3
+//
+//  Created by Ilya Rostovtsev on 10/17/26.
+//  Copyright © 2017 Ilya Rostovtsev. All rights reserved.
+//
+
+#ifndef instance_hpp
+#define instance_hpp
+
+#include "bvh.hpp"
+#include "pbrt.hpp"
+#include "shape.hpp"
+
+namespace pbrt {
+
+// One placement of a shared, object-space BVHAccel. The bottom-level BVH is built once over
+// shapes whose transforms are the identity (so TriangleMesh keeps its vertices in object space);
+// each instance only adds this Shape and its pair of transforms. A BVHAccel built over instances
+// forms the top level: rays are transformed into object space once, at the instance boundary.
+// A moving instance also takes an AnimatedTransform; ObjectToWorld and WorldToObject are then its
+// placement at the start of the motion, and rays use the placement at Ray::time.
+class BVHInstance : public Shape {
+  public:
+    BVHInstance( const Transform* ObjectToWorld, const Transform* WorldToObject,
+                 const std::shared_ptr< BVHAccel >& bvh,
+                 const AnimatedTransform* animatedObjectToWorld = nullptr );
+
+    Bounds3f ObjectBound() const override { return bvh->WorldBound(); }
+    Bounds3f WorldBound() const override;
+    void LinearMotionBounds( Float time0, Float time1, Bounds3f* bounds0,
+                             Bounds3f* bounds1 ) const override;
+    // alpha textures are always tested by the bottom-level BVH
+    bool Intersect( const Ray& ray, Float* tHit, SurfaceInteraction* isect,
+                    bool testAlphaTexture = true ) const override;
+    bool IntersectP( const Ray& ray, bool testAlphaTexture = true ) const override;
+
+  private:
+    const std::shared_ptr< BVHAccel > bvh;
+    const AnimatedTransform* animatedObjectToWorld;
+};
+
+} /* namespace pbrt */
+#endif /* instance_hpp */
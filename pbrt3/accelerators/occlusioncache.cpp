@@ -0,0 +1,37 @@
+//
+//  occlusioncache.cpp
+//  pbrt3
+//
+//  Created by Ilya Rostovtsev on 10/17/26.
+//  Copyright © 2017 Ilya Rostovtsev. All rights reserved.
+//
+
+#include "occlusioncache.hpp"
+#include "stats.hpp"
+
+namespace pbrt {
+
+STAT_PERCENT( "BVH/Shadow rays answered by occlusion cache", nCacheHits, nCacheTests );
+
+OcclusionCache::OcclusionCache( const BVHAccel& bvh, int nLights )
+: bvh{ bvh }, lastOccluder( nLights, BVHPrimitive{ nullptr, nullptr, -1 } )
+{
+}
+
+bool OcclusionCache::IntersectP( const Ray& ray, int lightIndex )
+{
+    ++nCacheTests;
+    BVHPrimitive& occluder = lastOccluder[ lightIndex ];
+    if ( occluder.shape && occluder.IntersectP( ray ) ) {
+        ++nCacheHits;
+        return true;
+    }
+    // unoccluded rays leave the previous occluder in place for the next neighbor
+    BVHPrimitive newOccluder;
+    if ( !bvh.IntersectP( ray, &newOccluder ) )
+        return false;
+    occluder = newOccluder;
+    return true;
+}
+
+} /* namespace pbrt */
@@ -0,0 +1,34 @@
+//
+//  occlusioncache.hpp
+//  pbrt3
+//
+//  Created by Ilya Rostovtsev on 10/17/26.
+//  Copyright © 2017 Ilya Rostovtsev. All rights reserved.
+//
+
+#ifndef occlusioncache_hpp
+#define occlusioncache_hpp
+
+#include "bvh.hpp"
+#include "pbrt.hpp"
+
+namespace pbrt {
+
+// Remembers, for each light, the primitive that blocked the last shadow ray toward it. Shadow
+// rays from neighboring pixels are usually blocked by the same occluder, so IntersectP() tests it
+// first and only traverses the BVH when it misses. Like MemoryArena, a cache is not thread-safe:
+// each thread keeps its own.
+class OcclusionCache {
+  public:
+    OcclusionCache( const BVHAccel& bvh, int nLights );
+
+    bool IntersectP( const Ray& ray, int lightIndex );
+
+  private:
+    const BVHAccel& bvh;
+    // shape == nullptr until the light's first occluded ray
+    std::vector< BVHPrimitive > lastOccluder;
+};
+
+} /* namespace pbrt */
+#endif /* occlusioncache_hpp */
@@ -0,0 +1,330 @@
+//
+//  widebvh.cpp
+//  pbrt3
+//
+//  Created by Ilya Rostovtsev on 10/17/26.
+//  Copyright © 2017 Ilya Rostovtsev. All rights reserved.
+//
+
+#include "widebvh.hpp"
+#include <algorithm>
+#include "interaction.hpp"
+#include "memory.hpp"
+#include "stats.hpp"
+#include "trianglemesh.hpp"
+
+namespace pbrt {
+
+STAT_MEMORY_COUNTER( "Memory/Wide BVH tree", wideTreeBytes );
+STAT_MEMORY_COUNTER( "Memory/Wide BVH nodes", wideNodeBytes );
+STAT_RATIO( "Wide BVH/Children per interior node", wideChildren, wideInteriorNodes );
+
+// Traversal stack depth: each level of the tree can push all but one of a node's children.
+static PBRT_CONSTEXPR int WideStackSize = 64 * SimdWidth;
+
+// can this primitive go into a TriangleGroup? the group kernel doesn't look at alpha masks
+static bool Groupable( const BVHPrimitive& prim )
+{
+    return prim.mesh && !prim.mesh->alphaMask;
+}
+
+WideBVHAccel::WideBVHAccel( const std::vector< std::shared_ptr< Shape > >& shapes,
+                            BVHAccel::SplitMethod splitMethod, bool compressNodes )
+: shapes{ shapes }
+{
+    // build a binary BVH with leaves sized to fill one TriangleGroup; it takes its part of the
+    // "Memory/BVH tree" stat back out when it goes away at the end of the constructor
+    BVHAccel bvh( shapes, SimdWidth, splitMethod );
+    if ( !bvh.nodes )
+        return;
+    ProfilePhase _( Prof::AccelConstruction );
+    primitives.swap( bvh.primitives );
+    bounds = bvh.WorldBound();
+
+    // collapse it; there can't be more wide nodes than binary interior nodes (plus a root)
+    nodes = AllocAligned< WideBVHNode >( bvh.totalNodes );
+    collapse( bvh.nodes, 0 );
+
+    // pack the triangles of every leaf into SIMD groups
+    for ( const WideBVHLeaf& leaf : leaves )
+        totalGroups += leaf.nGroups;
+    groups = AllocAligned< TriangleGroup >( totalGroups );
+    for ( const WideBVHLeaf& leaf : leaves ) {
+        for ( int g = 0; g < leaf.nGroups; ++g ) {
+            TriangleGroup& group = groups[ leaf.groupsOffset + g ];
+            for ( int lane = 0; lane < SimdWidth; ++lane ) {
+                // pad a partial group with copies of its first triangle; group lanes refer
+                // to primitives, not to triangles of a particular mesh
+                int primNum = g * SimdWidth + lane;
+                if ( primNum >= leaf.nGrouped )
+                    primNum = g * SimdWidth;
+                primNum += leaf.primitivesOffset;
+                const BVHPrimitive& prim = primitives[ primNum ];
+                const int* v = &prim.mesh->vertexIndices[ 3 * prim.triIndex ];
+                for ( int c = 0; c < 3; ++c ) {
+                    group.p0[ c ][ lane ] = prim.mesh->p[ v[ 0 ] ][ c ];
+                    group.p1[ c ][ lane ] = prim.mesh->p[ v[ 1 ] ][ c ];
+                    group.p2[ c ][ lane ] = prim.mesh->p[ v[ 2 ] ][ c ];
+                }
+                group.triIndex[ lane ] = primNum;
+            }
+        }
+    }
+
+    if ( compressNodes )
+        compress();
+    nodeMemory = totalNodes * ( compressedNodes ? sizeof( CompressedWideBVHNode )
+                                                : sizeof( WideBVHNode ) );
+    treeMemory = nodeMemory + totalGroups * sizeof( TriangleGroup ) +
+                 leaves.size() * sizeof( WideBVHLeaf ) +
+                 primitives.size() * sizeof( BVHPrimitive ) + sizeof( *this );
+    wideNodeBytes += nodeMemory;
+    wideTreeBytes += treeMemory;
+}
+
+WideBVHAccel::~WideBVHAccel()
+{
+    wideNodeBytes -= nodeMemory;
+    wideTreeBytes -= treeMemory;
+    FreeAligned( nodes );
+    FreeAligned( compressedNodes );
+    FreeAligned( groups );
+}
+
+int WideBVHAccel::collapse( const LinearBVHNode* binaryNodes, int binaryIndex )
+{
+    int nodeIndex = totalNodes++;
+
+    // gather up to SimdWidth binary subtrees by repeatedly opening the interior one with the
+    // largest surface area
+    int children[ SimdWidth ] = { binaryIndex };
+    int nChildren = 1;
+    while ( nChildren < SimdWidth ) {
+        int best = -1;
+        Float bestArea = -1;
+        for ( int i = 0; i < nChildren; ++i ) {
+            const LinearBVHNode& c = binaryNodes[ children[ i ] ];
+            if ( c.nPrimitives == 0 && c.bounds.SurfaceArea() > bestArea ) {
+                best = i;
+                bestArea = c.bounds.SurfaceArea();
+            }
+        }
+        if ( best == -1 )
+            break;
+        const LinearBVHNode& opened = binaryNodes[ children[ best ] ];
+        children[ nChildren++ ] = opened.secondChildOffset;
+        children[ best ] = children[ best ] + 1;
+    }
+    wideChildren += nChildren;
+    ++wideInteriorNodes;
+
+    // fill in the lanes; children are collapsed after their parent, depth first
+    for ( int lane = 0; lane < SimdWidth; ++lane ) {
+        if ( lane >= nChildren ) {
+            nodes[ nodeIndex ].bounds.SetEmpty( lane );
+            nodes[ nodeIndex ].child[ lane ] = 0;
+            continue;
+        }
+        const LinearBVHNode& c = binaryNodes[ children[ lane ] ];
+        nodes[ nodeIndex ].bounds.Set( lane, c.bounds );
+        nodes[ nodeIndex ].child[ lane ] =
+          c.nPrimitives > 0 ? ~createLeaf( c ) : collapse( binaryNodes, children[ lane ] );
+    }
+    return nodeIndex;
+}
+
+void WideBVHAccel::compress()
+{
+    compressedNodes = AllocAligned< CompressedWideBVHNode >( totalNodes );
+    for ( int i = 0; i < totalNodes; ++i ) {
+        const WideBVHNode& node = nodes[ i ];
+        CompressedWideBVHNode& compressed = compressedNodes[ i ];
+
+        // quantize relative to the union of the children, which is this node's own bounds
+        Bounds3f frame;
+        for ( int lane = 0; lane < SimdWidth; ++lane )
+            if ( !node.bounds.IsEmpty( lane ) )
+                frame = Union( frame, node.bounds.Get( lane ) );
+        compressed.bounds.SetFrame( frame );
+        for ( int lane = 0; lane < SimdWidth; ++lane ) {
+            if ( node.bounds.IsEmpty( lane ) )
+                compressed.bounds.SetEmpty( lane );
+            else
+                compressed.bounds.Set( lane, node.bounds.Get( lane ) );
+            compressed.child[ lane ] = node.child[ lane ];
+        }
+    }
+    FreeAligned( nodes );
+    nodes = nullptr;
+}
+
+int WideBVHAccel::createLeaf( const LinearBVHNode& binaryLeaf )
+{
+    // move the triangles that can be grouped to the front of the leaf's primitive range
+    BVHPrimitive* first = &primitives[ binaryLeaf.primitivesOffset ];
+    BVHPrimitive* last = first + binaryLeaf.nPrimitives;
+    BVHPrimitive* mid = std::stable_partition( first, last, Groupable );
+    int nGroupable = static_cast< int >( mid - first );
+
+    WideBVHLeaf leaf;
+    leaf.groupsOffset = leaves.empty() ? 0 : leaves.back().groupsOffset + leaves.back().nGroups;
+    leaf.nGroups = ( nGroupable + SimdWidth - 1 ) / SimdWidth;
+    leaf.primitivesOffset = binaryLeaf.primitivesOffset;
+    leaf.nGrouped = nGroupable;
+    leaf.nPrimitives = binaryLeaf.nPrimitives;
+    leaves.push_back( leaf );
+    return static_cast< int >( leaves.size() ) - 1;
+}
+
+bool WideBVHAccel::intersectLeaf( const WideBVHLeaf& leaf, const Ray& ray,
+                                  const RayPrecomputed& pre, TriangleHit* closestHit,
+                                  int* closestPrimitive, SurfaceInteraction* isect ) const
+{
+    bool hitAnything = false;
+    TriangleHit hit;
+    for ( int g = 0; g < leaf.nGroups; ++g ) {
+        if ( IntersectTriangleGroup( groups[ leaf.groupsOffset + g ], ray, pre, &hit ) ) {
+            ray.tMax = hit.t;
+            *closestHit = hit;
+            *closestPrimitive = hit.triIndex;
+            hitAnything = true;
+        }
+    }
+    for ( int i = leaf.nGrouped; i < leaf.nPrimitives; ++i ) {
+        const BVHPrimitive& prim = primitives[ leaf.primitivesOffset + i ];
+        if ( prim.mesh ) {
+            if ( prim.mesh->IntersectTriangle( prim.triIndex, ray, pre, &hit ) ) {
+                ray.tMax = hit.t;
+                *closestHit = hit;
+                *closestPrimitive = leaf.primitivesOffset + i;
+                hitAnything = true;
+            }
+        } else {
+            Float tHit;
+            if ( prim.shape->Intersect( ray, &tHit, isect ) ) {
+                ray.tMax = tHit;
+                *closestPrimitive = -1;
+                hitAnything = true;
+            }
+        }
+    }
+    return hitAnything;
+}
+
+bool WideBVHAccel::Intersect( const Ray& ray, SurfaceInteraction* isect ) const
+{
+    if ( compressedNodes )
+        return intersect( compressedNodes, ray, isect );
+    return nodes && intersect( nodes, ray, isect );
+}
+
+template < typename Node >
+bool WideBVHAccel::intersect( const Node* tree, const Ray& ray, SurfaceInteraction* isect ) const
+{
+    ProfilePhase _( Prof::AccelIntersect );
+    RayPrecomputed pre( ray );
+
+    // as in BVHAccel, the closest triangle's SurfaceInteraction is only built at the end
+    TriangleHit closestHit;
+    int closestPrimitive = -1;
+    bool hitAnything = false;
+
+    // stack entries remember where the ray enters them, so that subtrees lying entirely beyond
+    // the closest hit found since they were pushed can be skipped
+    struct StackEntry
+    {
+        int child;
+        Float tNear;
+    };
+    StackEntry toVisit[ WideStackSize ];
+    int toVisitOffset = 0;
+    toVisit[ toVisitOffset++ ] = StackEntry{ 0, 0 };
+    while ( toVisitOffset > 0 ) {
+        StackEntry entry = toVisit[ --toVisitOffset ];
+        if ( entry.tNear > ray.tMax )
+            continue;
+        if ( entry.child < 0 ) {
+            hitAnything |= intersectLeaf( leaves[ ~entry.child ], ray, pre, &closestHit,
+                                          &closestPrimitive, isect );
+            continue;
+        }
+
+        // test the ray against all children at once
+        const Node& node = tree[ entry.child ];
+        SimdFloat tNear;
+        int hitBits = node.bounds.IntersectP( ray, pre, &tNear ).Bits();
+        if ( !hitBits )
+            continue;
+        PBRT_SIMD_ALIGN Float t[ SimdWidth ];
+        tNear.Store( t );
+
+        // push the children that were hit sorted far to near, so the nearest is visited next
+        int first = toVisitOffset;
+        for ( ; hitBits; hitBits &= hitBits - 1 ) {
+            int lane = CountTrailingZeros( hitBits );
+            StackEntry e{ node.child[ lane ], t[ lane ] };
+            int i = toVisitOffset++;
+            for ( ; i > first && toVisit[ i - 1 ].tNear < e.tNear; --i )
+                toVisit[ i ] = toVisit[ i - 1 ];
+            toVisit[ i ] = e;
+        }
+    }
+
+    if ( closestPrimitive >= 0 ) {
+        const BVHPrimitive& prim = primitives[ closestPrimitive ];
+        closestHit.triIndex = prim.triIndex;
+        prim.mesh->ComputeSurfaceInteraction( *prim.shape, ray, closestHit, isect );
+    }
+    return hitAnything;
+}
+
+bool WideBVHAccel::intersectLeafP( const WideBVHLeaf& leaf, const Ray& ray,
+                                   const RayPrecomputed& pre ) const
+{
+    for ( int g = 0; g < leaf.nGroups; ++g )
+        if ( IntersectTriangleGroupP( groups[ leaf.groupsOffset + g ], ray, pre ) )
+            return true;
+    TriangleHit hit;
+    for ( int i = leaf.nGrouped; i < leaf.nPrimitives; ++i ) {
+        const BVHPrimitive& prim = primitives[ leaf.primitivesOffset + i ];
+        if ( prim.mesh ? prim.mesh->IntersectTriangle( prim.triIndex, ray, pre, &hit )
+                       : prim.shape->IntersectP( ray ) )
+            return true;
+    }
+    return false;
+}
+
+bool WideBVHAccel::IntersectP( const Ray& ray ) const
+{
+    if ( compressedNodes )
+        return intersectP( compressedNodes, ray );
+    return nodes && intersectP( nodes, ray );
+}
+
+template < typename Node >
+bool WideBVHAccel::intersectP( const Node* tree, const Ray& ray ) const
+{
+    ProfilePhase _( Prof::AccelIntersectP );
+    RayPrecomputed pre( ray );
+
+    // any hit will do, so children are visited in whatever order they come
+    int toVisit[ WideStackSize ];
+    int toVisitOffset = 0;
+    toVisit[ toVisitOffset++ ] = 0;
+    while ( toVisitOffset > 0 ) {
+        int child = toVisit[ --toVisitOffset ];
+        if ( child < 0 ) {
+            if ( intersectLeafP( leaves[ ~child ], ray, pre ) )
+                return true;
+            continue;
+        }
+        const Node& node = tree[ child ];
+        SimdFloat tNear;
+        for ( int hitBits = node.bounds.IntersectP( ray, pre, &tNear ).Bits(); hitBits;
+              hitBits &= hitBits - 1 )
+            toVisit[ toVisitOffset++ ] = node.child[ CountTrailingZeros( hitBits ) ];
+    }
+    return false;
+}
+
+} /* namespace pbrt */
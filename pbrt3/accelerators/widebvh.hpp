@@ -0,0 +1,89 @@
+//
+//  widebvh.hpp
+//  pbrt3
+//
+//  Created by Ilya Rostovtsev on 10/17/26.
+//  Copyright © 2017 Ilya Rostovtsev. All rights reserved.
+//
+
+#ifndef widebvh_hpp
+#define widebvh_hpp
+
+#include "bvh.hpp"
+#include "pbrt.hpp"
+#include "simd.hpp"
+
+namespace pbrt {
+
+struct TriangleGroup;
+struct TriangleHit;
+
+// One node of the collapsed tree: up to SimdWidth children, whose bounds are tested against a ray
+// with a single SIMD slab test. child[ i ] >= 0 is an interior node index; child[ i ] < 0 is the
+// leaf ~child[ i ]. Unused lanes hold empty bounds.
+struct PBRT_SIMD_ALIGN WideBVHNode
+{
+    SimdBounds3f bounds;
+    int child[ SimdWidth ];
+};
+
+// The same node with child bounds quantized to 8 bits relative to the node's own bounds: 104
+// instead of 224 bytes at 8 wide. Quantized boxes are never smaller than the originals, so no
+// hits are lost; rays merely visit a few more children.
+struct CompressedWideBVHNode
+{
+    SimdQuantizedBounds3f bounds;
+    int child[ SimdWidth ];
+};
+
+// The leaf's primitives start with the nGrouped triangles that are packed into its SIMD groups;
+// anything after them (other shapes, alpha-masked triangles) is tested one at a time.
+struct WideBVHLeaf
+{
+    int groupsOffset, nGroups;
+    int primitivesOffset, nGrouped, nPrimitives;
+};
+
+// A binary SAH BVH collapsed into a SimdWidth-wide tree (8 children with AVX, 4 with SSE), with
+// TriangleGroups as leaves. With compressNodes, the tree is stored as CompressedWideBVHNodes.
+class WideBVHAccel {
+  public:
+    WideBVHAccel( const std::vector< std::shared_ptr< Shape > >& shapes,
+                  BVHAccel::SplitMethod splitMethod = BVHAccel::SplitMethod::SAH,
+                  bool compressNodes = false );
+    ~WideBVHAccel();
+
+    Bounds3f WorldBound() const { return bounds; }
+    // on a hit, ray.tMax is shortened to the distance of the closest intersection
+    bool Intersect( const Ray& ray, SurfaceInteraction* isect ) const;
+    bool IntersectP( const Ray& ray ) const;
+
+  private:
+    int collapse( const LinearBVHNode* binaryNodes, int binaryIndex );
+    int createLeaf( const LinearBVHNode& binaryLeaf );
+    void compress();
+    template < typename Node >
+    bool intersect( const Node* tree, const Ray& ray, SurfaceInteraction* isect ) const;
+    template < typename Node > bool intersectP( const Node* tree, const Ray& ray ) const;
+    bool intersectLeaf( const WideBVHLeaf& leaf, const Ray& ray, const RayPrecomputed& pre,
+                        TriangleHit* closestHit, int* closestPrimitive,
+                        SurfaceInteraction* isect ) const;
+    bool intersectLeafP( const WideBVHLeaf& leaf, const Ray& ray,
+                         const RayPrecomputed& pre ) const;
+
+    std::vector< std::shared_ptr< Shape > > shapes;
+    std::vector< BVHPrimitive > primitives;
+    std::vector< WideBVHLeaf > leaves;
+    Bounds3f bounds;
+    WideBVHNode* nodes = nullptr;
+    CompressedWideBVHNode* compressedNodes = nullptr;
+    int totalNodes = 0;
+    TriangleGroup* groups = nullptr;
+    int totalGroups = 0;
+    // this tree's part of the "Memory/Wide BVH tree" and "Memory/Wide BVH nodes" stats, taken
+    // back out by the destructor
+    int64_t treeMemory = 0, nodeMemory = 0;
+};
+
+} /* namespace pbrt */
+#endif /* widebvh_hpp */
@@ -0,0 +1,102 @@
+//
+//  benchmark.cpp
+//  pbrt3
+//
+//  Created by Ilya Rostovtsev on 10/17/26.
+//  Copyright © 2017 Ilya Rostovtsev. All rights reserved.
+//
+
+#include "benchmark.hpp"
+#include "bvh.hpp"
+#include "interaction.hpp"
+#include "transform.hpp"
+#include "trianglemesh.hpp"
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+namespace pbrt {
+
+// normally defined by main.cpp and the scene parser
+Options PbrtOptions;
+int line_num = 0;
+std::string current_file;
+
+std::vector< std::shared_ptr< Shape > > RandomTriangles( int nTriangles, uint32_t seed )
+{
+    static const Transform identity;
+    std::mt19937 rng( seed );
+    std::uniform_real_distribution< Float > u( 0, 1 );
+    std::vector< Point3f > p;
+    std::vector< int > indices;
+    p.reserve( 3 * nTriangles );
+    indices.reserve( 3 * nTriangles );
+    for ( int i = 0; i < nTriangles; ++i ) {
+        Point3f center( u( rng ), u( rng ), u( rng ) );
+        Float size = 0.005f + 0.05f * u( rng ) * u( rng ) * u( rng );
+        for ( int v = 0; v < 3; ++v ) {
+            p.push_back( center + Vector3f( u( rng ) - 0.5f, u( rng ) - 0.5f, u( rng ) - 0.5f ) *
+                                    size );
+            indices.push_back( 3 * i + v );
+        }
+    }
+    return CreateTriangleMesh( &identity, &identity, false, nTriangles, indices.data(),
+                               ( int )p.size(), p.data(), nullptr, nullptr, nullptr, nullptr );
+}
+
+std::vector< Ray > CameraRays( int nx, int ny )
+{
+    std::vector< Ray > rays;
+    rays.reserve( nx * ny );
+    Point3f eye( 0.5f, 0.5f, -1 );
+    for ( int y = 0; y < ny; ++y )
+        for ( int x = 0; x < nx; ++x ) {
+            Point3f target( ( x + 0.5f ) / nx, ( y + 0.5f ) / ny, 0 );
+            rays.push_back( Ray( eye, Normalize( target - eye ) ) );
+        }
+    return rays;
+}
+
+// direction in the hemisphere around n, distributed by cos(theta); u in [0,1)^2
+static Vector3f CosineDirection( const Normal3f& n, Float u0, Float u1 )
+{
+    Vector3f w = Normalize( Vector3f( n ) ), s, t;
+    CoordinateSystem( w, &s, &t );
+    Float r = std::sqrt( u0 ), phi = 2 * Pi * u1;
+    return r * std::cos( phi ) * s + r * std::sin( phi ) * t +
+           std::sqrt( std::max( ( Float )0, 1 - u0 ) ) * w;
+}
+
+std::vector< Ray > DiffuseBounces( const BVHAccel& bvh, const std::vector< Ray >& cameraRays,
+                                   int bouncesPerHit, uint32_t seed )
+{
+    std::vector< Ray > bounces;
+    std::mt19937 rng( seed );
+    std::uniform_real_distribution< Float > u( 0, 1 );
+    for ( Ray ray : cameraRays ) {
+        SurfaceInteraction isect;
+        if ( !bvh.Intersect( ray, &isect ) )
+            continue;
+        Normal3f n = Dot( isect.n, ray.d ) > 0 ? -isect.n : isect.n;
+        Point3f o = isect.p + Vector3f( n ) * ( Float )1e-4;
+        for ( int i = 0; i < bouncesPerHit; ++i )
+            bounces.push_back( Ray( o, CosineDirection( n, u( rng ), u( rng ) ) ) );
+    }
+    return bounces;
+}
+
+double BestTime( int nRuns, const std::function< void() >& setup,
+                 const std::function< void() >& f )
+{
+    double best = Infinity;
+    for ( int i = 0; i < nRuns; ++i ) {
+        setup();
+        auto start = std::chrono::steady_clock::now();
+        f();
+        std::chrono::duration< double > elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min( best, elapsed.count() );
+    }
+    return best;
+}
+
+} /* namespace pbrt */
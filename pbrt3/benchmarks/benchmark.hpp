@@ -0,0 +1,48 @@
+//
+//  benchmark.hpp
+//  pbrt3
+//
+//  Created by Ilya Rostovtsev on 10/17/26.
+//  Copyright © 2017 Ilya Rostovtsev. All rights reserved.
+//
+
+// Every file in benchmarks/ but benchmark.cpp is a separate program, built from the tree's sources
+// without main.cpp, plus benchmark.cpp and its own file. From pbrt3/, e.g.:
+//
+//   SRC="$(ls *.cpp accelerators/*.cpp shapes/*.cpp | grep -v main.cpp) benchmarks/benchmark.cpp"
+//   FLAGS="-std=c++11 -O2 -DNDEBUG -pthread -I. -Iaccelerators -Ishapes"
+//   g++ $FLAGS $SRC benchmarks/raysorter.cpp -lglog -o bench_raysorter
+//
+// Scenes and rays come from fixed seeds, so every run of a program does the same work.
+
+#ifndef benchmark_hpp
+#define benchmark_hpp
+
+#include "geometry.hpp"
+#include "pbrt.hpp"
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace pbrt {
+
+class BVHAccel;
+
+// nTriangles triangles scattered through the unit cube, mostly small with a few large ones, as a
+// stand-in for a tessellated scene
+std::vector< std::shared_ptr< Shape > > RandomTriangles( int nTriangles, uint32_t seed );
+
+// one ray per pixel of an nx by ny pinhole camera at z = -1, looking at the unit cube
+std::vector< Ray > CameraRays( int nx, int ny );
+
+// bouncesPerHit diffuse (cosine-distributed) rays from every hit of a camera ray: incoherent
+// secondary rays, as in path tracing
+std::vector< Ray > DiffuseBounces( const BVHAccel& bvh, const std::vector< Ray >& cameraRays,
+                                   int bouncesPerHit, uint32_t seed );
+
+// the fastest of nRuns calls of f, in seconds; setup (which isn't timed) runs before each call
+double BestTime( int nRuns, const std::function< void() >& setup,
+                 const std::function< void() >& f );
+
+} /* namespace pbrt */
+#endif /* benchmark_hpp */
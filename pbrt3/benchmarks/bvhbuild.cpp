@@ -0,0 +1,52 @@
+//
+//  bvhbuild.cpp
+//  pbrt3
+//
+//  Created by Ilya Rostovtsev on 10/17/26.
+//  Copyright © 2017 Ilya Rostovtsev. All rights reserved.
+//
+
+// BVHAccel build times for the HLBVH and binned SAH builders at several thread counts. The thread
+// pool is restarted with PbrtOptions.nThreads set to each count in turn; on a machine with fewer
+// cores the extra threads only share them.
+//
+// usage: bench_bvhbuild [nTriangles = 1000000] [thread counts = 1 2 4 8 16 32 64]
+
+#include "benchmark.hpp"
+#include "bvh.hpp"
+#include "parallel.hpp"
+#include <cstdio>
+#include <cstdlib>
+
+using namespace pbrt;
+
+int main( int argc, char* argv[] )
+{
+    int nTriangles = argc > 1 ? atoi( argv[ 1 ] ) : 1000000;
+    std::vector< int > threadCounts;
+    for ( int i = 2; i < argc; ++i )
+        threadCounts.push_back( atoi( argv[ i ] ) );
+    if ( threadCounts.empty() )
+        threadCounts = { 1, 2, 4, 8, 16, 32, 64 };
+    std::vector< std::shared_ptr< Shape > > shapes = RandomTriangles( nTriangles, 1 );
+    printf( "%d triangles, %d cores, best of 3\n", nTriangles, NumSystemCores() );
+    printf( "threads     HLBVH       SAH\n" );
+
+    const int nRuns = 3;
+    for ( int nThreads : threadCounts ) {
+        PbrtOptions.nThreads = nThreads;
+        ParallelInit();
+        double seconds[ 2 ];
+        BVHAccel::SplitMethod methods[ 2 ] = { BVHAccel::SplitMethod::HLBVH,
+                                               BVHAccel::SplitMethod::SAH };
+        for ( int m = 0; m < 2; ++m ) {
+            std::unique_ptr< BVHAccel > bvh;
+            seconds[ m ] =
+              BestTime( nRuns, [ & ]() { bvh.reset(); },
+                        [ & ]() { bvh.reset( new BVHAccel( shapes, 4, methods[ m ] ) ); } );
+        }
+        ParallelCleanup();
+        printf( "%7d %7.0f ms %7.0f ms\n", nThreads, seconds[ 0 ] * 1e3, seconds[ 1 ] * 1e3 );
+    }
+    return 0;
+}
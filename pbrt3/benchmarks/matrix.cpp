@@ -0,0 +1,172 @@
+//
+//  matrix.cpp
+//  pbrt3
+//
+//  Created by Ilya Rostovtsev on 10/17/26.
+//  Copyright © 2017 Ilya Rostovtsev. All rights reserved.
+//
+
+// Matrix4x4 and Transform products and inverses, each SIMD kernel against the scalar code it
+// replaces: Matrix4x4::ScalarMul() against SimdMatrixMul(), GaussJordanInverse() against
+// SimdMatrixInverse(), AffineInverse() and Inverse() itself, and Transform::Compose() against a
+// chain of operator*. Every inverse also reports the largest and the mean entry of |m m^-1 - I|,
+// computed in double, on general, affine and ill-conditioned matrices.
+//
+// usage: bench_matrix [nMatrices = 4096]
+
+#include "benchmark.hpp"
+#include "transform.hpp"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+using namespace pbrt;
+
+static std::mt19937 rng( 1 );
+static std::uniform_real_distribution< Float > u( -1, 1 );
+
+static Matrix4x4 RandomMatrix( bool affine )
+{
+    Matrix4x4 m;
+    for ( int i = 0; i < ( affine ? 3 : 4 ); ++i )
+        for ( int j = 0; j < 4; ++j )
+            m.m[ i ][ j ] = u( rng );
+    return m;
+}
+
+// the last row is a random combination of the others plus noise of relative size 1e-4 to 1e-1:
+// valid matrices, with condition numbers of roughly the inverse of that
+static Matrix4x4 IllConditionedMatrix()
+{
+    Matrix4x4 m = RandomMatrix( false );
+    Float c[ 3 ] = { u( rng ), u( rng ), u( rng ) };
+    Float noise = std::pow( ( Float )10, ( Float )-2.5 + ( Float )1.5 * u( rng ) );
+    for ( int j = 0; j < 4; ++j )
+        m.m[ 3 ][ j ] = c[ 0 ] * m.m[ 0 ][ j ] + c[ 1 ] * m.m[ 1 ][ j ] +
+                        c[ 2 ] * m.m[ 2 ][ j ] + noise * u( rng );
+    return m;
+}
+
+// largest |( m mInv - I )ij|
+static double Residual( const Matrix4x4& m, const Matrix4x4& mInv )
+{
+    double r = 0;
+    for ( int i = 0; i < 4; ++i )
+        for ( int j = 0; j < 4; ++j ) {
+            double p = 0;
+            for ( int k = 0; k < 4; ++k )
+                p += ( double )m.m[ i ][ k ] * ( double )mInv.m[ k ][ j ];
+            r = std::max( r, std::abs( p - ( i == j ) ) );
+        }
+    return r;
+}
+
+int main( int argc, char* argv[] )
+{
+    int n = argc > 1 ? atoi( argv[ 1 ] ) : 4096;
+    std::vector< Matrix4x4 > general, affine, illConditioned, out( n );
+    for ( int i = 0; i < n; ++i ) {
+        general.push_back( RandomMatrix( false ) );
+        affine.push_back( RandomMatrix( true ) );
+        illConditioned.push_back( IllConditionedMatrix() );
+    }
+
+    const int nRuns = 5, nRepeats = 100;
+    auto nsPerCall = [ & ]( const std::function< void( int ) >& f ) {
+        double seconds = BestTime( nRuns, []() {},
+                                   [ & ]() {
+                                       for ( int r = 0; r < nRepeats; ++r )
+                                           for ( int i = 0; i < n; ++i )
+                                               f( i );
+                                   } );
+        return seconds / ( ( double )nRepeats * n ) * 1e9;
+    };
+    printf( "%d matrices of each kind, best of %d\n\n", n, nRuns );
+
+    printf( "product of two general matrices\n" );
+    printf( "  %-24s %7.2f ns\n", "Matrix4x4::ScalarMul", nsPerCall( [ & ]( int i ) {
+                out[ i ] = Matrix4x4::ScalarMul( general[ i ], general[ n - 1 - i ] );
+            } ) );
+#if defined( PBRT_SIMD_AVX ) || defined( PBRT_SIMD_SSE )
+    printf( "  %-24s %7.2f ns\n", "SimdMatrixMul", nsPerCall( [ & ]( int i ) {
+                SimdMatrixMul( general[ i ].m, general[ n - 1 - i ].m, out[ i ].m );
+            } ) );
+#endif
+
+    // every inverse is timed on general and on affine matrices and checked on all three kinds;
+    // "-" marks the kinds it doesn't handle
+    typedef std::function< bool( const Matrix4x4&, Matrix4x4* ) > InverseFunction;
+    auto inverse = [ & ]( const char* name, const InverseFunction& f ) {
+        printf( "  %-20s", name );
+        for ( const std::vector< Matrix4x4 >* set : { &general, &affine } ) {
+            Matrix4x4 mInv;
+            if ( f( ( *set )[ 0 ], &mInv ) )
+                printf( " %7.2f ns", nsPerCall( [ & ]( int i ) { f( ( *set )[ i ], &out[ i ] ); } ) );
+            else
+                printf( " %10s", "-" );
+        }
+        int nFailed = 0;
+        for ( const std::vector< Matrix4x4 >* set : { &general, &affine, &illConditioned } ) {
+            double maxResidual = 0, sumResidual = 0;
+            int nInverted = 0;
+            for ( const Matrix4x4& m : *set ) {
+                Matrix4x4 mInv;
+                if ( !f( m, &mInv ) )
+                    continue;
+                double r = Residual( m, mInv );
+                maxResidual = std::max( maxResidual, r );
+                sumResidual += r;
+                ++nInverted;
+            }
+            if ( nInverted == 0 )
+                printf( " %19s", "-" );
+            else
+                printf( "  %8.2e %8.2e", maxResidual, sumResidual / nInverted );
+            if ( nInverted > 0 )
+                nFailed += n - nInverted;
+        }
+        printf( " %7d\n", nFailed );
+    };
+    // residuals are over the matrices that were inverted; the last column counts the others
+    printf( "\n%-22s %10s %10s  %-18s  %-18s  %-18s %7s\n", "inverse", "general", "affine",
+            "general |mm^-1-I|", "affine |mm^-1-I|", "ill-cond. |mm^-1-I|", "failed" );
+    printf( "%-22s %10s %10s  %-18s  %-18s  %-18s\n", "", "", "", "max      mean",
+            "max      mean", "max      mean" );
+    inverse( "GaussJordanInverse", []( const Matrix4x4& m, Matrix4x4* r ) {
+        *r = GaussJordanInverse( m );
+        return true;
+    } );
+#if defined( PBRT_SIMD_AVX ) || defined( PBRT_SIMD_SSE )
+    inverse( "SimdMatrixInverse",
+             []( const Matrix4x4& m, Matrix4x4* r ) { return SimdMatrixInverse( m.m, r->m ); } );
+#endif
+    inverse( "AffineInverse", AffineInverse );
+    inverse( "Inverse", []( const Matrix4x4& m, Matrix4x4* r ) {
+        *r = Inverse( m );
+        return true;
+    } );
+
+    // stacks of stackDepth affine transforms, as in a scene hierarchy
+    const int stackDepth = 8;
+    std::vector< Transform > transforms, composed( n );
+    for ( int i = 0; i < n; ++i ) {
+        Matrix4x4 m = RandomMatrix( true );
+        for ( int j = 0; j < 3; ++j )
+            m.m[ j ][ j ] += 2;
+        transforms.push_back( Transform( m ) );
+    }
+    printf( "\nproduct of %d affine transforms\n", stackDepth );
+    printf( "  %-24s %7.2f ns\n", "operator* chain", nsPerCall( [ & ]( int i ) {
+                const Transform* t = &transforms[ i & ~( stackDepth - 1 ) ];
+                Transform r = t[ 0 ];
+                for ( int j = 1; j < stackDepth; ++j )
+                    r = r * t[ j ];
+                composed[ i ] = r;
+            } ) );
+    printf( "  %-24s %7.2f ns\n", "Transform::Compose", nsPerCall( [ & ]( int i ) {
+                composed[ i ] =
+                  Transform::Compose( &transforms[ i & ~( stackDepth - 1 ) ], stackDepth );
+            } ) );
+    return 0;
+}
@@ -0,0 +1,82 @@
+//
+//  raysorter.cpp
+//  pbrt3
+//
+//  Created by Ilya Rostovtsev on 10/17/26.
+//  Copyright © 2017 Ilya Rostovtsev. All rights reserved.
+//
+
+// One diffuse bounce, the incoherent case RaySorter is for: every camera ray that hits the scene
+// spawns bouncesPerHit cosine-distributed rays, and those are traced four ways, each in batches of
+// batchSize: in the order they were spawned and sorted by RaySorter, one ray at a time and through
+// BVHAccel's packet traversal. Sorting is part of the sorted times.
+//
+// usage: bench_raysorter [nTriangles = 1000000] [batchSize = 65536] [bouncesPerHit = 4]
+
+#include "benchmark.hpp"
+#include "bvh.hpp"
+#include "interaction.hpp"
+#include "parallel.hpp"
+#include "raysorter.hpp"
+#include <cstdio>
+#include <cstdlib>
+
+using namespace pbrt;
+
+int main( int argc, char* argv[] )
+{
+    int nTriangles = argc > 1 ? atoi( argv[ 1 ] ) : 1000000;
+    int batchSize = argc > 2 ? atoi( argv[ 2 ] ) : 65536;
+    int bouncesPerHit = argc > 3 ? atoi( argv[ 3 ] ) : 4;
+    ParallelInit();
+    BVHAccel bvh( RandomTriangles( nTriangles, 1 ) );
+
+    std::vector< Ray > bounces = DiffuseBounces( bvh, CameraRays( 512, 512 ), bouncesPerHit, 2 );
+    int nRays = ( int )bounces.size();
+    printf( "%d triangles, %d bounce rays, batches of %d\n", nTriangles, nRays, batchSize );
+
+    // rays are traced in place (Intersect() shortens tMax), so every run gets a fresh copy
+    std::vector< Ray > rays;
+    std::vector< SurfaceInteraction > isects( batchSize );
+    std::unique_ptr< bool[] > hits( new bool[ batchSize ] );
+    int nHits = 0;
+    auto traceSingle = [ & ]( Ray* batch, const int*, int n ) {
+        for ( int i = 0; i < n; ++i )
+            nHits += bvh.Intersect( batch[ i ], &isects[ i ] );
+    };
+    auto tracePackets = [ & ]( Ray* batch, const int*, int n ) {
+        bvh.Intersect( batch, n, isects.data(), hits.get() );
+        for ( int i = 0; i < n; ++i )
+            nHits += hits[ i ];
+    };
+    auto reset = [ & ]() {
+        rays = bounces;
+        nHits = 0;
+    };
+    auto report = [ & ]( const char* name, double seconds ) {
+        printf( "%-24s %7.3f s %7.3f Mrays/s %9d hits\n", name, seconds, nRays / seconds * 1e-6,
+                nHits );
+    };
+    auto unsorted = [ & ]( const RaySorter< Ray >::SubmitFunction& trace ) {
+        return [ &, trace ]() {
+            for ( int start = 0; start < nRays; start += batchSize )
+                trace( &rays[ start ], nullptr, std::min( batchSize, nRays - start ) );
+        };
+    };
+    auto sorted = [ & ]( const RaySorter< Ray >::SubmitFunction& trace ) {
+        return [ &, trace ]() {
+            RaySorter< Ray > sorter( bvh.WorldBound(), batchSize, trace );
+            for ( int i = 0; i < nRays; ++i )
+                sorter.Push( rays[ i ], i );
+            sorter.Flush();
+        };
+    };
+
+    const int nRuns = 3;
+    report( "unsorted, single rays", BestTime( nRuns, reset, unsorted( traceSingle ) ) );
+    report( "unsorted, packets", BestTime( nRuns, reset, unsorted( tracePackets ) ) );
+    report( "sorted, single rays", BestTime( nRuns, reset, sorted( traceSingle ) ) );
+    report( "sorted, packets", BestTime( nRuns, reset, sorted( tracePackets ) ) );
+    ParallelCleanup();
+    return 0;
+}
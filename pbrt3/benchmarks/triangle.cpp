@@ -0,0 +1,69 @@
+//
+//  triangle.cpp
+//  pbrt3
+//
+//  Created by Ilya Rostovtsev on 10/17/26.
+//  Copyright © 2017 Ilya Rostovtsev. All rights reserved.
+//
+
+// Triangle::IntersectP() against the generic Shape::IntersectP(), which runs the full Intersect()
+// into a SurfaceInteraction and was what triangles used before they had an occlusion-only test.
+// Each ray is aimed at a random point of the parallelogram spanned by one triangle's edges, and
+// half of them stop short of it, so about a quarter of the tests hit.
+//
+// usage: bench_triangle [nTests = 4000000]
+
+#include "benchmark.hpp"
+#include "transform.hpp"
+#include "trianglemesh.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+using namespace pbrt;
+
+int main( int argc, char* argv[] )
+{
+    int nTests = argc > 1 ? atoi( argv[ 1 ] ) : 4000000;
+    const int nTriangles = 4096;
+    static const Transform identity;
+    std::shared_ptr< TriangleMesh > mesh =
+      std::dynamic_pointer_cast< TriangleMeshShape >( RandomTriangles( nTriangles, 1 )[ 0 ] )->mesh;
+    std::vector< std::unique_ptr< Triangle > > triangles;
+    for ( int i = 0; i < nTriangles; ++i )
+        triangles.emplace_back( new Triangle( &identity, &identity, false, mesh, i ) );
+
+    std::vector< Ray > rays;
+    std::vector< const Triangle* > targets;
+    std::mt19937 rng( 2 );
+    std::uniform_real_distribution< Float > u( 0, 1 );
+    for ( int i = 0; i < nTests; ++i ) {
+        int t = std::min( ( int )( u( rng ) * nTriangles ), nTriangles - 1 );
+        const int* v = &mesh->vertexIndices[ 3 * t ];
+        const Point3f &p0 = mesh->p[ v[ 0 ] ], &p1 = mesh->p[ v[ 1 ] ], &p2 = mesh->p[ v[ 2 ] ];
+        Point3f target = p0 + u( rng ) * ( p1 - p0 ) + u( rng ) * ( p2 - p0 );
+        Point3f o( 2 * u( rng ) - 0.5f, 2 * u( rng ) - 0.5f, 2 * u( rng ) - 0.5f );
+        Float tMax = u( rng ) < 0.5f ? Infinity : 0.9f;
+        rays.push_back( Ray( o, target - o, tMax ) );
+        targets.push_back( triangles[ t ].get() );
+    }
+
+    const int nRuns = 5;
+    int nHits = 0;
+    auto report = [ & ]( const char* name, double seconds ) {
+        printf( "%-36s %7.2f ns per test %9d hits\n", name, seconds / nTests * 1e9, nHits );
+    };
+    auto reset = [ & ]() { nHits = 0; };
+    printf( "%d tests against %d triangles, best of %d\n", nTests, nTriangles, nRuns );
+    report( "Triangle::IntersectP",
+            BestTime( nRuns, reset, [ & ]() {
+                for ( int i = 0; i < nTests; ++i )
+                    nHits += targets[ i ]->IntersectP( rays[ i ] );
+            } ) );
+    report( "Shape::IntersectP (via Intersect)",
+            BestTime( nRuns, reset, [ & ]() {
+                for ( int i = 0; i < nTests; ++i )
+                    nHits += targets[ i ]->Shape::IntersectP( rays[ i ] );
+            } ) );
+    return 0;
+}
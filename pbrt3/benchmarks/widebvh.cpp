@@ -0,0 +1,84 @@
+//
+//  widebvh.cpp
+//  pbrt3
+//
+//  Created by Ilya Rostovtsev on 10/17/26.
+//  Copyright © 2017 Ilya Rostovtsev. All rights reserved.
+//
+
+// WideBVHAccel with float and with quantized nodes on the same scene: the memory stats of each
+// tree, then Intersect() and IntersectP() rates for camera rays and for one diffuse bounce.
+//
+// usage: bench_widebvh [nTriangles = 1000000]
+
+#include "benchmark.hpp"
+#include "bvh.hpp"
+#include "interaction.hpp"
+#include "parallel.hpp"
+#include "stats.hpp"
+#include "widebvh.hpp"
+#include <cstdio>
+#include <cstdlib>
+
+using namespace pbrt;
+
+int main( int argc, char* argv[] )
+{
+    int nTriangles = argc > 1 ? atoi( argv[ 1 ] ) : 1000000;
+    ParallelInit();
+    std::vector< std::shared_ptr< Shape > > shapes = RandomTriangles( nTriangles, 1 );
+    std::vector< Ray > camera = CameraRays( 512, 512 ), bounces;
+    {
+        BVHAccel bvh( shapes );
+        bounces = DiffuseBounces( bvh, camera, 4, 2 );
+    }
+    printf( "%d triangles; WideBVHNode %d bytes, CompressedWideBVHNode %d bytes\n", nTriangles,
+            ( int )sizeof( WideBVHNode ), ( int )sizeof( CompressedWideBVHNode ) );
+
+    // both trees stay alive until the end, so each one's stats can be reported on their own
+    ReportThreadStats();
+    ClearStats();
+    WideBVHAccel floatNodes( shapes, BVHAccel::SplitMethod::SAH, false );
+    printf( "\nfloat nodes:\n" );
+    ReportThreadStats();
+    PrintStats( stdout );
+    ClearStats();
+    WideBVHAccel quantizedNodes( shapes, BVHAccel::SplitMethod::SAH, true );
+    printf( "\nquantized nodes:\n" );
+    ReportThreadStats();
+    PrintStats( stdout );
+    ClearStats();
+
+    const int nRuns = 3;
+    std::vector< Ray > rays;
+    int nHits = 0;
+    auto run = [ & ]( const char* name, const std::vector< Ray >& source,
+                      const std::function< bool( const Ray& ) >& trace ) {
+        double seconds = BestTime( nRuns,
+                                   [ & ]() {
+                                       rays = source;
+                                       nHits = 0;
+                                   },
+                                   [ & ]() {
+                                       for ( const Ray& ray : rays )
+                                           nHits += trace( ray );
+                                   } );
+        printf( "%-34s %7.3f s %7.3f Mrays/s %9d hits\n", name, seconds,
+                rays.size() / seconds * 1e-6, nHits );
+    };
+    printf( "\n%d camera rays, %d bounce rays, best of %d\n", ( int )camera.size(),
+            ( int )bounces.size(), nRuns );
+    SurfaceInteraction isect;
+    for ( const WideBVHAccel* accel : { &floatNodes, &quantizedNodes } ) {
+        const char* layout = accel == &floatNodes ? "float" : "quantized";
+        auto intersect = [ & ]( const Ray& ray ) { return accel->Intersect( ray, &isect ); };
+        auto intersectP = [ & ]( const Ray& ray ) { return accel->IntersectP( ray ); };
+        printf( "%s nodes:\n", layout );
+        run( "  camera rays, Intersect", camera, intersect );
+        run( "  camera rays, IntersectP", camera, intersectP );
+        run( "  bounce rays, Intersect", bounces, intersect );
+        run( "  bounce rays, IntersectP", bounces, intersectP );
+    }
+    ParallelCleanup();
+    return 0;
+}
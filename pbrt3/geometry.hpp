@@ -332,6 +332,16 @@ template < typename T > struct Point3
         return z;
     }
 
+    T& operator[]( int i )
+    {
+        // Assert( i >= 0 && i < 3 );
+        if ( i == 0 )
+            return x;
+        if ( i == 1 )
+            return y;
+        return z;
+    }
+
     Point3< T > operator+( const Vector3< T >& v ) const
     {
         return Point3< T >( x + v.x, y + v.y, z + v.z );
@@ -521,7 +531,7 @@ template < typename T > struct Point2
         return *this;
     }
 
-    Point2< T > operator*( T s ) { return Point2< T >( x * s, y * s ); }
+    Point2< T > operator*( T s ) const { return Point2< T >( x * s, y * s ); }
     Point2< T >& operator*=( T s )
     {
         x *= s;
@@ -643,7 +653,7 @@ template < typename T > struct Normal3
         return *this;
     }
 
-    Normal3< T > operator-() { return Normal3( -x, -y, -z ); }
+    Normal3< T > operator-() const { return Normal3( -x, -y, -z ); }
 
     Normal3< T > operator*( T s ) const { return Normal3( s * x, s * y, s * z ); }
 
@@ -789,6 +799,36 @@ struct RayDifferential : public Ray
     }
 };
 
+// Quantities that depend only on the ray but are needed by every bounds and triangle test during
+// traversal: the reciprocal direction and its signs for the slab test, and the axis permutation
+// and shear of the watertight triangle test. Built once per ray, before traversal.
+struct RayPrecomputed
+{
+    Vector3f invDir;
+    int dirIsNeg[ 3 ];
+    int kx, ky, kz;
+    Float Sx, Sy, Sz;
+
+    RayPrecomputed() {}
+    explicit RayPrecomputed( const Ray& ray )
+    : invDir{ 1 / ray.d.x, 1 / ray.d.y, 1 / ray.d.z }
+    {
+        dirIsNeg[ 0 ] = invDir.x < 0;
+        dirIsNeg[ 1 ] = invDir.y < 0;
+        dirIsNeg[ 2 ] = invDir.z < 0;
+        kz = MaxDimension( Abs( ray.d ) );
+        kx = kz + 1;
+        if ( kx == 3 )
+            kx = 0;
+        ky = kx + 1;
+        if ( ky == 3 )
+            ky = 0;
+        Sx = -ray.d[ kx ] / ray.d[ kz ];
+        Sy = -ray.d[ ky ] / ray.d[ kz ];
+        Sz = 1.f / ray.d[ kz ];
+    }
+};
+
 // Bounds  - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
 template < typename T > struct Bounds2
@@ -1021,6 +1061,10 @@ template < typename T > struct Bounds3
     }
 
     inline bool IntersectP( const Ray& ray, const Vector3f& invDir, const int dirIsNeg[ 3 ] ) const;
+    bool IntersectP( const Ray& ray, const RayPrecomputed& pre ) const
+    {
+        return IntersectP( ray, pre.invDir, pre.dirIsNeg );
+    }
 };
 
 template < typename T > Bounds3< T > Union( const Bounds3< T >& b, const Point3< T >& p )
@@ -1040,6 +1084,15 @@ template < typename T > Bounds3< T > Union( const Bounds3< T >& b1, const Bounds
                    std::max( b1.pMax.z, b2.pMax.z ) ) );
 }
 
+template < typename T > Bounds3< T > Intersect( const Bounds3< T >& b1, const Bounds3< T >& b2 )
+{
+    // assign pMin and pMax directly: the constructor would reorder the corners of disjoint boxes
+    Bounds3< T > ret;
+    ret.pMin = Max( b1.pMin, b2.pMin );
+    ret.pMax = Min( b1.pMax, b2.pMax );
+    return ret;
+}
+
 template < typename T > bool Overlaps( const Bounds3< T >& b1, const Bounds3< T >& b2 )
 {
     bool x = ( b1.pMax.x >= b2.pMin.x ) && ( b1.pMin.x <= b2.pMax.x );
@@ -1140,6 +1193,26 @@ class Bounds2iIterator : public std::forward_iterator_tag {
     }
 };
 
+// Morton codes  - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+// spreads the low 10 bits of x out to every third bit
+inline uint32_t LeftShift3( uint32_t x )
+{
+    if ( x == ( 1 << 10 ) )
+        --x;
+    x = ( x | ( x << 16 ) ) & 0x30000ff;
+    x = ( x | ( x << 8 ) ) & 0x300f00f;
+    x = ( x | ( x << 4 ) ) & 0x30c30c3;
+    x = ( x | ( x << 2 ) ) & 0x9249249;
+    return x;
+}
+
+// v has components in [ 0, 2^10 ]; bit i of the code belongs to axis i % 3
+inline uint32_t EncodeMorton3( const Vector3f& v )
+{
+    return ( LeftShift3( v.z ) << 2 ) | ( LeftShift3( v.y ) << 1 ) | LeftShift3( v.x );
+}
+
 } /* namespace pbrt */
 
 #endif /* geometry_hpp */
@@ -107,6 +107,17 @@ void Barrier::Wait()
 
 static std::condition_variable workListCondition;
 
+// Unlinks _loop_ from _workList_; it need not be at the head when nested _ParallelFor()_ calls
+// have pushed loops of their own. _workListMutex_ must be held.
+static void removeFromWorkList( ParallelForLoop* loop )
+{
+    ParallelForLoop** p = &workList;
+    while ( *p && *p != loop )
+        p = &( *p )->next;
+    if ( *p )
+        *p = loop->next;
+}
+
 static void workerThreadFunc( int tIndex, std::shared_ptr< Barrier > barrier )
 {
     LOG( INFO ) << "Started execution in worker thread " << tIndex;
@@ -205,6 +216,14 @@ void ParallelFor( std::function< void( int64_t ) > func, int64_t count, int chun
 
     // Help out with parallel loop iterations in the current thread
     while ( !loop.Finished() ) {
+        // Once every iteration has been handed out, wait for the threads still running some.
+        // _loop_ is already off _workList_ at this point, and loops started by nested calls to
+        // _ParallelFor()_ may sit in front of where it was, so _workList_ must not be touched.
+        if ( loop.nextIndex >= loop.maxIndex ) {
+            workListCondition.wait( lock, [&loop] { return loop.Finished(); } );
+            break;
+        }
+
         // Run a chunk of loop iterations for _loop_
 
         // Find the set of loop iterations to run next
@@ -214,7 +233,7 @@ void ParallelFor( std::function< void( int64_t ) > func, int64_t count, int chun
         // Update _loop_ to reflect iterations this thread will run
         loop.nextIndex = indexEnd;
         if ( loop.nextIndex == loop.maxIndex )
-            workList = loop.next;
+            removeFromWorkList( &loop );
         loop.activeWorkers++;
 
         // Run loop indices in _[indexStart, indexEnd)_
@@ -266,6 +285,14 @@ void ParallelFor2D( std::function< void( Point2i ) > func, const Point2i& count
 
     // Help out with parallel loop iterations in the current thread
     while ( !loop.Finished() ) {
+        // Once every iteration has been handed out, wait for the threads still running some.
+        // _loop_ is already off _workList_ at this point, and loops started by nested calls to
+        // _ParallelFor()_ may sit in front of where it was, so _workList_ must not be touched.
+        if ( loop.nextIndex >= loop.maxIndex ) {
+            workListCondition.wait( lock, [&loop] { return loop.Finished(); } );
+            break;
+        }
+
         // Run a chunk of loop iterations for _loop_
 
         // Find the set of loop iterations to run next
@@ -275,7 +302,7 @@ void ParallelFor2D( std::function< void( Point2i ) > func, const Point2i& count
         // Update _loop_ to reflect iterations this thread will run
         loop.nextIndex = indexEnd;
         if ( loop.nextIndex == loop.maxIndex )
-            workList = loop.next;
+            removeFromWorkList( &loop );
         loop.activeWorkers++;
 
         // Run loop indices in _[indexStart, indexEnd)_
@@ -378,6 +378,43 @@ inline int CountTrailingZeros( uint32_t v )
 #endif
 }
 
+inline int PopCount( uint32_t v )
+{
+#if defined( PBRT_IS_MSVC )
+    return __popcnt( v );
+#else
+    return __builtin_popcount( v );
+#endif
+}
+
+// MurmurHash64A over a byte range, continuing from h
+inline uint64_t HashBytes( const void* data, size_t size, uint64_t h )
+{
+    const uint64_t m = 0xc6a4a7935bd1e995ull;
+    const int r = 47;
+    const unsigned char* bytes = static_cast< const unsigned char* >( data );
+    h ^= size * m;
+    for ( ; size >= 8; bytes += 8, size -= 8 ) {
+        uint64_t k;
+        memcpy( &k, bytes, 8 );
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        h ^= k;
+        h *= m;
+    }
+    if ( size > 0 ) {
+        uint64_t k = 0;
+        memcpy( &k, bytes, size );
+        h ^= k;
+        h *= m;
+    }
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+    return h;
+}
+
 template < typename Predicate > int FindInterval( int size, const Predicate& pred )
 {
     int first = 0, len = size;
@@ -104,6 +104,14 @@
 #define PBRT_L1_CACHE_LINE_SIZE 64
 #endif
 
+#if defined( __AVX__ )
+#define PBRT_HAVE_AVX
+#endif
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#define PBRT_HAVE_SSE2
+#endif
+
 #if defined( PBRT_IS_MSVC )
 #define PBRT_FORCEINLINE __forceinline
 #else
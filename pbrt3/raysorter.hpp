@@ -0,0 +1,97 @@
+//
+//  raysorter.hpp
+//  pbrt3
+//
+//  Created by Ilya Rostovtsev on 10/17/26.
+//  Copyright © 2017 Ilya Rostovtsev. All rights reserved.
+//
+
+#ifndef raysorter_hpp
+#define raysorter_hpp
+
+#include "geometry.hpp"
+#include "pbrt.hpp"
+#include <functional>
+#include <type_traits>
+
+namespace pbrt {
+
+// Queues rays (Ray or RayDifferential) and hands them on in batches of batchSize, reordered so
+// that rays with the same direction octant and nearby origins are adjacent: each batch is sorted
+// by octant, then by the Morton code of the ray origin quantized to the scene bounds. Secondary
+// rays traced in that order revisit the same BVH nodes back to back instead of thrashing the
+// cache, and every octant run suits BVHAccel's packet traversal.
+template < typename RayType > class RaySorter {
+    // batches go to callbacks as RayType*, and a pointer to anything derived from Ray would
+    // silently convert to a const Ray* with the wrong stride
+    static_assert( std::is_same< RayType, Ray >::value ||
+                     std::is_same< RayType, RayDifferential >::value,
+                   "RaySorter only sorts Ray and RayDifferential" );
+
+  public:
+    // called with each sorted batch; ids[ i ] is the id that rays[ i ] was queued with
+    typedef std::function< void( RayType* rays, const int* ids, int nRays ) > SubmitFunction;
+
+    RaySorter( const Bounds3f& sceneBounds, int batchSize, SubmitFunction submit )
+    : sceneBounds{ sceneBounds }, batchSize{ std::max( 1, batchSize ) }, submit{ submit }
+    {
+        rays.reserve( this->batchSize );
+        ids.reserve( this->batchSize );
+        keys.reserve( this->batchSize );
+    }
+
+    void Push( const RayType& ray, int id )
+    {
+        rays.push_back( ray );
+        ids.push_back( id );
+        if ( ( int )rays.size() == batchSize )
+            Flush();
+    }
+
+    // submits whatever is queued, e.g. at the end of a bounce
+    void Flush()
+    {
+        if ( rays.empty() )
+            return;
+        int nRays = ( int )rays.size();
+        keys.resize( nRays );
+        for ( int i = 0; i < nRays; ++i )
+            keys[ i ] = SortKey( Key( rays[ i ] ), i );
+        std::sort( keys.begin(), keys.end() );
+
+        sortedRays.resize( nRays );
+        sortedIds.resize( nRays );
+        for ( int i = 0; i < nRays; ++i ) {
+            sortedRays[ i ] = rays[ keys[ i ].second ];
+            sortedIds[ i ] = ids[ keys[ i ].second ];
+        }
+        rays.clear();
+        ids.clear();
+        submit( sortedRays.data(), sortedIds.data(), nRays );
+    }
+
+  private:
+    typedef std::pair< uint64_t, int > SortKey;
+
+    uint64_t Key( const RayType& ray ) const
+    {
+        // same sign convention as RayPrecomputed::dirIsNeg
+        uint64_t octant = ( 1 / ray.d.x < 0 ) | ( ( 1 / ray.d.y < 0 ) << 1 ) |
+                          ( ( 1 / ray.d.z < 0 ) << 2 );
+        // origins outside the scene (usually the camera) are clamped to its boundary
+        Vector3f o = sceneBounds.Offset( ray.o );
+        o = Vector3f( Clamp( o.x, 0, 1 ), Clamp( o.y, 0, 1 ), Clamp( o.z, 0, 1 ) ) *
+            Float( 1 << 10 );
+        return ( octant << 30 ) | EncodeMorton3( o );
+    }
+
+    const Bounds3f sceneBounds;
+    const int batchSize;
+    const SubmitFunction submit;
+    std::vector< RayType > rays, sortedRays;
+    std::vector< int > ids, sortedIds;
+    std::vector< SortKey > keys;
+};
+
+} /* namespace pbrt */
+#endif /* raysorter_hpp */
@@ -21,8 +21,16 @@ Shape::Shape( const Transform* objectToWorld, const Transform* worldToObject,
 {
 }
 
+Shape::~Shape() {}
+
 Bounds3f Shape::WorldBound() const { return ( *ObjectToWorld )( ObjectBound() ); }
 
+void Shape::LinearMotionBounds( Float /*time0*/, Float /*time1*/, Bounds3f* bounds0,
+                                Bounds3f* bounds1 ) const
+{
+    *bounds0 = *bounds1 = WorldBound();
+}
+
 bool Shape::IntersectP( const Ray& ray, bool testAlphaTexture ) const
 {
     Float tHit = ray.tMax;
@@ -22,7 +22,11 @@ struct Shape
 
     virtual ~Shape();
     virtual Bounds3f ObjectBound() const = 0;
-    Bounds3f WorldBound() const;
+    virtual Bounds3f WorldBound() const;
+    // world-space bounds at time0 and time1 such that interpolating linearly between them bounds
+    // the shape at every time in between; for shapes that don't move, both are WorldBound()
+    virtual void LinearMotionBounds( Float time0, Float time1, Bounds3f* bounds0,
+                                     Bounds3f* bounds1 ) const;
     virtual bool Intersect( const Ray& ray, Float* tHit, SurfaceInteraction* isect,
                             bool testAlphaTexture = true ) const = 0;
     virtual bool IntersectP( const Ray& ray, bool testAlphaTexture = true ) const;
@@ -17,7 +17,8 @@ Cone::Cone( const Transform* ObjectToWorld, const Transform* WorldToObject, bool
 : Shape{ ObjectToWorld, WorldToObject, reverseOrientation },
   height{ height },
   radius{ radius },
-  phiMax{ phiMax }
+  phiMax{ Radians( Clamp( phiMax, 0, 360 ) ) },
+  phiMaxTest{ this->phiMax }
 {
 }
 
@@ -121,6 +122,21 @@ bool Cone::Intersect( const Ray& r, Float* tHit, SurfaceInteraction* isect,
     return true;
 }
 
-bool Cone::IntersectP( const Ray& ray, bool testAlphaTexture ) const { return true; }
+bool Cone::IntersectP( const Ray& r, bool testAlphaTexture ) const
+{
+    Vector3f oErr, dErr;
+    // transform ray to object space
+    Ray ray = ( *WorldToObject )( r, &oErr, &dErr );
+
+    // solve for the cone hits and test them against clipping parameters
+    Float k = ( radius / height ) * ( radius / height );
+    QuadricTest test =
+      QuadricIntersectP( ray, oErr, dErr, 1, -k, 0, height, 0, [&]( const Point3f& p ) {
+          return p.z >= 0 && p.z <= height && phiMaxTest( p.x, p.y );
+      } );
+    if ( test == QuadricTest::Uncertain )
+        return Shape::IntersectP( r, testAlphaTexture ); // too close to call without EFloat
+    return test == QuadricTest::Hit;
+}
 
 } /* namespace pbrt */
@@ -10,6 +10,7 @@
 #define cone_hpp
 
 #include "pbrt.hpp"
+#include "quadric.hpp"
 #include "shape.hpp"
 
 namespace pbrt {
@@ -24,7 +25,7 @@ class Cone : public Shape {
     bool Intersect( const Ray& r, Float* tHit, SurfaceInteraction* isect,
                     bool testAlphaTexture ) const override;
 
-    bool IntersectP( const Ray& ray, bool testAlphaTexture = true ) const override;
+    bool IntersectP( const Ray& r, bool testAlphaTexture = true ) const override;
 
     Float Area() const
     {
@@ -33,6 +34,7 @@ class Cone : public Shape {
 
   private:
     const Float height, radius, phiMax;
+    const PhiMaxTest phiMaxTest;
 };
 
 } /* namespace pbrt */
@@ -18,7 +18,8 @@ Cylinder::Cylinder( const Transform* o2w, const Transform* w2o, bool ro, Float r
   radius{ rad },
   zMin{ std::min( z0, z1 ) },
   zMax{ std::max( z0, z1 ) },
-  phiMax{ Radians( Clamp( pm, 0.f, 360.f ) ) }
+  phiMax{ Radians( Clamp( pm, 0.f, 360.f ) ) },
+  phiMaxTest{ phiMax }
 {
 }
 
@@ -40,9 +41,11 @@ bool Cylinder::Intersect( const Ray& r, Float* tHit, SurfaceInteraction* isect,
     Ray ray = ( *WorldToObject )( r, &oErr, &dErr );
 
     // compute quadratic cylinder coefficients:
-    EFloat A = r.d.x * r.d.x + r.d.y * r.d.y;
-    EFloat B = 2 * ( r.d.x * r.o.x + r.d.y * r.o.y );
-    EFloat C = r.o.x * r.o.x + r.o.y * r.o.y - radius * radius;
+    EFloat ox{ ray.o.x, oErr.x }, oy{ ray.o.y, oErr.y };
+    EFloat dx{ ray.d.x, dErr.x }, dy{ ray.d.y, dErr.y };
+    EFloat A = dx * dx + dy * dy;
+    EFloat B = 2 * ( dx * ox + dy * oy );
+    EFloat C = ox * ox + oy * oy - EFloat( radius ) * EFloat( radius );
 
     // solve quadratic equation for t values
     EFloat t0, t1;
@@ -68,7 +71,7 @@ bool Cylinder::Intersect( const Ray& r, Float* tHit, SurfaceInteraction* isect,
         if ( tShapeHit == t1 )
             return false;
         tShapeHit = t1;
-        if ( static_cast< Float >( t1 ) > r.tMax )
+        if ( t1.UpperBound() > ray.tMax )
             return false;
         // compute cylinder hit point and phi:
         pHit = ray( static_cast< Float >( tShapeHit ) );
@@ -116,19 +119,18 @@ bool Cylinder::Intersect( const Ray& r, Float* tHit, SurfaceInteraction* isect,
 
 bool Cylinder::IntersectP( const Ray& r, bool testAlphaTexture ) const
 {
-    Float phi;
-    Point3f pHit;
-
-    // transform Ray to object space
-
-    // compute quadratic sphere coefficients
-
-    // solve quadratic equation for t values
-
-    // compute sphere hit position and phi
-
-    // test sphere intersection against clipping parameters
+    // transform ray to object space
+    Vector3f oErr, dErr;
+    Ray ray = ( *WorldToObject )( r, &oErr, &dErr );
 
-    return true;
-}
+    // solve for the cylinder hits and test them against clipping parameters
+    QuadricTest test =
+      QuadricIntersectP( ray, oErr, dErr, 1, 0, 0, 0, -radius * radius, [&]( const Point3f& p ) {
+          return p.z >= zMin && p.z <= zMax && phiMaxTest( p.x, p.y );
+      } );
+    if ( test == QuadricTest::Uncertain )
+        return Shape::IntersectP( r, testAlphaTexture ); // too close to call without EFloat
+    return test == QuadricTest::Hit;
 }
+
+} /* namespace pbrt */
@@ -11,6 +11,7 @@
 
 #include "geometry.hpp"
 #include "pbrt.hpp"
+#include "quadric.hpp"
 #include "shape.hpp"
 
 namespace pbrt {
@@ -25,10 +26,11 @@ class Cylinder : public Shape {
                     bool testAlphaTexture ) const override;
     bool IntersectP( const Ray& r, bool testAlphaTexture ) const override;
 
-    inline Float Area() const { return ( zmax - zmin ) * phiMax * radius; }
+    inline Float Area() const { return ( zMax - zMin ) * phiMax * radius; }
 
   private:
     Float radius, zMin, zMax, phiMax;
+    PhiMaxTest phiMaxTest;
 };
 
 } /* namespace pbrt */
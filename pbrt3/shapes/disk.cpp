@@ -18,7 +18,8 @@ Disk::Disk( const Transform* ObjectToWorld, const Transform* WorldToObject, bool
   height{ height },
   radius{ radius },
   innerRadius{ innerRadius },
-  phiMax{ Clamp( phiMax, 0, 360 ) }
+  phiMax{ Radians( Clamp( phiMax, 0, 360 ) ) },
+  phiMaxTest{ this->phiMax }
 {
 }
 
@@ -76,6 +77,25 @@ bool Disk::Intersect( const Ray& r, Float* tHit, SurfaceInteraction* isect,
     return true;
 }
 
-bool Disk::IntersectP( const Ray& ray, bool testAlphaTexture ) const { return true; }
+bool Disk::IntersectP( const Ray& r, bool /*testAlphaTexture*/ ) const
+{
+    // transform ray to object space
+    Vector3f oErr, dErr;
+    Ray ray = ( *WorldToObject )( r, &oErr, &dErr );
+
+    // compute plane intersection for disk
+    if ( ray.d.z == 0 )
+        return false;
+    Float tShapeHit = ( height - ray.o.z ) / ray.d.z;
+    if ( tShapeHit <= 0 || tShapeHit >= ray.tMax )
+        return false;
+
+    // see if hit point is inside disk radii and phiMax
+    Point3f pHit = ray( tShapeHit );
+    Float dist2 = pHit.x * pHit.x + pHit.y * pHit.y;
+    if ( dist2 > radius * radius || dist2 < innerRadius * innerRadius )
+        return false;
+    return phiMaxTest( pHit.x, pHit.y );
+}
 
 } /* namespace pbrt */
@@ -10,6 +10,7 @@
 #define disk_hpp
 
 #include "pbrt.hpp"
+#include "quadric.hpp"
 #include "shape.hpp"
 
 namespace pbrt {
@@ -24,7 +25,7 @@ class Disk : public Shape {
     bool Intersect( const Ray& r, Float* tHit, SurfaceInteraction* isect,
                     bool testAlphaTexture ) const override;
 
-    bool IntersectP( const Ray& ray, bool testAlphaTexture = true ) const override;
+    bool IntersectP( const Ray& r, bool testAlphaTexture = true ) const override;
 
     Float Area() const
     {
@@ -34,6 +35,7 @@ class Disk : public Shape {
 
   private:
     const Float height, radius, innerRadius, phiMax;
+    const PhiMaxTest phiMaxTest;
 };
 
 } /* namespace pbrt */
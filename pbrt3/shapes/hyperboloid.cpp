@@ -18,7 +18,8 @@ Hyperboloid::Hyperboloid( const Transform* ObjectToWorld, const Transform* World
 : Shape{ ObjectToWorld, WorldToObject, reverseOrientation },
   p1{ point1 },
   p2{ point2 },
-  phiMax{ Radians( Clamp( tm, 0, 360 ) ) }
+  phiMax{ Radians( Clamp( tm, 0, 360 ) ) },
+  phiMaxTest{ phiMax }
 {
     Float radius1 = std::sqrt( p1.x * p1.x + p1.y * p1.y + p1.z * p1.z );
     Float radius2 = std::sqrt( p2.x * p2.x + p2.y * p2.y + p2.z * p2.z );
@@ -90,8 +91,8 @@ bool Hyperboloid::Intersect( const Ray& r, Float* tHit, SurfaceInteraction* isec
         if ( t1.UpperBound() > ray.tMax )
             return false;
         pHit = ray( static_cast< Float >( tShapeHit ) );
-        phi = ( pHit.z - p1.z ) / ( p2.z - p1.z );
-        Point3f pr = ( 1 - v ) * p1 + v * p2;
+        v = ( pHit.z - p1.z ) / ( p2.z - p1.z );
+        pr = ( 1 - v ) * p1 + v * p2;
         phi = std::atan2( pr.x * pHit.y - pHit.x * pr.y, pHit.x * pr.x + pHit.y * pr.y );
         if ( phi < 0 )
             phi += 2 * Pi;
@@ -141,6 +142,25 @@ bool Hyperboloid::Intersect( const Ray& r, Float* tHit, SurfaceInteraction* isec
     return true;
 }
 
-bool Hyperboloid::IntersectP( const Ray& ray, bool testAlphaTexture ) const { return true; }
+bool Hyperboloid::IntersectP( const Ray& r, bool testAlphaTexture ) const
+{
+    Vector3f oErr, dErr;
+    // transform ray to object space
+    Ray ray = ( *WorldToObject )( r, &oErr, &dErr );
+
+    // solve for the hyperboloid hits and test them against clipping parameters, measuring phi
+    // from the point on the p1-p2 line at the hit's height
+    QuadricTest test =
+      QuadricIntersectP( ray, oErr, dErr, ah, -ch, 0, 0, -1, [&]( const Point3f& p ) {
+          if ( p.z < zMin || p.z > zMax )
+              return false;
+          Float v = ( p.z - p1.z ) / ( p2.z - p1.z );
+          Point3f pr = ( 1 - v ) * p1 + v * p2;
+          return phiMaxTest( p.x * pr.x + p.y * pr.y, pr.x * p.y - p.x * pr.y );
+      } );
+    if ( test == QuadricTest::Uncertain )
+        return Shape::IntersectP( r, testAlphaTexture ); // too close to call without EFloat
+    return test == QuadricTest::Hit;
+}
 
 } /* namespace pbrt */
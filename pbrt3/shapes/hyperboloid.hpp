@@ -10,6 +10,7 @@
 #define hyperboloid_hpp
 
 #include "pbrt.hpp"
+#include "quadric.hpp"
 #include "shape.hpp"
 
 namespace pbrt {
@@ -24,7 +25,7 @@ class Hyperboloid : public Shape {
     bool Intersect( const Ray& r, Float* tHit, SurfaceInteraction* isect,
                     bool testAlphaTexture ) const override;
 
-    bool IntersectP( const Ray& ray, bool testAlphaTexture = true ) const override;
+    bool IntersectP( const Ray& r, bool testAlphaTexture = true ) const override;
 
 #define SQR( a ) ( ( a ) * ( a ) )
 #define QUAD( a ) ( ( SQR( a ) ) * ( SQR( a ) ) )
@@ -47,6 +48,7 @@ class Hyperboloid : public Shape {
   private:
     Point3f p1, p2;
     Float zMin, zMax, phiMax, rMax, ah, ch;
+    PhiMaxTest phiMaxTest;
 };
 
 } /* namespace pbrt */
@@ -18,7 +18,8 @@ Paraboloid::Paraboloid( const Transform* ObjectToWorld, const Transform* WorldTo
   radius{ radius },
   zMin{ std::min( z1, z2 ) },
   zMax{ std::max( z1, z2 ) },
-  phiMax{ Radians( Clamp( phiMax, 0, 360 ) ) }
+  phiMax{ Radians( Clamp( phiMax, 0, 360 ) ) },
+  phiMaxTest{ this->phiMax }
 {
 }
 
@@ -121,6 +122,20 @@ bool Paraboloid::Intersect( const Ray& r, Float* tHit, SurfaceInteraction* isect
     return true;
 }
 
-bool Paraboloid::IntersectP( const Ray& ray, bool testAlphaTexture ) const { return true; }
+bool Paraboloid::IntersectP( const Ray& r, bool testAlphaTexture ) const
+{
+    Vector3f oErr, dErr;
+    // transform ray to object space
+    Ray ray = ( *WorldToObject )( r, &oErr, &dErr );
+
+    // solve for the paraboloid hits and test them against clipping parameters
+    Float k = zMax / ( radius * radius );
+    QuadricTest test = QuadricIntersectP( ray, oErr, dErr, k, 0, -1, 0, 0, [&]( const Point3f& p ) {
+        return p.z >= zMin && p.z <= zMax && phiMaxTest( p.x, p.y );
+    } );
+    if ( test == QuadricTest::Uncertain )
+        return Shape::IntersectP( r, testAlphaTexture ); // too close to call without EFloat
+    return test == QuadricTest::Hit;
+}
 
 } /* namespace pbrt */
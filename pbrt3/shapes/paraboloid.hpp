@@ -10,6 +10,7 @@
 #define paraboloid_hpp
 
 #include "pbrt.hpp"
+#include "quadric.hpp"
 #include "shape.hpp"
 
 namespace pbrt {
@@ -24,15 +25,19 @@ class Paraboloid : public Shape {
     bool Intersect( const Ray& r, Float* tHit, SurfaceInteraction* isect,
                     bool testAlphaTexture ) const override;
 
-    bool IntersectP( const Ray& ray, bool testAlphaTexture = true ) const override;
+    bool IntersectP( const Ray& r, bool testAlphaTexture = true ) const override;
 
     Float Area() const
     {
-        return radius * std::sqrt( height * height + radius * radius ) * phiMax / 2;
+        Float radius2 = radius * radius;
+        Float k = 4 * zMax / radius2;
+        return ( radius2 * radius2 * phiMax / ( 12 * zMax * zMax ) ) *
+               ( std::pow( k * zMax + 1, 1.5f ) - std::pow( k * zMin + 1, 1.5f ) );
     }
 
   private:
     const Float radius, zMin, zMax, phiMax;
+    const PhiMaxTest phiMaxTest;
 };
 
 } /* namespace pbrt */
@@ -0,0 +1,121 @@
+//
+//  quadric.hpp
+//  pbrt3
+//
+//  Created by Ilya Rostovtsev on 10/17/26.
+//  Copyright © 2017 Ilya Rostovtsev. All rights reserved.
+//
+
+#ifndef quadric_hpp
+#define quadric_hpp
+
+#include "geometry.hpp"
+#include "pbrt.hpp"
+
+namespace pbrt {
+
+// phi <= phiMax for the point ( x, y ), with phi = atan2( y, x ) remapped to [ 0, 2pi ), decided
+// without the atan2: the point has to lie on the right side of the +x axis and of the phiMax
+// direction (both sides for phiMax <= pi, either side otherwise)
+class PhiMaxTest {
+  public:
+    explicit PhiMaxTest( Float phiMax )
+    : cosPhiMax{ std::cos( phiMax ) },
+      sinPhiMax{ std::sin( phiMax ) },
+      convex{ phiMax <= Pi },
+      full{ phiMax >= 2 * Pi }
+    {
+    }
+
+    bool operator()( Float x, Float y ) const
+    {
+        if ( full )
+            return true;
+        bool beforePhiMax = sinPhiMax * x - cosPhiMax * y >= 0;
+        return convex ? ( y >= 0 && beforePhiMax ) : ( y >= 0 || beforePhiMax );
+    }
+
+  private:
+    const Float cosPhiMax, sinPhiMax;
+    const bool convex, full;
+};
+
+enum class QuadricTest { Miss, Hit, Uncertain };
+
+// Plain-Float occlusion test for the quadrics' IntersectP(): intersects the object-space ray with
+//     kxy * ( x^2 + y^2 ) + kz * ( z - z0 )^2 + lz * ( z - z0 ) + c0 = 0,
+// keeps the nearest root in ( 0, tMax ) whose hit point passes inside( pHit ), and computes no
+// parametric data. Rounding and the ray's oErr and dErr are carried as first-order bounds on the
+// coefficients; at a root, |f'( t )| = sqrt( discriminant ), so each root's error is the
+// coefficients' error at t over that. Returns QuadricTest::Uncertain when the discriminant or a
+// root is within its bound of a decision, so the caller can redo the test with EFloat.
+template < typename InsideFunc >
+QuadricTest QuadricIntersectP( const Ray& ray, const Vector3f& oErr, const Vector3f& dErr,
+                               Float kxy, Float kz, Float lz, Float z0, Float c0,
+                               InsideFunc inside )
+{
+    Float ox = ray.o.x, oy = ray.o.y, oz = ray.o.z - z0;
+    Float dx = ray.d.x, dy = ray.d.y, dz = ray.d.z;
+    Float ozErr = oErr.z + gamma( 1 ) * std::abs( oz );
+
+    // compute quadratic coefficients and bounds on their error
+    Float dd = dx * dx + dy * dy, od = dx * ox + dy * oy, oo = ox * ox + oy * oy;
+    Float a = kxy * dd + kz * dz * dz;
+    Float b = 2 * ( kxy * od + kz * dz * oz ) + lz * dz;
+    Float c = kxy * oo + kz * oz * oz + lz * oz + c0;
+
+    Float adx = std::abs( dx ), ady = std::abs( dy ), adz = std::abs( dz );
+    Float aox = std::abs( ox ), aoy = std::abs( oy ), aoz = std::abs( oz );
+    Float akxy = std::abs( kxy ), akz = std::abs( kz ), alz = std::abs( lz );
+    Float aErr = gamma( 5 ) * ( akxy * dd + akz * dz * dz ) +
+                 2 * ( akxy * ( adx * dErr.x + ady * dErr.y ) + akz * adz * dErr.z );
+    Float bErr = gamma( 6 ) * ( 2 * ( akxy * ( adx * aox + ady * aoy ) + akz * adz * aoz ) +
+                                alz * adz ) +
+                 2 * ( akxy * ( adx * oErr.x + aox * dErr.x + ady * oErr.y + aoy * dErr.y ) +
+                       akz * ( adz * ozErr + aoz * dErr.z ) ) +
+                 alz * dErr.z;
+    Float cErr = gamma( 6 ) * ( akxy * oo + akz * oz * oz + alz * aoz + std::abs( c0 ) ) +
+                 2 * ( akxy * ( aox * oErr.x + aoy * oErr.y ) + akz * aoz * ozErr ) +
+                 alz * ozErr;
+
+    // solve quadratic equation for t values
+    double discrim = ( double )b * ( double )b - 4 * ( double )a * ( double )c;
+    double discrimErr = 2 * std::abs( b ) * bErr +
+                        4 * ( std::abs( a ) * cErr + std::abs( c ) * aErr ) +
+                        gamma( 3 ) * ( ( double )b * b + 4 * std::abs( ( double )a * c ) );
+    if ( discrim < -discrimErr )
+        return QuadricTest::Miss;
+    if ( discrim <= discrimErr || a == 0 )
+        return QuadricTest::Uncertain;
+    double rootDiscrim = std::sqrt( discrim );
+    double q = b < 0 ? -.5 * ( b - rootDiscrim ) : -.5 * ( b + rootDiscrim );
+    Float t0 = q / a, t1 = c / q;
+    if ( t0 > t1 )
+        std::swap( t0, t1 );
+    // twice the first-order bound, plus the rounding of the roots themselves
+    Float t0Err = 2 * ( aErr * t0 * t0 + bErr * std::abs( t0 ) + cErr ) / rootDiscrim +
+                  gamma( 3 ) * std::abs( t0 );
+    Float t1Err = 2 * ( aErr * t1 * t1 + bErr * std::abs( t1 ) + cErr ) / rootDiscrim +
+                  gamma( 3 ) * std::abs( t1 );
+
+    // check t0 and t1 for the nearest intersection inside the clipping parameters
+    if ( std::abs( t0 - ray.tMax ) <= t0Err || std::abs( t1 ) <= t1Err )
+        return QuadricTest::Uncertain;
+    if ( t0 > ray.tMax || t1 <= 0 )
+        return QuadricTest::Miss;
+    if ( t0 > 0 ) {
+        if ( t0 <= t0Err )
+            return QuadricTest::Uncertain;
+        if ( inside( ray( t0 ) ) )
+            return QuadricTest::Hit;
+    } else if ( t0 >= -t0Err )
+        return QuadricTest::Uncertain;
+    if ( std::abs( t1 - ray.tMax ) <= t1Err )
+        return QuadricTest::Uncertain;
+    if ( t1 > ray.tMax )
+        return QuadricTest::Miss;
+    return inside( ray( t1 ) ) ? QuadricTest::Hit : QuadricTest::Miss;
+}
+
+} /* namespace pbrt */
+#endif /* quadric_hpp */
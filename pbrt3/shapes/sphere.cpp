@@ -22,7 +22,8 @@ Sphere::Sphere( const Transform* ObjectToWorld, const Transform* WorldToObject,
   zMax{ Clamp( std::max( zMin, zMax ), -radius, radius ) },
   thetaMin{ std::acos( Clamp( zMin / radius, -1, 1 ) ) },
   thetaMax{ std::acos( Clamp( zMax / radius, -1, 1 ) ) },
-  phiMax{ Radians( Clamp( phiMax, 0, 360 ) ) }
+  phiMax{ Radians( Clamp( phiMax, 0, 360 ) ) },
+  phiMaxTest{ this->phiMax }
 {
 }
 
@@ -31,6 +32,48 @@ Bounds3f Sphere::ObjectBound() const
     return Bounds3f{ Point3f( -radius, -radius, zMin ), Point3f( radius, radius, zMax ) };
 }
 
+SurfaceInteraction SphereInteraction( const Point3f& pHit, Float phi, Float radius, Float thetaMin,
+                                      Float thetaMax, Float phiMax, const Vector3f& wo, Float time,
+                                      const Shape* shape )
+{
+    // find parameteric representation of sphere hit
+    Float u = phi / phiMax;
+    Float theta = std::acos( Clamp( pHit.z / radius, -1, 1 ) );
+    Float v = ( theta - thetaMin ) / ( thetaMax - thetaMin );
+    // compute sphere dp/du and dp/dv partial derivatives
+    Float zRadius = std::sqrt( pHit.x * pHit.x + pHit.y * pHit.y );
+    Float invZRadius = static_cast< Float >( 1 ) / zRadius;
+    Float cosPhi = pHit.x * invZRadius;
+    Float sinPhi = pHit.y * invZRadius;
+    Vector3f dpdu( -phiMax * pHit.y, phiMax * pHit.x, 0 );
+    Vector3f dpdv = ( thetaMax - thetaMin ) *
+                    Vector3f( pHit.z * cosPhi, pHit.z * sinPhi, -radius * std::sin( theta ) );
+    // compute sphere dn/du and dn/dv partial derivatives
+    Vector3f d2Pduu = -phiMax * phiMax * Vector3f( pHit.x, pHit.y, 0 );
+    Vector3f d2Pduv = ( thetaMax - thetaMin ) * pHit.z * phiMax * Vector3f( -sinPhi, cosPhi, 0 );
+    Vector3f d2Pdvv =
+      -( thetaMax - thetaMin ) * ( thetaMax - thetaMin ) * Vector3f( pHit.x, pHit.y, pHit.z );
+    // compute coefficients for fundamental forms
+    // compute dn/du and dn/dv from fundamental forms coefficients
+    Float E = Dot( dpdu, dpdu );
+    Float F = Dot( dpdu, dpdv );
+    Float G = Dot( dpdv, dpdv );
+    Vector3f N = Normalize( Cross( dpdu, dpdv ) );
+    Float e = Dot( N, d2Pduu );
+    Float f = Dot( N, d2Pduv );
+    Float g = Dot( N, d2Pdvv );
+    // compute error bounds for sphere intersection
+    Float invEGF2 = static_cast< Float >( 1 ) / ( E * G - F * F );
+    Normal3f dndu =
+      Normal3f{ ( f * F - e * G ) * invEGF2 * dpdu + ( e * G - g * E ) * invEGF2 * dpdv };
+    Normal3f dndv =
+      Normal3f{ ( g * F - f * G ) * invEGF2 * dpdu + ( f * F - g * E ) * invEGF2 * dpdv };
+    // initialize SurfaceInteraction from parametric information
+    Vector3f pError;
+    return SurfaceInteraction{ pHit, pError, Point2f( u, v ), wo, dpdu, dpdv, dndu, dndv, time,
+                               shape };
+}
+
 bool Sphere::Intersect( const Ray& r, Float* tHit, SurfaceInteraction* isect,
                         bool testAlphaTexture ) const
 {
@@ -43,7 +86,7 @@ bool Sphere::Intersect( const Ray& r, Float* tHit, SurfaceInteraction* isect,
 
     // compute quadratic sphere coefficients
     EFloat ox{ ray.o.x, oErr.x }, oy{ ray.o.y, oErr.y }, oz{ ray.o.z, oErr.z };
-    EFloat dx{ ray.d.x, oErr.x }, dy{ ray.d.y, oErr.y }, dz{ ray.d.z, oErr.z };
+    EFloat dx{ ray.d.x, dErr.x }, dy{ ray.d.y, dErr.y }, dz{ ray.d.z, dErr.z };
 
     EFloat a = dx * dx + dy * dy + dz * dz;
     EFloat b = 2 * ( dx * ox + dy * oy + dz * oz );
@@ -95,42 +138,8 @@ bool Sphere::Intersect( const Ray& r, Float* tHit, SurfaceInteraction* isect,
             return false;
     }
 
-    // find parameteric representation of sphere hit
-    Float u = phi / phiMax;
-    Float theta = std::acos( Clamp( pHit.z / radius, -1, 1 ) );
-    Float v = ( theta - thetaMin ) / ( thetaMax - thetaMin );
-    // compute sphere dp/du and dp/dv partial derivatives
-    Float zRadius = std::sqrt( pHit.x * pHit.x + pHit.y * pHit.y );
-    Float invZRadius = static_cast< Float >( 1 ) / zRadius;
-    Float cosPhi = pHit.x * invZRadius;
-    Float sinPhi = pHit.y * invZRadius;
-    Vector3f dpdu( -phiMax * pHit.y, phiMax * pHit.x, 0 );
-    Vector3f dpdv = ( thetaMax - thetaMin ) *
-                    Vector3f( pHit.z * cosPhi, pHit.z * sinPhi, -radius * std::sin( theta ) );
-    // compute sphere dn/du and dn/dv partial derivatives
-    Vector3f d2Pduu = -phiMax * phiMax * Vector3f( pHit.x, pHit.y, 0 );
-    Vector3f d2Pduv = ( thetaMax - thetaMin ) * pHit.z * phiMax * Vector3f( -sinPhi, cosPhi, 0 );
-    Vector3f d2Pdvv =
-      -( thetaMax - thetaMin ) * ( thetaMax - thetaMin ) * Vector3f( pHit.x, pHit.y, pHit.z );
-    // compute coefficients for fundamental forms
-    // compute dn/du and dn/dv from fundamental forms coefficients
-    Float E = Dot( dpdu, dpdu );
-    Float F = Dot( dpdu, dpdv );
-    Float G = Dot( dpdv, dpdv );
-    Vector3f N = Normalize( Cross( dpdu, dpdv ) );
-    Float e = Dot( N, d2Pduu );
-    Float f = Dot( N, d2Pduv );
-    Float g = Dot( N, d2Pdvv );
-    // compute error bounds for sphere intersection
-    Float invEGF2 = static_cast< Float >( 1 ) / ( E * G - F * F );
-    Normal3f dndu =
-      Normal3f{ ( f * F - e * G ) * invEGF2 * dpdu + ( e * G - g * E ) * invEGF2 * dpdv };
-    Normal3f dndv =
-      Normal3f{ ( g * F - f * G ) * invEGF2 * dpdu + ( f * F - g * E ) * invEGF2 * dpdv };
-    // initialize SurfaceInteraction from parametric information
-    Vector3f pError;
-    *isect = ( *ObjectToWorld )( SurfaceInteraction{ pHit, pError, Point2f( u, v ), -ray.d, dpdu,
-                                                     dpdv, dndu, dndv, ray.time, this } );
+    *isect = ( *ObjectToWorld )( SphereInteraction( pHit, phi, radius, thetaMin, thetaMax, phiMax,
+                                                    -ray.d, ray.time, this ) );
     // update tHit for quadric intersection
     *tHit = static_cast< Float >( tShapeHit );
     return true;
@@ -138,20 +147,19 @@ bool Sphere::Intersect( const Ray& r, Float* tHit, SurfaceInteraction* isect,
 
 bool Sphere::IntersectP( const Ray& r, bool testAlphaTexture ) const
 {
-    Float phi;
-    Point3f pHit;
-
     // transform Ray to object space
+    Vector3f oErr, dErr;
+    Ray ray = ( *WorldToObject )( r, &oErr, &dErr );
 
-    // compute quadratic sphere coefficients
-
-    // solve quadratic equation for t values
-
-    // compute sphere hit position and phi
-
-    // test sphere intersection against clipping parameters
-
-    return true;
+    // solve for the sphere hits and test them against clipping parameters
+    QuadricTest test =
+      QuadricIntersectP( ray, oErr, dErr, 1, 1, 0, 0, -radius * radius, [&]( const Point3f& p ) {
+          return !( zMin > -radius && p.z < zMin ) && !( zMax < radius && p.z > zMax ) &&
+                 phiMaxTest( p.x, p.y );
+      } );
+    if ( test == QuadricTest::Uncertain )
+        return Shape::IntersectP( r, testAlphaTexture ); // too close to call without EFloat
+    return test == QuadricTest::Hit;
 }
 
 } /* namespace pbrt */
@@ -10,6 +10,7 @@
 #define sphere_hpp
 
 #include "pbrt.hpp"
+#include "quadric.hpp"
 #include "shape.hpp"
 
 namespace pbrt {
@@ -28,7 +29,15 @@ class Sphere : public Shape {
     const Float radius;
     const Float zMin, zMax;
     const Float thetaMin, thetaMax, phiMax;
+    const PhiMaxTest phiMaxTest;
 };
 
+// The object-space SurfaceInteraction that Sphere::Intersect() reports at pHit, for a sphere of
+// the given parameters centered at the origin; phi is atan2( pHit.y, pHit.x ) mapped to
+// [ 0, 2pi ). SphereSet uses it to describe its particles exactly as Spheres.
+SurfaceInteraction SphereInteraction( const Point3f& pHit, Float phi, Float radius, Float thetaMin,
+                                      Float thetaMax, Float phiMax, const Vector3f& wo, Float time,
+                                      const Shape* shape );
+
 } /* namespace pbrt */
 #endif /* sphere_hpp */
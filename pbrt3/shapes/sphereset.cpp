@@ -0,0 +1,327 @@
+//
+//  sphereset.cpp
+//  pbrt3
+//
+//  Created by Ilya Rostovtsev on 10/17/26.
+//  Copyright © 2017 Ilya Rostovtsev. All rights reserved.
+//
+
+#include "sphereset.hpp"
+#include "bvh.hpp"
+#include "interaction.hpp"
+#include "memory.hpp"
+#include "sphere.hpp"
+#include "stats.hpp"
+
+namespace pbrt {
+
+STAT_MEMORY_COUNTER( "Memory/Sphere sets", sphereSetBytes );
+STAT_COUNTER( "Scene/Spheres in sphere sets", nSetSpheres );
+
+struct SphereSet::BuildSphere
+{
+    Point3f center;
+    Float radius;
+
+    Bounds3f Bounds() const
+    {
+        return Bounds3f{ center - Vector3f{ radius, radius, radius },
+                         center + Vector3f{ radius, radius, radius } };
+    }
+};
+
+SphereSet::SphereSet( const Transform* ObjectToWorld, const Transform* WorldToObject,
+                      bool reverseOrientation, int nSpheres, const Point3f* centers,
+                      const Float* radii )
+: Shape{ ObjectToWorld, WorldToObject, reverseOrientation }, nSpheres{ nSpheres }
+{
+    ProfilePhase _( Prof::AccelConstruction );
+    CHECK_GT( nSpheres, 0 );
+    std::vector< BuildSphere > spheres( nSpheres );
+    for ( int i = 0; i < nSpheres; ++i ) {
+        spheres[ i ].center = centers[ i ];
+        spheres[ i ].radius = radii[ i ];
+        area += 4 * Pi * radii[ i ] * radii[ i ];
+    }
+
+    // every leaf holds one group, so there are at most ( nSpheres / SimdWidth + 1 ) * 2 nodes
+    std::vector< LinearBVHNode > buildNodes;
+    buildNodes.reserve( 2 * ( nSpheres / SimdWidth + 1 ) );
+    groups = AllocAligned< SphereGroup >( nSpheres / SimdWidth + 1 );
+    recursiveBuild( spheres, 0, nSpheres, 0, buildNodes );
+
+    totalNodes = ( int )buildNodes.size();
+    nodes = AllocAligned< LinearBVHNode >( totalNodes );
+    std::copy( buildNodes.begin(), buildNodes.end(), nodes );
+    sphereSetBytes += totalNodes * sizeof( LinearBVHNode ) + nGroups * sizeof( SphereGroup );
+    nSetSpheres += nSpheres;
+}
+
+SphereSet::~SphereSet()
+{
+    sphereSetBytes -= totalNodes * sizeof( LinearBVHNode ) + nGroups * sizeof( SphereGroup );
+    FreeAligned( nodes );
+    FreeAligned( groups );
+}
+
+Bounds3f SphereSet::ObjectBound() const { return nodes[ 0 ].bounds; }
+
+static PBRT_CONSTEXPR int SphereSetBuckets = 12;
+
+// Long-tailed particle distributions make SAH peel off a group at a time, so below this depth
+// nodes are split into equal halves instead. Those add at most log2( nSpheres / SimdWidth ) < 30
+// more levels, which keeps every leaf within the 64 entries of the traversal stack.
+static PBRT_CONSTEXPR int SphereSetMaxSAHDepth = 32;
+
+// Spheres are split with binned SAH on their centers, like BVHAccel, except that the split is
+// moved to the nearest multiple of SimdWidth spheres so that every group but the last is full.
+int SphereSet::recursiveBuild( std::vector< BuildSphere >& spheres, int start, int end, int depth,
+                               std::vector< LinearBVHNode >& buildNodes )
+{
+    int nodeIndex = ( int )buildNodes.size();
+    buildNodes.emplace_back();
+
+    Bounds3f bounds, centroidBounds;
+    for ( int i = start; i < end; ++i ) {
+        bounds = Union( bounds, spheres[ i ].Bounds() );
+        centroidBounds = Union( centroidBounds, spheres[ i ].center );
+    }
+    buildNodes[ nodeIndex ].bounds = bounds;
+
+    int n = end - start;
+    if ( n <= SimdWidth ) {
+        // pack the leaf's spheres into its group, padding with copies of the first one
+        SphereGroup& group = groups[ nGroups ];
+        for ( int lane = 0; lane < SimdWidth; ++lane ) {
+            const BuildSphere& s = spheres[ lane < n ? start + lane : start ];
+            for ( int c = 0; c < 3; ++c )
+                group.center[ c ][ lane ] = s.center[ c ];
+            group.radius[ lane ] = s.radius;
+        }
+        buildNodes[ nodeIndex ].primitivesOffset = nGroups++;
+        buildNodes[ nodeIndex ].nPrimitives = 1;
+        return nodeIndex;
+    }
+
+    // find the cheapest SAH bucket boundary along the axis of largest centroid extent
+    int dim = centroidBounds.MaximumExtent();
+    int mid = start + n / 2;
+    Float extent = centroidBounds.pMax[ dim ] - centroidBounds.pMin[ dim ];
+    if ( extent > 0 && depth < SphereSetMaxSAHDepth ) {
+        int counts[ SphereSetBuckets ] = {};
+        Bounds3f bucketBounds[ SphereSetBuckets ];
+        auto bucket = [&]( const BuildSphere& s ) {
+            int b = ( int )( SphereSetBuckets * ( s.center[ dim ] - centroidBounds.pMin[ dim ] ) /
+                             extent );
+            return std::min( b, SphereSetBuckets - 1 );
+        };
+        for ( int i = start; i < end; ++i ) {
+            int b = bucket( spheres[ i ] );
+            ++counts[ b ];
+            bucketBounds[ b ] = Union( bucketBounds[ b ], spheres[ i ].Bounds() );
+        }
+        Float cost[ SphereSetBuckets - 1 ];
+        Bounds3f b0, b1;
+        int count0 = 0, count1 = 0;
+        for ( int i = 0; i < SphereSetBuckets - 1; ++i ) {
+            b0 = Union( b0, bucketBounds[ i ] );
+            count0 += counts[ i ];
+            cost[ i ] = count0 > 0 ? count0 * b0.SurfaceArea() : 0;
+        }
+        for ( int i = SphereSetBuckets - 1; i > 0; --i ) {
+            b1 = Union( b1, bucketBounds[ i ] );
+            count1 += counts[ i ];
+            cost[ i - 1 ] += count1 > 0 ? count1 * b1.SurfaceArea() : 0;
+        }
+        int split = 0, nBelow = counts[ 0 ];
+        for ( int i = 1, below = counts[ 0 ]; i < SphereSetBuckets - 1; ++i ) {
+            below += counts[ i ];
+            if ( cost[ i ] < cost[ split ] ) {
+                split = i;
+                nBelow = below;
+            }
+        }
+        mid = start + nBelow;
+    }
+
+    // round to whole groups, keeping both sides nonempty, and partition exactly there
+    int nLeft = ( mid - start + SimdWidth / 2 ) / SimdWidth * SimdWidth;
+    nLeft = Clamp( nLeft, SimdWidth, ( n - 1 ) / SimdWidth * SimdWidth );
+    mid = start + nLeft;
+    std::nth_element( &spheres[ start ], &spheres[ mid ], &spheres[ end - 1 ] + 1,
+                      [dim]( const BuildSphere& a, const BuildSphere& b ) {
+                          return a.center[ dim ] < b.center[ dim ];
+                      } );
+
+    // the first child directly follows its parent
+    recursiveBuild( spheres, start, mid, depth + 1, buildNodes );
+    int secondChild = recursiveBuild( spheres, mid, end, depth + 1, buildNodes );
+    buildNodes[ nodeIndex ].secondChildOffset = secondChild;
+    buildNodes[ nodeIndex ].nPrimitives = 0;
+    buildNodes[ nodeIndex ].axis = dim;
+    return nodeIndex;
+}
+
+// Intersects the ray with every sphere of group; returns the lanes hit in ( 0, tMax ) and the
+// parametric distance of each. The distance from the center to the ray is computed directly
+// rather than from b^2 - 4ac, which would cancel |o - center|^2 against radius^2 and lose tiny
+// spheres entirely. A root is only trusted once it is positive beyond its first-order error
+// bound, which plays the role of Sphere::Intersect()'s EFloat test against zero.
+static SimdMask GroupHitMask( const SphereGroup& group, const Ray& ray, const Vector3f& oErr,
+                              const Vector3f& dErr, SimdFloat* tHit )
+{
+    // ray origin relative to each center, and the quadratic a t^2 - 2 b t + c
+    SimdFloat fx = SimdFloat{ ray.o.x } - SimdFloat::Load( group.center[ 0 ] );
+    SimdFloat fy = SimdFloat{ ray.o.y } - SimdFloat::Load( group.center[ 1 ] );
+    SimdFloat fz = SimdFloat{ ray.o.z } - SimdFloat::Load( group.center[ 2 ] );
+    SimdFloat radius = SimdFloat::Load( group.radius );
+    SimdFloat r2 = radius * radius;
+    Float a = Dot( ray.d, ray.d ), invA = 1 / a;
+    SimdFloat b = -( fx * ray.d.x + fy * ray.d.y + fz * ray.d.z );
+
+    // squared distance between the center and the ray's closest approach to it
+    SimdFloat s = b * invA;
+    SimdFloat lx = fx + s * ray.d.x, ly = fy + s * ray.d.y, lz = fz + s * ray.d.z;
+    SimdFloat discrim = r2 - ( lx * lx + ly * ly + lz * lz );
+    SimdFloat zero{ 0.f };
+    SimdMask hits = discrim >= zero;
+    if ( hits.None() )
+        return hits;
+
+    // compute both roots without cancellation
+    SimdFloat f2 = fx * fx + fy * fy + fz * fz;
+    SimdFloat c = f2 - r2;
+    SimdFloat rootDiscrim = Sqrt( Max( zero, a * discrim ) );
+    SimdFloat q = Select( b < zero, b - rootDiscrim, b + rootDiscrim );
+    SimdFloat t0 = c / q, t1 = q * invA;
+    SimdFloat tNear = Min( t0, t1 ), tFar = Max( t0, t1 );
+
+    // error bounds, doubled for safety: |f'( t )| = 2 sqrt( a discrim ) at either root
+    SimdFloat ax = Abs( fx ), ay = Abs( fy ), az = Abs( fz );
+    Vector3f ad = Abs( ray.d );
+    SimdFloat fErrX = oErr.x + gamma( 1 ) * ax, fErrY = oErr.y + gamma( 1 ) * ay,
+              fErrZ = oErr.z + gamma( 1 ) * az;
+    Float aErr = gamma( 3 ) * a + 2 * Dot( ad, dErr );
+    SimdFloat bErr = gamma( 3 ) * ( ax * ad.x + ay * ad.y + az * ad.z ) + fErrX * ad.x +
+                     fErrY * ad.y + fErrZ * ad.z + ax * dErr.x + ay * dErr.y + az * dErr.z;
+    SimdFloat cErr = gamma( 4 ) * ( f2 + r2 ) + 2.f * ( ax * fErrX + ay * fErrY + az * fErrZ );
+    SimdFloat invSlope = 1.f / rootDiscrim;
+    SimdFloat nearErr = ( aErr * tNear * tNear + 2.f * bErr * Abs( tNear ) + cErr ) * invSlope;
+    SimdFloat farErr = ( aErr * tFar * tFar + 2.f * bErr * Abs( tFar ) + cErr ) * invSlope;
+
+    // take the nearest root that is conservatively greater than zero
+    SimdMask nearValid = tNear > nearErr;
+    *tHit = Select( nearValid, tNear, tFar );
+    hits &= nearValid | ( tFar > farErr );
+    return hits & ( *tHit < SimdFloat{ ray.tMax } );
+}
+
+bool SphereSet::Intersect( const Ray& r, Float* tHit, SurfaceInteraction* isect,
+                           bool /*testAlphaTexture*/ ) const
+{
+    // transform ray to object space
+    Vector3f oErr, dErr;
+    Ray ray = ( *WorldToObject )( r, &oErr, &dErr );
+    RayPrecomputed pre( ray );
+
+    // only the closest sphere is remembered during traversal
+    int closestGroup = -1, closestLane = 0;
+    int toVisitOffset = 0, currentNodeIndex = 0;
+    int nodesToVisit[ 64 ];
+    while ( true ) {
+        const LinearBVHNode* node = &nodes[ currentNodeIndex ];
+        if ( node->bounds.IntersectP( ray, pre ) ) {
+            if ( node->nPrimitives > 0 ) {
+                SimdFloat t;
+                SimdMask hits = GroupHitMask( groups[ node->primitivesOffset ], ray, oErr, dErr,
+                                              &t );
+                if ( hits.Any() ) {
+                    closestLane = MinLane( t, hits );
+                    closestGroup = node->primitivesOffset;
+                    ray.tMax = t[ closestLane ];
+                }
+                if ( toVisitOffset == 0 )
+                    break;
+                currentNodeIndex = nodesToVisit[ --toVisitOffset ];
+            } else {
+                // put far BVH node on nodesToVisit stack, advance to near node
+                CHECK_LT( toVisitOffset, 64 );
+                if ( pre.dirIsNeg[ node->axis ] ) {
+                    nodesToVisit[ toVisitOffset++ ] = currentNodeIndex + 1;
+                    currentNodeIndex = node->secondChildOffset;
+                } else {
+                    nodesToVisit[ toVisitOffset++ ] = node->secondChildOffset;
+                    currentNodeIndex = currentNodeIndex + 1;
+                }
+            }
+        } else {
+            if ( toVisitOffset == 0 )
+                break;
+            currentNodeIndex = nodesToVisit[ --toVisitOffset ];
+        }
+    }
+    if ( closestGroup < 0 )
+        return false;
+
+    // describe the hit as Sphere::Intersect() would, relative to the particle's center
+    const SphereGroup& group = groups[ closestGroup ];
+    Vector3f center{ group.center[ 0 ][ closestLane ], group.center[ 1 ][ closestLane ],
+                     group.center[ 2 ][ closestLane ] };
+    Float radius = group.radius[ closestLane ];
+    Point3f pHit = ( ray.o - center ) + ray.d * ray.tMax;
+    // refine sphere intersection point
+    if ( pHit.x == 0 && pHit.y == 0 )
+        pHit.x = 1e-5f * radius;
+    Float phi = std::atan2( pHit.y, pHit.x );
+    if ( phi < 0 )
+        phi += 2 * Pi;
+    static const Float thetaMin = std::acos( Float( -1 ) ), thetaMax = std::acos( Float( 1 ) ),
+                       phiMax = Radians( 360 );
+    SurfaceInteraction si = SphereInteraction( pHit, phi, radius, thetaMin, thetaMax, phiMax,
+                                               -ray.d, ray.time, this );
+    si.p += center;
+    *isect = ( *ObjectToWorld )( si );
+    *tHit = ray.tMax;
+    return true;
+}
+
+bool SphereSet::IntersectP( const Ray& r, bool /*testAlphaTexture*/ ) const
+{
+    // transform ray to object space
+    Vector3f oErr, dErr;
+    Ray ray = ( *WorldToObject )( r, &oErr, &dErr );
+    RayPrecomputed pre( ray );
+
+    // any hit will do, so the first one found ends traversal
+    int toVisitOffset = 0, currentNodeIndex = 0;
+    int nodesToVisit[ 64 ];
+    while ( true ) {
+        const LinearBVHNode* node = &nodes[ currentNodeIndex ];
+        if ( node->bounds.IntersectP( ray, pre ) ) {
+            if ( node->nPrimitives > 0 ) {
+                SimdFloat t;
+                if ( GroupHitMask( groups[ node->primitivesOffset ], ray, oErr, dErr, &t ).Any() )
+                    return true;
+                if ( toVisitOffset == 0 )
+                    break;
+                currentNodeIndex = nodesToVisit[ --toVisitOffset ];
+            } else {
+                CHECK_LT( toVisitOffset, 64 );
+                if ( pre.dirIsNeg[ node->axis ] ) {
+                    nodesToVisit[ toVisitOffset++ ] = currentNodeIndex + 1;
+                    currentNodeIndex = node->secondChildOffset;
+                } else {
+                    nodesToVisit[ toVisitOffset++ ] = node->secondChildOffset;
+                    currentNodeIndex = currentNodeIndex + 1;
+                }
+            }
+        } else {
+            if ( toVisitOffset == 0 )
+                break;
+            currentNodeIndex = nodesToVisit[ --toVisitOffset ];
+        }
+    }
+    return false;
+}
+
+} /* namespace pbrt */
@@ -0,0 +1,59 @@
+//
+//  sphereset.hpp
+//  pbrt3
+//
+//  Created by Ilya Rostovtsev on 10/17/26.
+//  Copyright © 2017 Ilya Rostovtsev. All rights reserved.
+//
+
+#ifndef sphereset_hpp
+#define sphereset_hpp
+
+#include "pbrt.hpp"
+#include "shape.hpp"
+#include "simd.hpp"
+
+namespace pbrt {
+
+struct LinearBVHNode;
+
+// SimdWidth spheres in structure-of-arrays form, tested against a ray in one go. Lanes past the
+// end of a partial group repeat its first sphere, which keeps the kernel free of lane masks.
+struct PBRT_SIMD_ALIGN SphereGroup
+{
+    Float center[ 3 ][ SimdWidth ], radius[ SimdWidth ];
+};
+
+// Many small full spheres (particles, sand, spray) as a single Shape sharing one pair of
+// transforms. The spheres are only kept as SphereGroups, ordered as the leaves of the set's own
+// BVH, whose leaves are exactly one group each: 16 bytes per sphere plus about 8 bytes of tree,
+// where a Sphere per particle costs several hundred with its transforms. A hit is reported with
+// the same SurfaceInteraction as Sphere::Intersect() on a Sphere of that radius placed at the
+// center.
+class SphereSet : public Shape {
+  public:
+    SphereSet( const Transform* ObjectToWorld, const Transform* WorldToObject,
+               bool reverseOrientation, int nSpheres, const Point3f* centers, const Float* radii );
+    ~SphereSet();
+
+    Bounds3f ObjectBound() const override;
+    bool Intersect( const Ray& r, Float* tHit, SurfaceInteraction* isect,
+                    bool testAlphaTexture = true ) const override;
+    bool IntersectP( const Ray& r, bool testAlphaTexture = true ) const override;
+    Float Area() const { return area; }
+
+  private:
+    struct BuildSphere;
+    int recursiveBuild( std::vector< BuildSphere >& spheres, int start, int end, int depth,
+                        std::vector< LinearBVHNode >& buildNodes );
+
+    const int nSpheres;
+    Float area = 0;
+    SphereGroup* groups = nullptr;
+    int nGroups = 0;
+    LinearBVHNode* nodes = nullptr;
+    int totalNodes = 0;
+};
+
+} /* namespace pbrt */
+#endif /* sphereset_hpp */
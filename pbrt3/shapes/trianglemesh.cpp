@@ -21,8 +21,7 @@ TriangleMesh::TriangleMesh( const Transform& ObjectToWorld, int nTriangles,
   alphaMask{ alphaMask }
 {
     p.reset( new Point3f[ nVertices ] );
-    for ( auto i = 0; i < nVertices; ++i )
-        p[ i ] = ObjectToWorld( P[ i ] );
+    ObjectToWorld.TransformPoints( P, nVertices, p.get() );
 
     if ( UV ) {
         uv.reset( new Point2f[ nVertices ] );
@@ -30,49 +29,57 @@ TriangleMesh::TriangleMesh( const Transform& ObjectToWorld, int nTriangles,
     }
     if ( N ) {
         n.reset( new Normal3f[ nVertices ] );
-        for ( int i = 0; i < nVertices; ++i )
-            n[ i ] = ObjectToWorld( N[ i ] );
+        ObjectToWorld.TransformNormals( N, nVertices, n.get() );
     }
     if ( S ) {
         s.reset( new Vector3f[ nVertices ] );
-        for ( int i = 0; i < nVertices; ++i )
-            s[ i ] = ObjectToWorld( S[ i ] );
+        ObjectToWorld.TransformVectors( S, nVertices, s.get() );
     }
 }
 
-Triangle::Triangle( const Transform* ObjectToWorld, const Transform* WorldToObject,
-                    bool reverseOrientation, const std::shared_ptr< TriangleMesh >& mesh,
-                    int triNumber )
-: Shape{ ObjectToWorld, WorldToObject, reverseOrientation },
-  mesh{ mesh },
-  v{ &mesh->vertexIndices[ 3 * triNumber ] }
+Bounds3f TriangleMesh::TriangleBound( int triIndex ) const
 {
+    const int* v = &vertexIndices[ 3 * triIndex ];
+    return Union( Bounds3f( p[ v[ 0 ] ], p[ v[ 1 ] ] ), p[ v[ 2 ] ] );
 }
 
-Bounds3f Triangle::ObjectBound() const
+Float TriangleMesh::TriangleArea( int triIndex ) const
 {
-    const Point3f& p0 = mesh->p[ v[ 0 ] ];
-    const Point3f& p1 = mesh->p[ v[ 1 ] ];
-    const Point3f& p2 = mesh->p[ v[ 2 ] ];
-    return Union( Bounds3f( ( *WorldToObject )( p0 ), ( *WorldToObject )( p1 ) ),
-                  ( *WorldToObject )( p2 ) );
+    const int* v = &vertexIndices[ 3 * triIndex ];
+    const Point3f& p0 = p[ v[ 0 ] ];
+    const Point3f& p1 = p[ v[ 1 ] ];
+    const Point3f& p2 = p[ v[ 2 ] ];
+    return 0.5f * Cross( p1 - p0, p2 - p0 ).Length();
 }
 
-Bounds3f Triangle::WorldBound() const
+void TriangleMesh::GetUVs( int triIndex, Point2f triUV[ 3 ] ) const
 {
-    const Point3f& p0 = mesh->p[ v[ 0 ] ];
-    const Point3f& p1 = mesh->p[ v[ 1 ] ];
-    const Point3f& p2 = mesh->p[ v[ 2 ] ];
-    return Union( Bounds3f( p0, p1 ), p2 );
+    if ( uv ) {
+        const int* v = &vertexIndices[ 3 * triIndex ];
+        triUV[ 0 ] = uv[ v[ 0 ] ];
+        triUV[ 1 ] = uv[ v[ 1 ] ];
+        triUV[ 2 ] = uv[ v[ 2 ] ];
+    } else {
+        triUV[ 0 ] = Point2f{ 0, 0 };
+        triUV[ 1 ] = Point2f{ 1, 0 };
+        triUV[ 2 ] = Point2f{ 1, 1 };
+    }
 }
 
-bool Triangle::Intersect( const Ray& ray, Float* tHit, SurfaceInteraction* isect,
-                          bool testAlphaTexture ) const
+bool TriangleMesh::IntersectTriangle( int triIndex, const Ray& ray, TriangleHit* hit,
+                                     bool testAlphaTexture ) const
 {
-    // Get triangle verteices in p0, p1, and p2
-    const Point3f& p0 = mesh->p[ v[ 0 ] ];
-    const Point3f& p1 = mesh->p[ v[ 1 ] ];
-    const Point3f& p2 = mesh->p[ v[ 2 ] ];
+    return IntersectTriangle( triIndex, ray, RayPrecomputed( ray ), hit, testAlphaTexture );
+}
+
+bool TriangleMesh::IntersectTriangle( int triIndex, const Ray& ray, const RayPrecomputed& pre,
+                                     TriangleHit* hit, bool testAlphaTexture ) const
+{
+    // Get triangle vertices in p0, p1, and p2
+    const int* v = &vertexIndices[ 3 * triIndex ];
+    const Point3f& p0 = p[ v[ 0 ] ];
+    const Point3f& p1 = p[ v[ 1 ] ];
+    const Point3f& p2 = p[ v[ 2 ] ];
 
     // perform ray-triangle intersection test
     //      transform triangle vertices to ray coordinate space
@@ -81,23 +88,13 @@ bool Triangle::Intersect( const Ray& ray, Float* tHit, SurfaceInteraction* isect
     Point3f p1t = p1 - Vector3f( ray.o );
     Point3f p2t = p2 - Vector3f( ray.o );
 
-    //          permute components of triangle vertices and ray direction
-    int kz = MaxDimension( Abs( ray.d ) );
-    int kx = kz + 1;
-    if ( kx == 3 )
-        kx = 0;
-    int ky = kx + 1;
-    if ( ky == 3 )
-        ky = 0;
-    Vector3f d = Permute( ray.d, kx, ky, kz );
-    p0t = Permute( p0t, kx, ky, kz );
-    p1t = Permute( p1t, kx, ky, kz );
-    p2t = Permute( p2t, kx, ky, kz );
+    //          permute components of triangle vertices
+    p0t = Permute( p0t, pre.kx, pre.ky, pre.kz );
+    p1t = Permute( p1t, pre.kx, pre.ky, pre.kz );
+    p2t = Permute( p2t, pre.kx, pre.ky, pre.kz );
 
     //          apply shear transformation to translated vertex positions
-    Float Sx = -d.x / d.z;
-    Float Sy = -d.y / d.z;
-    Float Sz = -1.f / d.z;
+    Float Sx = pre.Sx, Sy = pre.Sy, Sz = pre.Sz;
     p0t.x += Sx * p0t.z;
     p0t.y += Sy * p0t.z;
     p1t.x += Sx * p1t.z;
@@ -110,8 +107,18 @@ bool Triangle::Intersect( const Ray& ray, Float* tHit, SurfaceInteraction* isect
     Float e1 = p2t.x * p0t.y - p2t.y * p0t.x;
     Float e2 = p0t.x * p1t.y - p0t.y * p1t.x;
 
-    //      fall back to double-precision test at triangle edges -- recompute e0, e1, and e2 with
-    //      doubles if any of them is == 0
+    //      fall back to double-precision test at triangle edges
+    if ( sizeof( Float ) == sizeof( float ) && ( e0 == 0.0f || e1 == 0.0f || e2 == 0.0f ) ) {
+        double p2txp1ty = ( double )p2t.x * ( double )p1t.y;
+        double p2typ1tx = ( double )p2t.y * ( double )p1t.x;
+        e0 = ( float )( p2typ1tx - p2txp1ty );
+        double p0txp2ty = ( double )p0t.x * ( double )p2t.y;
+        double p0typ2tx = ( double )p0t.y * ( double )p2t.x;
+        e1 = ( float )( p0typ2tx - p0txp2ty );
+        double p1txp0ty = ( double )p1t.x * ( double )p0t.y;
+        double p1typ0tx = ( double )p1t.y * ( double )p0t.x;
+        e2 = ( float )( p1typ0tx - p1txp0ty );
+    }
 
     //      perform triangle edge and determinant tests
     if ( ( e0 < 0 || e1 < 0 || e2 < 0 ) && ( e0 > 0 || e1 > 0 || e2 > 0 ) )
@@ -138,11 +145,54 @@ bool Triangle::Intersect( const Ray& ray, Float* tHit, SurfaceInteraction* isect
     Float t = tScaled * invDet;
 
     //      ensure that computed triangle t is conservatively greater than zero
+    //          compute delta_z term for triangle t error bounds
+    Float maxZt = MaxComponent( Abs( Vector3f( p0t.z, p1t.z, p2t.z ) ) );
+    Float deltaZ = gamma( 3 ) * maxZt;
+
+    //          compute delta_x and delta_y terms for triangle t error bounds
+    Float maxXt = MaxComponent( Abs( Vector3f( p0t.x, p1t.x, p2t.x ) ) );
+    Float maxYt = MaxComponent( Abs( Vector3f( p0t.y, p1t.y, p2t.y ) ) );
+    Float deltaX = gamma( 5 ) * ( maxXt + maxZt );
+    Float deltaY = gamma( 5 ) * ( maxYt + maxZt );
+
+    //          compute delta_e term for triangle t error bounds
+    Float deltaE = 2 * ( gamma( 2 ) * maxXt * maxYt + deltaY * maxXt + deltaX * maxYt );
+
+    //          compute delta_t term for triangle t error bounds and check t
+    Float maxE = MaxComponent( Abs( Vector3f( e0, e1, e2 ) ) );
+    Float deltaT =
+      3 * ( gamma( 3 ) * maxE * maxZt + deltaE * maxZt + deltaZ * maxE ) * std::abs( invDet );
+    if ( t <= deltaT )
+        return false;
+
+    // test intersection against alpha texture (if present)
+    if ( testAlphaTexture && alphaMask ) {
+        // if ( alphaMask->Evaluate(isectLocal) == 0 ) return false; // TODO: after Texture is
+        // done
+    }
+
+    hit->t = t;
+    hit->b0 = b0;
+    hit->b1 = b1;
+    hit->b2 = b2;
+    hit->triIndex = triIndex;
+    return true;
+}
+
+void TriangleMesh::ComputeSurfaceInteraction( const Shape& shape, const Ray& ray,
+                                              const TriangleHit& hit,
+                                              SurfaceInteraction* isect ) const
+{
+    const int* v = &vertexIndices[ 3 * hit.triIndex ];
+    const Point3f& p0 = p[ v[ 0 ] ];
+    const Point3f& p1 = p[ v[ 1 ] ];
+    const Point3f& p2 = p[ v[ 2 ] ];
+    Float b0 = hit.b0, b1 = hit.b1, b2 = hit.b2;
 
     // compute triangle partial derivatives
     Vector3f dpdu, dpdv;
     Point2f uv[ 3 ];
-    GetUVs( uv );
+    GetUVs( hit.triIndex, uv );
     // compute deltas for triangle partial derivatives:
     Vector2f duv02 = uv[ 0 ] - uv[ 2 ], duv12 = uv[ 1 ] - uv[ 2 ];
     Vector3f dp02 = p0 - p2, dp12 = p1 - p2;
@@ -154,53 +204,40 @@ bool Triangle::Intersect( const Ray& ray, Float* tHit, SurfaceInteraction* isect
     } else {
         Float invdet = 1 / determinant;
         dpdu = ( duv12[ 1 ] * dp02 - duv02[ 1 ] * dp12 ) * invdet;
-        dpdv = ( -duv12[ 0 ] * dp02 - duv02[ 0 ] * dp12 ) * invdet;
+        dpdv = ( -duv12[ 0 ] * dp02 + duv02[ 0 ] * dp12 ) * invdet;
     }
 
     // compute error bounds for triangle intersection
+    Float xAbsSum = ( std::abs( b0 * p0.x ) + std::abs( b1 * p1.x ) + std::abs( b2 * p2.x ) );
+    Float yAbsSum = ( std::abs( b0 * p0.y ) + std::abs( b1 * p1.y ) + std::abs( b2 * p2.y ) );
+    Float zAbsSum = ( std::abs( b0 * p0.z ) + std::abs( b1 * p1.z ) + std::abs( b2 * p2.z ) );
+    Vector3f pError = gamma( 7 ) * Vector3f( xAbsSum, yAbsSum, zAbsSum );
 
     // interpolate (u, v) parametric coordinates and hit point
     Point3f pHit = b0 * p0 + b1 * p1 + b2 * p2;
     Point2f uvHit = b0 * uv[ 0 ] + b1 * uv[ 1 ] + b2 * uv[ 2 ];
 
-    // test intersection against alpha texture (if present)
-    if ( testAlphaTexture && mesh->alphaMask ) {
-        SurfaceInteraction isectLocal{ pHit,
-                                       Vector3f{ 0, 0, 0 },
-                                       uvHit,
-                                       Vector3f{ 0, 0, 0 },
-                                       dpdu,
-                                       dpdv,
-                                       Normal3f{ 0, 0, 0 },
-                                       Normal3f{ 0, 0, 0 },
-                                       ray.time,
-                                       this };
-        // if ( mesh->alphaMask->Evaluate(isectLocal) == 0 ) return false; // TODO: after Texture is
-        // done
-    }
-
     // fill in SurfaceInteraction from triangle hit
-    Vector3f pError;
     *isect = SurfaceInteraction{
         pHit,     pError, uvHit, -ray.d, dpdu, dpdv, Normal3f{ 0, 0, 0 }, Normal3f{ 0, 0, 0 },
-        ray.time, this
+        ray.time, &shape
     };
     // override surface normal in isect for triangle
     isect->n = isect->shading.n = Normal3f{ Normalize( Cross( dp02, dp12 ) ) };
-    if ( mesh->n || mesh->s ) {
+    if ( n || s ) {
         // initialize Triangle shading geometry
         //      compute sharing normal ns for triangle
         Normal3f ns;
-        if ( mesh->n )
+        if ( n )
             ns =
-              Normalize( b0 * mesh->n[ v[ 0 ] ] + b1 * mesh->n[ v[ 1 ] ] + b2 * mesh->n[ v[ 2 ] ] );
+              Normalize( b0 * n[ v[ 0 ] ] + b1 * n[ v[ 1 ] ] + b2 * n[ v[ 2 ] ] );
         else
             ns = isect->n;
         //      compute shading tangent ss for triangle
         Vector3f ss;
-        if ( mesh->s )
+        if ( s )
             ss =
-              Normalize( b0 * mesh->s[ v[ 0 ] ] + b1 * mesh->s[ v[ 1 ] ] + b2 * mesh->s[ v[ 2 ] ] );
+              Normalize( b0 * s[ v[ 0 ] ] + b1 * s[ v[ 1 ] ] + b2 * s[ v[ 2 ] ] );
         else
             ss = Normalize( isect->dpdu );
         //      compute shading bitangent ts for triangle and adjust ss
@@ -213,12 +250,12 @@ bool Triangle::Intersect( const Ray& ray, Float* tHit, SurfaceInteraction* isect
         }
         //      compute dn/du and dn/dv for triangle shading geometry
         Normal3f dndu, dndv;
-        if ( mesh->n ) {
+        if ( n ) {
             // Compute deltas for triangle partial derivatives of normal
             Vector2f duv02 = uv[ 0 ] - uv[ 2 ];
             Vector2f duv12 = uv[ 1 ] - uv[ 2 ];
-            Normal3f dn1 = mesh->n[ v[ 0 ] ] - mesh->n[ v[ 2 ] ];
-            Normal3f dn2 = mesh->n[ v[ 1 ] ] - mesh->n[ v[ 2 ] ];
+            Normal3f dn1 = n[ v[ 0 ] ] - n[ v[ 2 ] ];
+            Normal3f dn2 = n[ v[ 1 ] ] - n[ v[ 2 ] ];
             Float determinant = duv02[ 0 ] * duv12[ 1 ] - duv02[ 1 ] * duv12[ 0 ];
             bool degenerateUV = std::abs( determinant ) < 1e-8;
             if ( degenerateUV )
@@ -233,43 +270,264 @@ bool Triangle::Intersect( const Ray& ray, Float* tHit, SurfaceInteraction* isect
         isect->SetShadingGeometry( ss, ts, dndu, dndv, true );
     }
     // ensure correct orientation of the geometric normal
-    if ( mesh->n )
+    if ( n )
         isect->n = FaceForward( isect->n, isect->shading.n );
-    else if ( reverseOrientation ^ transformSwapsHandedness )
+    else if ( shape.reverseOrientation ^ shape.transformSwapsHandedness )
         isect->n = isect->shading.n = -isect->n;
+}
+
+void PackTriangleGroups( const TriangleMesh& mesh, const int* triIndices, int nTris,
+                         TriangleGroup* groups )
+{
+    for ( int g = 0; g * SimdWidth < nTris; ++g ) {
+        TriangleGroup& group = groups[ g ];
+        for ( int lane = 0; lane < SimdWidth; ++lane ) {
+            // pad a partial group with copies of its first triangle
+            int i = g * SimdWidth + lane;
+            int tri = triIndices[ i < nTris ? i : g * SimdWidth ];
+            const int* v = &mesh.vertexIndices[ 3 * tri ];
+            for ( int c = 0; c < 3; ++c ) {
+                group.p0[ c ][ lane ] = mesh.p[ v[ 0 ] ][ c ];
+                group.p1[ c ][ lane ] = mesh.p[ v[ 1 ] ][ c ];
+                group.p2[ c ][ lane ] = mesh.p[ v[ 2 ] ][ c ];
+            }
+            group.triIndex[ lane ] = tri;
+        }
+    }
+}
+
+// Runs the watertight test on every lane of group; returns the lanes that hit along with the
+// edge functions, 1 / det and t needed to finish whichever of them is nearest.
+static SimdMask GroupHitMask( const TriangleGroup& group, const Ray& ray,
+                              const RayPrecomputed& pre, SimdFloat* e0, SimdFloat* e1,
+                              SimdFloat* e2, SimdFloat* invDet, SimdFloat* t )
+{
+    // in SoA form permuting the vertices is just a matter of which lane arrays get loaded
+    int kx = pre.kx, ky = pre.ky, kz = pre.kz;
+    Float Sx = pre.Sx, Sy = pre.Sy, Sz = pre.Sz;
+
+    // translate vertices based on ray origin
+    SimdFloat ox{ ray.o[ kx ] }, oy{ ray.o[ ky ] }, oz{ ray.o[ kz ] };
+    SimdFloat p0x = SimdFloat::Load( group.p0[ kx ] ) - ox;
+    SimdFloat p0y = SimdFloat::Load( group.p0[ ky ] ) - oy;
+    SimdFloat p0z = SimdFloat::Load( group.p0[ kz ] ) - oz;
+    SimdFloat p1x = SimdFloat::Load( group.p1[ kx ] ) - ox;
+    SimdFloat p1y = SimdFloat::Load( group.p1[ ky ] ) - oy;
+    SimdFloat p1z = SimdFloat::Load( group.p1[ kz ] ) - oz;
+    SimdFloat p2x = SimdFloat::Load( group.p2[ kx ] ) - ox;
+    SimdFloat p2y = SimdFloat::Load( group.p2[ ky ] ) - oy;
+    SimdFloat p2z = SimdFloat::Load( group.p2[ kz ] ) - oz;
+
+    // apply shear transformation to translated vertex positions
+    p0x += Sx * p0z;
+    p0y += Sy * p0z;
+    p1x += Sx * p1z;
+    p1y += Sy * p1z;
+    p2x += Sx * p2z;
+    p2y += Sy * p2z;
+
+    // compute edge function coefficients e0, e1, e2
+    *e0 = p1x * p2y - p1y * p2x;
+    *e1 = p2x * p0y - p2y * p0x;
+    *e2 = p0x * p1y - p0y * p1x;
+
+    // fall back to double precision for the lanes that land exactly on an edge
+    SimdFloat zero{ 0.f };
+    int onEdge = ( ( *e0 == zero ) | ( *e1 == zero ) | ( *e2 == zero ) ).Bits();
+    if ( sizeof( Float ) == sizeof( float ) && onEdge ) {
+        PBRT_SIMD_ALIGN Float x[ 3 ][ SimdWidth ], y[ 3 ][ SimdWidth ], e[ 3 ][ SimdWidth ];
+        p0x.Store( x[ 0 ] ), p1x.Store( x[ 1 ] ), p2x.Store( x[ 2 ] );
+        p0y.Store( y[ 0 ] ), p1y.Store( y[ 1 ] ), p2y.Store( y[ 2 ] );
+        e0->Store( e[ 0 ] ), e1->Store( e[ 1 ] ), e2->Store( e[ 2 ] );
+        for ( ; onEdge; onEdge &= onEdge - 1 ) {
+            int i = CountTrailingZeros( onEdge );
+            e[ 0 ][ i ] = ( float )( ( double )y[ 2 ][ i ] * ( double )x[ 1 ][ i ] -
+                                     ( double )x[ 2 ][ i ] * ( double )y[ 1 ][ i ] );
+            e[ 1 ][ i ] = ( float )( ( double )y[ 0 ][ i ] * ( double )x[ 2 ][ i ] -
+                                     ( double )x[ 0 ][ i ] * ( double )y[ 2 ][ i ] );
+            e[ 2 ][ i ] = ( float )( ( double )y[ 1 ][ i ] * ( double )x[ 0 ][ i ] -
+                                     ( double )x[ 1 ][ i ] * ( double )y[ 0 ][ i ] );
+        }
+        *e0 = SimdFloat::Load( e[ 0 ] );
+        *e1 = SimdFloat::Load( e[ 1 ] );
+        *e2 = SimdFloat::Load( e[ 2 ] );
+    }
+
+    // perform triangle edge and determinant tests
+    SimdMask anyNeg = ( *e0 < zero ) | ( *e1 < zero ) | ( *e2 < zero );
+    SimdMask anyPos = ( *e0 > zero ) | ( *e1 > zero ) | ( *e2 > zero );
+    SimdFloat det = *e0 + *e1 + *e2;
+    SimdMask hits = ( det != zero ).AndNot( anyNeg & anyPos );
+
+    // compute scaled hit distance to triangle and test against ray t range
+    p0z *= Sz;
+    p1z *= Sz;
+    p2z *= Sz;
+    SimdFloat tScaled = *e0 * p0z + *e1 * p1z + *e2 * p2z;
+    SimdFloat tMaxDet = ray.tMax * det;
+    SimdMask outside = ( det < zero ) & ( ( tScaled >= zero ) | ( tScaled < tMaxDet ) );
+    outside |= ( det > zero ) & ( ( tScaled <= zero ) | ( tScaled > tMaxDet ) );
+    hits = hits.AndNot( outside );
+    if ( hits.None() )
+        return hits;
+
+    // compute t value for triangle intersection
+    *invDet = 1.f / det;
+    *t = tScaled * *invDet;
 
-    *tHit = t;
+    // ensure that computed triangle t is conservatively greater than zero
+    SimdFloat maxZt = Max( Abs( p0z ), Max( Abs( p1z ), Abs( p2z ) ) );
+    SimdFloat deltaZ = gamma( 3 ) * maxZt;
+    SimdFloat maxXt = Max( Abs( p0x ), Max( Abs( p1x ), Abs( p2x ) ) );
+    SimdFloat maxYt = Max( Abs( p0y ), Max( Abs( p1y ), Abs( p2y ) ) );
+    SimdFloat deltaX = gamma( 5 ) * ( maxXt + maxZt );
+    SimdFloat deltaY = gamma( 5 ) * ( maxYt + maxZt );
+    SimdFloat deltaE = 2.f * ( gamma( 2 ) * maxXt * maxYt + deltaY * maxXt + deltaX * maxYt );
+    SimdFloat maxE = Max( Abs( *e0 ), Max( Abs( *e1 ), Abs( *e2 ) ) );
+    SimdFloat deltaT =
+      3.f * ( gamma( 3 ) * maxE * maxZt + deltaE * maxZt + deltaZ * maxE ) * Abs( *invDet );
+    return hits.AndNot( *t <= deltaT );
+}
+
+bool IntersectTriangleGroup( const TriangleGroup& group, const Ray& ray, const RayPrecomputed& pre,
+                             TriangleHit* hit )
+{
+    SimdFloat e0, e1, e2, invDet, t;
+    SimdMask hits = GroupHitMask( group, ray, pre, &e0, &e1, &e2, &invDet, &t );
+    if ( hits.None() )
+        return false;
+
+    // compute barycentric coordinates for the nearest lane only
+    int lane = MinLane( t, hits );
+    Float laneInvDet = invDet[ lane ];
+    hit->t = t[ lane ];
+    hit->b0 = e0[ lane ] * laneInvDet;
+    hit->b1 = e1[ lane ] * laneInvDet;
+    hit->b2 = e2[ lane ] * laneInvDet;
+    hit->triIndex = group.triIndex[ lane ];
     return true;
 }
 
-bool Triangle::IntersectP( const Ray& ray, bool testAlphaTexture ) const { return true; }
+bool IntersectTriangleGroupP( const TriangleGroup& group, const Ray& ray,
+                              const RayPrecomputed& pre )
+{
+    SimdFloat e0, e1, e2, invDet, t;
+    return GroupHitMask( group, ray, pre, &e0, &e1, &e2, &invDet, &t ).Any();
+}
 
-std::vector< std::shared_ptr< Shape > > Triangle::CreateTriangleMesh(
-  const Transform* ObjectToWorld, const Transform* WorldToObject, bool reverseOrientation,
-  int nTriangles, const int& vertexIndices, int nVertices, const Point3f* p, const Vector3f* s,
-  const Normal3f* n, const Point2f* uv, const std::shared_ptr< Texture< Float > >& alphaMask )
+TriangleMeshShape::TriangleMeshShape( const Transform* ObjectToWorld,
+                                      const Transform* WorldToObject, bool reverseOrientation,
+                                      const std::shared_ptr< TriangleMesh >& mesh )
+: Shape{ ObjectToWorld, WorldToObject, reverseOrientation },
+  mesh{ mesh }
 {
-    auto mesh = std::make_shared< TriangleMesh >( *ObjectToWorld, nTriangles, vertexIndices,
-                                                  nVertices, p, s, n, uv, alphaMask );
-    std::vector< std::shared_ptr< Shape > > tris;
-    for ( auto i = 0; i < nTriangles; ++i ) {
-        tris.emplace_back( std::make_shared< Triangle >( ObjectToWorld, WorldToObject,
-                                                         reverseOrientation, mesh, i ) );
-    }
-    return tris;
 }
 
-void Triangle::GetUVs( Point2f uv[ 3 ] ) const
+Bounds3f TriangleMeshShape::ObjectBound() const
 {
-    if ( mesh->uv ) {
-        uv[ 0 ] = mesh->uv[ v[ 0 ] ];
-        uv[ 1 ] = mesh->uv[ v[ 1 ] ];
-        uv[ 2 ] = mesh->uv[ v[ 2 ] ];
-    } else {
-        uv[ 0 ] = Point2f{ 0, 0 };
-        uv[ 1 ] = Point2f{ 1, 0 };
-        uv[ 2 ] = Point2f{ 1, 1 };
+    Bounds3f bounds;
+    for ( int i = 0; i < 3 * mesh->nTriangles; ++i )
+        bounds = Union( bounds, ( *WorldToObject )( mesh->p[ mesh->vertexIndices[ i ] ] ) );
+    return bounds;
+}
+
+Bounds3f TriangleMeshShape::WorldBound() const
+{
+    Bounds3f bounds;
+    for ( int i = 0; i < mesh->nTriangles; ++i )
+        bounds = Union( bounds, mesh->TriangleBound( i ) );
+    return bounds;
+}
+
+Float TriangleMeshShape::Area() const
+{
+    Float area = 0;
+    for ( int i = 0; i < mesh->nTriangles; ++i )
+        area += mesh->TriangleArea( i );
+    return area;
+}
+
+bool TriangleMeshShape::Intersect( const Ray& ray, Float* tHit, SurfaceInteraction* isect,
+                                   bool testAlphaTexture ) const
+{
+    // without an accelerator every triangle has to be tested; shrink the ray as hits are found
+    Ray r = ray;
+    RayPrecomputed pre( ray );
+    TriangleHit hit, closest;
+    bool hitAny = false;
+    for ( int i = 0; i < mesh->nTriangles; ++i ) {
+        if ( mesh->IntersectTriangle( i, r, pre, &hit, testAlphaTexture ) ) {
+            closest = hit;
+            r.tMax = hit.t;
+            hitAny = true;
+        }
     }
+    if ( !hitAny )
+        return false;
+    mesh->ComputeSurfaceInteraction( *this, ray, closest, isect );
+    *tHit = closest.t;
+    return true;
+}
+
+bool TriangleMeshShape::IntersectP( const Ray& ray, bool testAlphaTexture ) const
+{
+    RayPrecomputed pre( ray );
+    TriangleHit hit;
+    for ( int i = 0; i < mesh->nTriangles; ++i )
+        if ( mesh->IntersectTriangle( i, ray, pre, &hit, testAlphaTexture ) )
+            return true;
+    return false;
+}
+
+Triangle::Triangle( const Transform* ObjectToWorld, const Transform* WorldToObject,
+                    bool reverseOrientation, const std::shared_ptr< TriangleMesh >& mesh,
+                    int triNumber )
+: Shape{ ObjectToWorld, WorldToObject, reverseOrientation },
+  mesh{ mesh },
+  triIndex{ triNumber }
+{
+}
+
+Bounds3f Triangle::ObjectBound() const
+{
+    const int* v = &mesh->vertexIndices[ 3 * triIndex ];
+    const Point3f& p0 = mesh->p[ v[ 0 ] ];
+    const Point3f& p1 = mesh->p[ v[ 1 ] ];
+    const Point3f& p2 = mesh->p[ v[ 2 ] ];
+    return Union( Bounds3f( ( *WorldToObject )( p0 ), ( *WorldToObject )( p1 ) ),
+                  ( *WorldToObject )( p2 ) );
+}
+
+Bounds3f Triangle::WorldBound() const { return mesh->TriangleBound( triIndex ); }
+
+bool Triangle::Intersect( const Ray& ray, Float* tHit, SurfaceInteraction* isect,
+                          bool testAlphaTexture ) const
+{
+    TriangleHit hit;
+    if ( !mesh->IntersectTriangle( triIndex, ray, &hit, testAlphaTexture ) )
+        return false;
+    mesh->ComputeSurfaceInteraction( *this, ray, hit, isect );
+    *tHit = hit.t;
+    return true;
+}
+
+bool Triangle::IntersectP( const Ray& ray, bool testAlphaTexture ) const
+{
+    // the hit record is all an occlusion test needs; no shading data is ever built
+    TriangleHit hit;
+    return mesh->IntersectTriangle( triIndex, ray, &hit, testAlphaTexture );
+}
+
+std::vector< std::shared_ptr< Shape > >
+CreateTriangleMesh( const Transform* ObjectToWorld, const Transform* WorldToObject,
+                    bool reverseOrientation, int nTriangles, const int* vertexIndices,
+                    int nVertices, const Point3f* p, const Vector3f* s, const Normal3f* n,
+                    const Point2f* uv, const std::shared_ptr< Texture< Float > >& alphaMask )
+{
+    auto mesh = std::make_shared< TriangleMesh >( *ObjectToWorld, nTriangles, vertexIndices,
+                                                  nVertices, p, s, n, uv, alphaMask );
+    return { std::make_shared< TriangleMeshShape >( ObjectToWorld, WorldToObject,
+                                                    reverseOrientation, mesh ) };
 }
 
 } /* namespace pbrt */
@@ -11,10 +11,29 @@
 
 #include "pbrt.hpp"
 #include "shape.hpp"
+#include "simd.hpp"
 #include "transform.hpp"
 
 namespace pbrt {
 
+// SimdWidth triangles pre-gathered in structure-of-arrays form: each vertex component has its own
+// aligned lane array, so one watertight test covers the whole group. Lanes past the end of a
+// partial group repeat its first triangle, which keeps the kernel free of lane masks.
+struct PBRT_SIMD_ALIGN TriangleGroup
+{
+    Float p0[ 3 ][ SimdWidth ], p1[ 3 ][ SimdWidth ], p2[ 3 ][ SimdWidth ];
+    int triIndex[ SimdWidth ];
+};
+
+// Compact record of a ray-triangle hit found during traversal; the full SurfaceInteraction is
+// only built from it once the closest hit is known.
+struct TriangleHit
+{
+    Float t;
+    Float b0, b1, b2;
+    int triIndex;
+};
+
 struct TriangleMesh
 {
     const int nTriangles, nVertices;
@@ -28,39 +47,73 @@ struct TriangleMesh
     TriangleMesh( const Transform& ObjectToWorld, int nTriangles, const int* vertexIndices,
                   int nVertices, const Point3f* P, const Vector3f* S, const Normal3f* N,
                   const Point2f* UV, const std::shared_ptr< Texture< Float > >& alphaMask );
+
+    // per-triangle routines; triangles are addressed by index, not by a Shape of their own
+    Bounds3f TriangleBound( int triIndex ) const;
+    Float TriangleArea( int triIndex ) const;
+    void GetUVs( int triIndex, Point2f triUV[ 3 ] ) const;
+    bool IntersectTriangle( int triIndex, const Ray& ray, TriangleHit* hit,
+                            bool testAlphaTexture = true ) const;
+    bool IntersectTriangle( int triIndex, const Ray& ray, const RayPrecomputed& pre,
+                            TriangleHit* hit, bool testAlphaTexture = true ) const;
+    void ComputeSurfaceInteraction( const Shape& shape, const Ray& ray, const TriangleHit& hit,
+                                    SurfaceInteraction* isect ) const;
 };
 
+// Packs the nTris triangles of mesh listed in triIndices into (nTris + SimdWidth - 1) / SimdWidth
+// consecutive groups; accelerators use this to lay out their leaves.
+void PackTriangleGroups( const TriangleMesh& mesh, const int* triIndices, int nTris,
+                         TriangleGroup* groups );
+
+// Same watertight test as TriangleMesh::IntersectTriangle(), run on a whole group; reports the
+// nearest hit. Alpha masks are not consulted, so meshes that have one should stay on the scalar
+// path.
+bool IntersectTriangleGroup( const TriangleGroup& group, const Ray& ray, const RayPrecomputed& pre,
+                             TriangleHit* hit );
+bool IntersectTriangleGroupP( const TriangleGroup& group, const Ray& ray,
+                              const RayPrecomputed& pre );
+
+// The whole mesh as a single Shape. Accelerators expand it into (mesh, index) references at build
+// time, so no per-triangle objects are ever allocated.
+class TriangleMeshShape : public Shape {
+  public:
+    TriangleMeshShape( const Transform* ObjectToWorld, const Transform* WorldToObject,
+                       bool reverseOrientation, const std::shared_ptr< TriangleMesh >& mesh );
+
+    Bounds3f ObjectBound() const override;
+    Bounds3f WorldBound() const override;
+    bool Intersect( const Ray& ray, Float* tHit, SurfaceInteraction* isect,
+                    bool testAlphaTexture ) const override;
+    bool IntersectP( const Ray& ray, bool testAlphaTexture = true ) const override;
+    Float Area() const;
+
+    const std::shared_ptr< TriangleMesh > mesh;
+};
+
+// A single triangle of a mesh, for callers that need one as a standalone Shape.
 class Triangle : public Shape {
   public:
     Triangle( const Transform* ObjectToWorld, const Transform* WorldToObject,
               bool reverseOrientation, const std::shared_ptr< TriangleMesh >& mesh, int triNumber );
 
     Bounds3f ObjectBound() const override;
-    Bounds3f WorldBound() const;
+    Bounds3f WorldBound() const override;
     bool Intersect( const Ray& ray, Float* tHit, SurfaceInteraction* isect,
                     bool testAlphaTexture ) const override;
     bool IntersectP( const Ray& ray, bool testAlphaTexture = true ) const override;
 
-    std::vector< std::shared_ptr< Shape > >
-    CreateTriangleMesh( const Transform* ObjectToWorld, const Transform* WorldToObject,
-                        bool reverseOrientation, int nTriangles, const int& vertexIndices,
-                        int nVertices, const Point3f* p, const Vector3f* s, const Normal3f* n,
-                        const Point2f* uv, const std::shared_ptr< Texture< Float > >& alphaMask );
-
-    void GetUVs( Point2f uv[ 3 ] ) const;
-
-    Float Area() const
-    {
-        const Point3f& p0 = mesh->p[ v[ 0 ] ];
-        const Point3f& p1 = mesh->p[ v[ 1 ] ];
-        const Point3f& p2 = mesh->p[ v[ 2 ] ];
-        return 0.5f * Cross( p1 - p0, p2 - p0 ).Length();
-    }
+    Float Area() const { return mesh->TriangleArea( triIndex ); }
 
   private:
     std::shared_ptr< TriangleMesh > mesh;
-    const int* v; // vertex index
+    const int triIndex;
 };
 
+std::vector< std::shared_ptr< Shape > >
+CreateTriangleMesh( const Transform* ObjectToWorld, const Transform* WorldToObject,
+                    bool reverseOrientation, int nTriangles, const int* vertexIndices,
+                    int nVertices, const Point3f* p, const Vector3f* s, const Normal3f* n,
+                    const Point2f* uv, const std::shared_ptr< Texture< Float > >& alphaMask );
+
 } /* namespace pbrt */
 #endif /* trianglemesh_hpp */
@@ -0,0 +1,652 @@
+//
+//  simd.hpp
+//  pbrt3
+//
+//  Created by Ilya Rostovtsev on 10/17/26.
+//  Copyright © 2017 Ilya Rostovtsev. All rights reserved.
+//
+
+#ifndef simd_hpp
+#define simd_hpp
+
+#include "geometry.hpp"
+#include "pbrt.hpp"
+
+#if !defined( PBRT_FLOAT_AS_DOUBLE ) && defined( PBRT_HAVE_AVX )
+#define PBRT_SIMD_AVX
+#include <immintrin.h>
+#elif !defined( PBRT_FLOAT_AS_DOUBLE ) && defined( PBRT_HAVE_SSE2 )
+#define PBRT_SIMD_SSE
+#include <emmintrin.h>
+#endif
+
+namespace pbrt {
+
+// Thin wrappers over the widest float vectors the target supports: 8 lanes with AVX, 4 lanes
+// with SSE2, and a 4-lane scalar emulation otherwise (or when Float is double). Kernels are
+// written once against SimdFloat / SimdMask and pick up whichever width was compiled in.
+#if defined( PBRT_SIMD_AVX )
+static PBRT_CONSTEXPR int SimdWidth = 8;
+#else
+static PBRT_CONSTEXPR int SimdWidth = 4;
+#endif
+
+// Loads and stores through SimdFloat::Load() / Store() require this alignment.
+#define PBRT_SIMD_ALIGN alignas( 32 )
+
+struct SimdMask
+{
+#if defined( PBRT_SIMD_AVX )
+    __m256 m;
+    SimdMask() {}
+    explicit SimdMask( __m256 m ) : m{ m } {}
+    explicit SimdMask( bool b ) : m{ _mm256_castsi256_ps( _mm256_set1_epi32( b ? -1 : 0 ) ) } {}
+    int Bits() const { return _mm256_movemask_ps( m ); }
+    SimdMask operator&( const SimdMask& b ) const { return SimdMask( _mm256_and_ps( m, b.m ) ); }
+    SimdMask operator|( const SimdMask& b ) const { return SimdMask( _mm256_or_ps( m, b.m ) ); }
+    SimdMask operator^( const SimdMask& b ) const { return SimdMask( _mm256_xor_ps( m, b.m ) ); }
+    // lanes set in *this but not in b
+    SimdMask AndNot( const SimdMask& b ) const { return SimdMask( _mm256_andnot_ps( b.m, m ) ); }
+#elif defined( PBRT_SIMD_SSE )
+    __m128 m;
+    SimdMask() {}
+    explicit SimdMask( __m128 m ) : m{ m } {}
+    explicit SimdMask( bool b ) : m{ _mm_castsi128_ps( _mm_set1_epi32( b ? -1 : 0 ) ) } {}
+    int Bits() const { return _mm_movemask_ps( m ); }
+    SimdMask operator&( const SimdMask& b ) const { return SimdMask( _mm_and_ps( m, b.m ) ); }
+    SimdMask operator|( const SimdMask& b ) const { return SimdMask( _mm_or_ps( m, b.m ) ); }
+    SimdMask operator^( const SimdMask& b ) const { return SimdMask( _mm_xor_ps( m, b.m ) ); }
+    SimdMask AndNot( const SimdMask& b ) const { return SimdMask( _mm_andnot_ps( b.m, m ) ); }
+#else
+    bool m[ SimdWidth ];
+    SimdMask() {}
+    explicit SimdMask( bool b )
+    {
+        for ( int i = 0; i < SimdWidth; ++i )
+            m[ i ] = b;
+    }
+    int Bits() const
+    {
+        int bits = 0;
+        for ( int i = 0; i < SimdWidth; ++i )
+            bits |= m[ i ] ? ( 1 << i ) : 0;
+        return bits;
+    }
+    SimdMask operator&( const SimdMask& b ) const
+    {
+        SimdMask r;
+        for ( int i = 0; i < SimdWidth; ++i )
+            r.m[ i ] = m[ i ] && b.m[ i ];
+        return r;
+    }
+    SimdMask operator|( const SimdMask& b ) const
+    {
+        SimdMask r;
+        for ( int i = 0; i < SimdWidth; ++i )
+            r.m[ i ] = m[ i ] || b.m[ i ];
+        return r;
+    }
+    SimdMask operator^( const SimdMask& b ) const
+    {
+        SimdMask r;
+        for ( int i = 0; i < SimdWidth; ++i )
+            r.m[ i ] = m[ i ] != b.m[ i ];
+        return r;
+    }
+    SimdMask AndNot( const SimdMask& b ) const
+    {
+        SimdMask r;
+        for ( int i = 0; i < SimdWidth; ++i )
+            r.m[ i ] = m[ i ] && !b.m[ i ];
+        return r;
+    }
+#endif
+    SimdMask& operator&=( const SimdMask& b ) { return *this = *this & b; }
+    SimdMask& operator|=( const SimdMask& b ) { return *this = *this | b; }
+    bool Any() const { return Bits() != 0; }
+    bool None() const { return Bits() == 0; }
+    bool All() const { return Bits() == ( 1 << SimdWidth ) - 1; }
+    bool operator[]( int i ) const { return ( Bits() >> i ) & 1; }
+};
+
+struct SimdFloat
+{
+#if defined( PBRT_SIMD_AVX )
+    __m256 v;
+    SimdFloat() {}
+    explicit SimdFloat( __m256 v ) : v{ v } {}
+    SimdFloat( Float f ) : v{ _mm256_set1_ps( f ) } {}
+    static SimdFloat Load( const Float* p ) { return SimdFloat( _mm256_load_ps( p ) ); }
+    static SimdFloat LoadU( const Float* p ) { return SimdFloat( _mm256_loadu_ps( p ) ); }
+    // SimdWidth unsigned bytes, converted to float
+    static SimdFloat LoadBytes( const uint8_t* p )
+    {
+        __m128i zero = _mm_setzero_si128();
+        __m128i w = _mm_unpacklo_epi8( _mm_loadl_epi64( ( const __m128i* )p ), zero );
+        __m128 lo = _mm_cvtepi32_ps( _mm_unpacklo_epi16( w, zero ) );
+        __m128 hi = _mm_cvtepi32_ps( _mm_unpackhi_epi16( w, zero ) );
+        return SimdFloat( _mm256_insertf128_ps( _mm256_castps128_ps256( lo ), hi, 1 ) );
+    }
+    void Store( Float* p ) const { _mm256_store_ps( p, v ); }
+    void StoreU( Float* p ) const { _mm256_storeu_ps( p, v ); }
+
+    SimdFloat operator+( const SimdFloat& b ) const { return SimdFloat( _mm256_add_ps( v, b.v ) ); }
+    SimdFloat operator-( const SimdFloat& b ) const { return SimdFloat( _mm256_sub_ps( v, b.v ) ); }
+    SimdFloat operator*( const SimdFloat& b ) const { return SimdFloat( _mm256_mul_ps( v, b.v ) ); }
+    SimdFloat operator/( const SimdFloat& b ) const { return SimdFloat( _mm256_div_ps( v, b.v ) ); }
+    SimdFloat operator-() const { return SimdFloat( _mm256_sub_ps( _mm256_setzero_ps(), v ) ); }
+
+    SimdMask operator<( const SimdFloat& b ) const
+    {
+        return SimdMask( _mm256_cmp_ps( v, b.v, _CMP_LT_OQ ) );
+    }
+    SimdMask operator<=( const SimdFloat& b ) const
+    {
+        return SimdMask( _mm256_cmp_ps( v, b.v, _CMP_LE_OQ ) );
+    }
+    SimdMask operator>( const SimdFloat& b ) const
+    {
+        return SimdMask( _mm256_cmp_ps( v, b.v, _CMP_GT_OQ ) );
+    }
+    SimdMask operator>=( const SimdFloat& b ) const
+    {
+        return SimdMask( _mm256_cmp_ps( v, b.v, _CMP_GE_OQ ) );
+    }
+    SimdMask operator==( const SimdFloat& b ) const
+    {
+        return SimdMask( _mm256_cmp_ps( v, b.v, _CMP_EQ_OQ ) );
+    }
+    SimdMask operator!=( const SimdFloat& b ) const
+    {
+        return SimdMask( _mm256_cmp_ps( v, b.v, _CMP_NEQ_UQ ) );
+    }
+#elif defined( PBRT_SIMD_SSE )
+    __m128 v;
+    SimdFloat() {}
+    explicit SimdFloat( __m128 v ) : v{ v } {}
+    SimdFloat( Float f ) : v{ _mm_set1_ps( f ) } {}
+    static SimdFloat Load( const Float* p ) { return SimdFloat( _mm_load_ps( p ) ); }
+    static SimdFloat LoadU( const Float* p ) { return SimdFloat( _mm_loadu_ps( p ) ); }
+    static SimdFloat LoadBytes( const uint8_t* p )
+    {
+        int bytes;
+        memcpy( &bytes, p, sizeof( bytes ) );
+        __m128i zero = _mm_setzero_si128();
+        __m128i w = _mm_unpacklo_epi8( _mm_cvtsi32_si128( bytes ), zero );
+        return SimdFloat( _mm_cvtepi32_ps( _mm_unpacklo_epi16( w, zero ) ) );
+    }
+    void Store( Float* p ) const { _mm_store_ps( p, v ); }
+    void StoreU( Float* p ) const { _mm_storeu_ps( p, v ); }
+
+    SimdFloat operator+( const SimdFloat& b ) const { return SimdFloat( _mm_add_ps( v, b.v ) ); }
+    SimdFloat operator-( const SimdFloat& b ) const { return SimdFloat( _mm_sub_ps( v, b.v ) ); }
+    SimdFloat operator*( const SimdFloat& b ) const { return SimdFloat( _mm_mul_ps( v, b.v ) ); }
+    SimdFloat operator/( const SimdFloat& b ) const { return SimdFloat( _mm_div_ps( v, b.v ) ); }
+    SimdFloat operator-() const { return SimdFloat( _mm_sub_ps( _mm_setzero_ps(), v ) ); }
+
+    SimdMask operator<( const SimdFloat& b ) const { return SimdMask( _mm_cmplt_ps( v, b.v ) ); }
+    SimdMask operator<=( const SimdFloat& b ) const { return SimdMask( _mm_cmple_ps( v, b.v ) ); }
+    SimdMask operator>( const SimdFloat& b ) const { return SimdMask( _mm_cmpgt_ps( v, b.v ) ); }
+    SimdMask operator>=( const SimdFloat& b ) const { return SimdMask( _mm_cmpge_ps( v, b.v ) ); }
+    SimdMask operator==( const SimdFloat& b ) const { return SimdMask( _mm_cmpeq_ps( v, b.v ) ); }
+    SimdMask operator!=( const SimdFloat& b ) const { return SimdMask( _mm_cmpneq_ps( v, b.v ) ); }
+#else
+    Float v[ SimdWidth ];
+    SimdFloat() {}
+    SimdFloat( Float f )
+    {
+        for ( int i = 0; i < SimdWidth; ++i )
+            v[ i ] = f;
+    }
+    static SimdFloat Load( const Float* p ) { return LoadU( p ); }
+    static SimdFloat LoadU( const Float* p )
+    {
+        SimdFloat r;
+        for ( int i = 0; i < SimdWidth; ++i )
+            r.v[ i ] = p[ i ];
+        return r;
+    }
+    static SimdFloat LoadBytes( const uint8_t* p )
+    {
+        SimdFloat r;
+        for ( int i = 0; i < SimdWidth; ++i )
+            r.v[ i ] = p[ i ];
+        return r;
+    }
+    void Store( Float* p ) const { StoreU( p ); }
+    void StoreU( Float* p ) const
+    {
+        for ( int i = 0; i < SimdWidth; ++i )
+            p[ i ] = v[ i ];
+    }
+
+#define PBRT_SIMD_BINARY( OP )                                                                     \
+    SimdFloat operator OP( const SimdFloat& b ) const                                              \
+    {                                                                                              \
+        SimdFloat r;                                                                               \
+        for ( int i = 0; i < SimdWidth; ++i )                                                      \
+            r.v[ i ] = v[ i ] OP b.v[ i ];                                                         \
+        return r;                                                                                  \
+    }
+#define PBRT_SIMD_COMPARE( OP )                                                                    \
+    SimdMask operator OP( const SimdFloat& b ) const                                               \
+    {                                                                                              \
+        SimdMask r;                                                                                \
+        for ( int i = 0; i < SimdWidth; ++i )                                                      \
+            r.m[ i ] = v[ i ] OP b.v[ i ];                                                         \
+        return r;                                                                                  \
+    }
+    PBRT_SIMD_BINARY( +)
+    PBRT_SIMD_BINARY( -)
+    PBRT_SIMD_BINARY( * )
+    PBRT_SIMD_BINARY( / )
+    PBRT_SIMD_COMPARE( < )
+    PBRT_SIMD_COMPARE( <= )
+    PBRT_SIMD_COMPARE( > )
+    PBRT_SIMD_COMPARE( >= )
+    PBRT_SIMD_COMPARE( == )
+    PBRT_SIMD_COMPARE( != )
+#undef PBRT_SIMD_BINARY
+#undef PBRT_SIMD_COMPARE
+    SimdFloat operator-() const { return SimdFloat( 0 ) - *this; }
+#endif
+
+    SimdFloat& operator+=( const SimdFloat& b ) { return *this = *this + b; }
+    SimdFloat& operator-=( const SimdFloat& b ) { return *this = *this - b; }
+    SimdFloat& operator*=( const SimdFloat& b ) { return *this = *this * b; }
+
+    Float operator[]( int i ) const
+    {
+        PBRT_SIMD_ALIGN Float lanes[ SimdWidth ];
+        Store( lanes );
+        return lanes[ i ];
+    }
+};
+
+inline SimdFloat operator+( Float a, const SimdFloat& b ) { return SimdFloat( a ) + b; }
+inline SimdFloat operator-( Float a, const SimdFloat& b ) { return SimdFloat( a ) - b; }
+inline SimdFloat operator*( Float a, const SimdFloat& b ) { return SimdFloat( a ) * b; }
+inline SimdFloat operator/( Float a, const SimdFloat& b ) { return SimdFloat( a ) / b; }
+
+#if defined( PBRT_SIMD_AVX )
+inline SimdFloat Min( const SimdFloat& a, const SimdFloat& b )
+{
+    return SimdFloat( _mm256_min_ps( a.v, b.v ) );
+}
+inline SimdFloat Max( const SimdFloat& a, const SimdFloat& b )
+{
+    return SimdFloat( _mm256_max_ps( a.v, b.v ) );
+}
+inline SimdFloat Abs( const SimdFloat& a )
+{
+    return SimdFloat( _mm256_andnot_ps( _mm256_set1_ps( -0.f ), a.v ) );
+}
+inline SimdFloat Sqrt( const SimdFloat& a ) { return SimdFloat( _mm256_sqrt_ps( a.v ) ); }
+// per lane: mask ? a : b
+inline SimdFloat Select( const SimdMask& mask, const SimdFloat& a, const SimdFloat& b )
+{
+    return SimdFloat( _mm256_blendv_ps( b.v, a.v, mask.m ) );
+}
+#elif defined( PBRT_SIMD_SSE )
+inline SimdFloat Min( const SimdFloat& a, const SimdFloat& b )
+{
+    return SimdFloat( _mm_min_ps( a.v, b.v ) );
+}
+inline SimdFloat Max( const SimdFloat& a, const SimdFloat& b )
+{
+    return SimdFloat( _mm_max_ps( a.v, b.v ) );
+}
+inline SimdFloat Abs( const SimdFloat& a )
+{
+    return SimdFloat( _mm_andnot_ps( _mm_set1_ps( -0.f ), a.v ) );
+}
+inline SimdFloat Sqrt( const SimdFloat& a ) { return SimdFloat( _mm_sqrt_ps( a.v ) ); }
+inline SimdFloat Select( const SimdMask& mask, const SimdFloat& a, const SimdFloat& b )
+{
+    return SimdFloat( _mm_or_ps( _mm_and_ps( mask.m, a.v ), _mm_andnot_ps( mask.m, b.v ) ) );
+}
+#else
+// the scalar Min/Max follow the SSE convention of returning b when either operand is NaN
+inline SimdFloat Min( const SimdFloat& a, const SimdFloat& b )
+{
+    SimdFloat r;
+    for ( int i = 0; i < SimdWidth; ++i )
+        r.v[ i ] = a.v[ i ] < b.v[ i ] ? a.v[ i ] : b.v[ i ];
+    return r;
+}
+inline SimdFloat Max( const SimdFloat& a, const SimdFloat& b )
+{
+    SimdFloat r;
+    for ( int i = 0; i < SimdWidth; ++i )
+        r.v[ i ] = a.v[ i ] > b.v[ i ] ? a.v[ i ] : b.v[ i ];
+    return r;
+}
+inline SimdFloat Abs( const SimdFloat& a )
+{
+    SimdFloat r;
+    for ( int i = 0; i < SimdWidth; ++i )
+        r.v[ i ] = std::abs( a.v[ i ] );
+    return r;
+}
+inline SimdFloat Sqrt( const SimdFloat& a )
+{
+    SimdFloat r;
+    for ( int i = 0; i < SimdWidth; ++i )
+        r.v[ i ] = std::sqrt( a.v[ i ] );
+    return r;
+}
+inline SimdFloat Select( const SimdMask& mask, const SimdFloat& a, const SimdFloat& b )
+{
+    SimdFloat r;
+    for ( int i = 0; i < SimdWidth; ++i )
+        r.v[ i ] = mask.m[ i ] ? a.v[ i ] : b.v[ i ];
+    return r;
+}
+#endif
+
+// SimdWidth consecutive ( x, y, z ) triples (Point3f, Vector3f, Normal3f), unaligned, to and from
+// one SimdFloat per coordinate. With SSE, four triples are three loads and five shuffles; AVX
+// does the same in each 128-bit half, which then holds four consecutive triples.
+#if defined( PBRT_SIMD_AVX )
+inline void SimdLoad3( const Float* p, SimdFloat* x, SimdFloat* y, SimdFloat* z )
+{
+    __m256 a = _mm256_insertf128_ps( _mm256_castps128_ps256( _mm_loadu_ps( p ) ),
+                                     _mm_loadu_ps( p + 12 ), 1 );
+    __m256 b = _mm256_insertf128_ps( _mm256_castps128_ps256( _mm_loadu_ps( p + 4 ) ),
+                                     _mm_loadu_ps( p + 16 ), 1 );
+    __m256 c = _mm256_insertf128_ps( _mm256_castps128_ps256( _mm_loadu_ps( p + 8 ) ),
+                                     _mm_loadu_ps( p + 20 ), 1 );
+    // a = x0 y0 z0 x1, b = y1 z1 x2 y2, c = z2 x3 y3 z3
+    __m256 xy = _mm256_shuffle_ps( b, c, _MM_SHUFFLE( 2, 1, 3, 2 ) ); // x2 y2 x3 y3
+    __m256 yz = _mm256_shuffle_ps( a, b, _MM_SHUFFLE( 1, 0, 2, 1 ) ); // y0 z0 y1 z1
+    x->v = _mm256_shuffle_ps( a, xy, _MM_SHUFFLE( 2, 0, 3, 0 ) );
+    y->v = _mm256_shuffle_ps( yz, xy, _MM_SHUFFLE( 3, 1, 2, 0 ) );
+    z->v = _mm256_shuffle_ps( yz, c, _MM_SHUFFLE( 3, 0, 3, 1 ) );
+}
+inline void SimdStore3( Float* p, const SimdFloat& x, const SimdFloat& y, const SimdFloat& z )
+{
+    __m256 xyLo = _mm256_unpacklo_ps( x.v, y.v );                           // x0 y0 x1 y1
+    __m256 xyHi = _mm256_unpackhi_ps( x.v, y.v );                           // x2 y2 x3 y3
+    __m256 u = _mm256_shuffle_ps( z.v, xyLo, _MM_SHUFFLE( 3, 2, 1, 0 ) );   // z0 z1 x1 y1
+    __m256 w = _mm256_shuffle_ps( z.v, xyHi, _MM_SHUFFLE( 3, 2, 3, 2 ) );   // z2 z3 x3 y3
+    __m256 a = _mm256_shuffle_ps( xyLo, u, _MM_SHUFFLE( 2, 0, 1, 0 ) );
+    __m256 b = _mm256_shuffle_ps( u, xyHi, _MM_SHUFFLE( 1, 0, 1, 3 ) );
+    __m256 c = _mm256_shuffle_ps( w, w, _MM_SHUFFLE( 1, 3, 2, 0 ) );
+    _mm_storeu_ps( p, _mm256_castps256_ps128( a ) );
+    _mm_storeu_ps( p + 4, _mm256_castps256_ps128( b ) );
+    _mm_storeu_ps( p + 8, _mm256_castps256_ps128( c ) );
+    _mm_storeu_ps( p + 12, _mm256_extractf128_ps( a, 1 ) );
+    _mm_storeu_ps( p + 16, _mm256_extractf128_ps( b, 1 ) );
+    _mm_storeu_ps( p + 20, _mm256_extractf128_ps( c, 1 ) );
+}
+#elif defined( PBRT_SIMD_SSE )
+inline void SimdLoad3( const Float* p, SimdFloat* x, SimdFloat* y, SimdFloat* z )
+{
+    __m128 a = _mm_loadu_ps( p ), b = _mm_loadu_ps( p + 4 ), c = _mm_loadu_ps( p + 8 );
+    __m128 xy = _mm_shuffle_ps( b, c, _MM_SHUFFLE( 2, 1, 3, 2 ) );
+    __m128 yz = _mm_shuffle_ps( a, b, _MM_SHUFFLE( 1, 0, 2, 1 ) );
+    x->v = _mm_shuffle_ps( a, xy, _MM_SHUFFLE( 2, 0, 3, 0 ) );
+    y->v = _mm_shuffle_ps( yz, xy, _MM_SHUFFLE( 3, 1, 2, 0 ) );
+    z->v = _mm_shuffle_ps( yz, c, _MM_SHUFFLE( 3, 0, 3, 1 ) );
+}
+inline void SimdStore3( Float* p, const SimdFloat& x, const SimdFloat& y, const SimdFloat& z )
+{
+    __m128 xyLo = _mm_unpacklo_ps( x.v, y.v ), xyHi = _mm_unpackhi_ps( x.v, y.v );
+    __m128 u = _mm_shuffle_ps( z.v, xyLo, _MM_SHUFFLE( 3, 2, 1, 0 ) );
+    __m128 w = _mm_shuffle_ps( z.v, xyHi, _MM_SHUFFLE( 3, 2, 3, 2 ) );
+    _mm_storeu_ps( p, _mm_shuffle_ps( xyLo, u, _MM_SHUFFLE( 2, 0, 1, 0 ) ) );
+    _mm_storeu_ps( p + 4, _mm_shuffle_ps( u, xyHi, _MM_SHUFFLE( 1, 0, 1, 3 ) ) );
+    _mm_storeu_ps( p + 8, _mm_shuffle_ps( w, w, _MM_SHUFFLE( 1, 3, 2, 0 ) ) );
+}
+#else
+inline void SimdLoad3( const Float* p, SimdFloat* x, SimdFloat* y, SimdFloat* z )
+{
+    for ( int i = 0; i < SimdWidth; ++i ) {
+        x->v[ i ] = p[ 3 * i ];
+        y->v[ i ] = p[ 3 * i + 1 ];
+        z->v[ i ] = p[ 3 * i + 2 ];
+    }
+}
+inline void SimdStore3( Float* p, const SimdFloat& x, const SimdFloat& y, const SimdFloat& z )
+{
+    for ( int i = 0; i < SimdWidth; ++i ) {
+        p[ 3 * i ] = x.v[ i ];
+        p[ 3 * i + 1 ] = y.v[ i ];
+        p[ 3 * i + 2 ] = z.v[ i ];
+    }
+}
+#endif
+
+// Row-major 4x4 matrix kernels, only compiled in with vectors. They work on one row per SSE
+// vector on AVX targets too, where two-row vectors lose more to store forwarding than they gain.
+// SimdMatrixMul() sets r = a b, where r may alias a or b: each row of r is the rows of b weighted
+// by the entries of that row of a, broadcast one at a time.
+#if defined( PBRT_SIMD_AVX ) || defined( PBRT_SIMD_SSE )
+inline void SimdMatrixMul( const Float a[ 4 ][ 4 ], const Float b[ 4 ][ 4 ], Float r[ 4 ][ 4 ] )
+{
+    __m128 b0 = _mm_loadu_ps( b[ 0 ] ), b1 = _mm_loadu_ps( b[ 1 ] );
+    __m128 b2 = _mm_loadu_ps( b[ 2 ] ), b3 = _mm_loadu_ps( b[ 3 ] );
+    auto row = [&]( const Float ai[ 4 ] ) {
+        __m128 ri = _mm_mul_ps( _mm_set1_ps( ai[ 0 ] ), b0 );
+        ri = _mm_add_ps( ri, _mm_mul_ps( _mm_set1_ps( ai[ 1 ] ), b1 ) );
+        ri = _mm_add_ps( ri, _mm_mul_ps( _mm_set1_ps( ai[ 2 ] ), b2 ) );
+        return _mm_add_ps( ri, _mm_mul_ps( _mm_set1_ps( ai[ 3 ] ), b3 ) );
+    };
+    __m128 r0 = row( a[ 0 ] ), r1 = row( a[ 1 ] ), r2 = row( a[ 2 ] ), r3 = row( a[ 3 ] );
+    _mm_storeu_ps( r[ 0 ], r0 );
+    _mm_storeu_ps( r[ 1 ], r1 );
+    _mm_storeu_ps( r[ 2 ], r2 );
+    _mm_storeu_ps( r[ 3 ], r3 );
+}
+
+// SimdMatrixInverse() sets r = m^-1 from the 2x2 blocks of m = ( A B ; C D ), each held in one
+// vector as ( a00, a01, a10, a11 ). With # the adjugate,
+//     |m| = |A| |D| + |B| |C| - tr( A#B D#C ),
+//     m^-1 = ( |D| A - B D#C   |B| C - D ( A#B )# ; |C| B - A ( D#C )#   |A| D - C A#B )# / |m|,
+// the outer # applying to each block. Returns false, leaving r alone, when |m| or its reciprocal
+// is not finite, or when |m| is below SimdMatrixInverseMinDet times its Hadamard bound: without
+// pivoting, the formula loses much more to cancellation than Gauss-Jordan elimination once m is
+// nearly singular.
+static PBRT_CONSTEXPR Float SimdMatrixInverseMinDet = 1e-4f;
+inline bool SimdMatrixInverse( const Float m[ 4 ][ 4 ], Float r[ 4 ][ 4 ] )
+{
+#define PBRT_SWIZZLE( v, x, y, z, w ) _mm_shuffle_ps( v, v, _MM_SHUFFLE( w, z, y, x ) )
+    // products of 2x2 blocks: x y, x# y and x y#
+    auto mul2 = []( __m128 x, __m128 y ) {
+        return _mm_add_ps( _mm_mul_ps( x, PBRT_SWIZZLE( y, 0, 3, 0, 3 ) ),
+                           _mm_mul_ps( PBRT_SWIZZLE( x, 1, 0, 3, 2 ),
+                                       PBRT_SWIZZLE( y, 2, 1, 2, 1 ) ) );
+    };
+    auto adjMul2 = []( __m128 x, __m128 y ) {
+        return _mm_sub_ps( _mm_mul_ps( PBRT_SWIZZLE( x, 3, 3, 0, 0 ), y ),
+                           _mm_mul_ps( PBRT_SWIZZLE( x, 1, 1, 2, 2 ),
+                                       PBRT_SWIZZLE( y, 2, 3, 0, 1 ) ) );
+    };
+    auto mulAdj2 = []( __m128 x, __m128 y ) {
+        return _mm_sub_ps( _mm_mul_ps( x, PBRT_SWIZZLE( y, 3, 0, 3, 0 ) ),
+                           _mm_mul_ps( PBRT_SWIZZLE( x, 1, 0, 3, 2 ),
+                                       PBRT_SWIZZLE( y, 2, 1, 2, 1 ) ) );
+    };
+    __m128 r0 = _mm_loadu_ps( m[ 0 ] ), r1 = _mm_loadu_ps( m[ 1 ] );
+    __m128 r2 = _mm_loadu_ps( m[ 2 ] ), r3 = _mm_loadu_ps( m[ 3 ] );
+    __m128 A = _mm_movelh_ps( r0, r1 ), B = _mm_movehl_ps( r1, r0 );
+    __m128 C = _mm_movelh_ps( r2, r3 ), D = _mm_movehl_ps( r3, r2 );
+
+    // ( |A|, |B|, |C|, |D| )
+    __m128 dets = _mm_sub_ps(
+      _mm_mul_ps( _mm_shuffle_ps( r0, r2, _MM_SHUFFLE( 2, 0, 2, 0 ) ),
+                  _mm_shuffle_ps( r1, r3, _MM_SHUFFLE( 3, 1, 3, 1 ) ) ),
+      _mm_mul_ps( _mm_shuffle_ps( r0, r2, _MM_SHUFFLE( 3, 1, 3, 1 ) ),
+                  _mm_shuffle_ps( r1, r3, _MM_SHUFFLE( 2, 0, 2, 0 ) ) ) );
+    __m128 detA = PBRT_SWIZZLE( dets, 0, 0, 0, 0 ), detB = PBRT_SWIZZLE( dets, 1, 1, 1, 1 );
+    __m128 detC = PBRT_SWIZZLE( dets, 2, 2, 2, 2 ), detD = PBRT_SWIZZLE( dets, 3, 3, 3, 3 );
+
+    __m128 DC = adjMul2( D, C ), AB = adjMul2( A, B );
+    __m128 X = _mm_sub_ps( _mm_mul_ps( detD, A ), mul2( B, DC ) );
+    __m128 Y = _mm_sub_ps( _mm_mul_ps( detB, C ), mulAdj2( D, AB ) );
+    __m128 Z = _mm_sub_ps( _mm_mul_ps( detC, B ), mulAdj2( A, DC ) );
+    __m128 W = _mm_sub_ps( _mm_mul_ps( detA, D ), mul2( C, AB ) );
+
+    // tr( A#B D#C ), summed across the lanes with shuffles to stay within SSE2
+    __m128 tr = _mm_mul_ps( AB, PBRT_SWIZZLE( DC, 0, 2, 1, 3 ) );
+    tr = _mm_add_ps( tr, _mm_movehl_ps( tr, tr ) );
+    tr = _mm_add_ss( tr, PBRT_SWIZZLE( tr, 1, 1, 1, 1 ) );
+    Float det = _mm_cvtss_f32( dets ) * _mm_cvtss_f32( detD ) +
+                _mm_cvtss_f32( detB ) * _mm_cvtss_f32( detC ) - _mm_cvtss_f32( tr );
+    // Hadamard's bound: |m| is at most the product of the norms of m's rows, and of its columns
+    __m128 s0 = _mm_mul_ps( r0, r0 ), s1 = _mm_mul_ps( r1, r1 );
+    __m128 s2 = _mm_mul_ps( r2, r2 ), s3 = _mm_mul_ps( r3, r3 );
+    __m128 colNorms2 = _mm_add_ps( _mm_add_ps( s0, s1 ), _mm_add_ps( s2, s3 ) );
+    _MM_TRANSPOSE4_PS( s0, s1, s2, s3 );
+    __m128 rowNorms2 = _mm_add_ps( _mm_add_ps( s0, s1 ), _mm_add_ps( s2, s3 ) );
+    auto product = []( __m128 v ) {
+        v = _mm_mul_ps( v, _mm_movehl_ps( v, v ) );
+        return _mm_cvtss_f32( _mm_mul_ss( v, PBRT_SWIZZLE( v, 1, 1, 1, 1 ) ) );
+    };
+    Float bound2 = std::min( product( rowNorms2 ), product( colNorms2 ) );
+    Float invDet = 1 / det;
+    if ( !std::isfinite( det ) || !std::isfinite( invDet ) ||
+         !( det * det >= SimdMatrixInverseMinDet * SimdMatrixInverseMinDet * bound2 ) )
+        return false;
+#undef PBRT_SWIZZLE
+
+    // the block adjugates' signs, folded into the scale
+    __m128 scale = _mm_mul_ps( _mm_setr_ps( 1, -1, -1, 1 ), _mm_set1_ps( invDet ) );
+    X = _mm_mul_ps( X, scale );
+    Y = _mm_mul_ps( Y, scale );
+    Z = _mm_mul_ps( Z, scale );
+    W = _mm_mul_ps( W, scale );
+    _mm_storeu_ps( r[ 0 ], _mm_shuffle_ps( X, Y, _MM_SHUFFLE( 1, 3, 1, 3 ) ) );
+    _mm_storeu_ps( r[ 1 ], _mm_shuffle_ps( X, Y, _MM_SHUFFLE( 0, 2, 0, 2 ) ) );
+    _mm_storeu_ps( r[ 2 ], _mm_shuffle_ps( Z, W, _MM_SHUFFLE( 1, 3, 1, 3 ) ) );
+    _mm_storeu_ps( r[ 3 ], _mm_shuffle_ps( Z, W, _MM_SHUFFLE( 0, 2, 0, 2 ) ) );
+    return true;
+}
+#endif
+
+// index of the smallest lane among those set in mask (mask must not be empty)
+inline int MinLane( const SimdFloat& a, const SimdMask& mask )
+{
+    PBRT_SIMD_ALIGN Float lanes[ SimdWidth ];
+    a.Store( lanes );
+    int bits = mask.Bits();
+    int best = CountTrailingZeros( bits );
+    for ( bits &= bits - 1; bits; bits &= bits - 1 ) {
+        int i = CountTrailingZeros( bits );
+        if ( lanes[ i ] < lanes[ best ] )
+            best = i;
+    }
+    return best;
+}
+
+// Bounds3::IntersectP( ray, invDir, dirIsNeg ) for SimdWidth boxes at once; returns the boxes
+// that are hit and, for each lane, the parametric distance where the ray enters it. Boxes only
+// need to provide Plane( side, axis ), the lanes' lower (side 0) or upper (side 1) coordinates.
+template < typename Boxes >
+inline SimdMask SimdBoundsIntersectP( const Boxes& b, const Ray& ray, const RayPrecomputed& pre,
+                                      SimdFloat* hitt0 )
+{
+    const int* dirIsNeg = pre.dirIsNeg;
+    SimdFloat tMin = ( b.Plane( dirIsNeg[ 0 ], 0 ) - ray.o.x ) * pre.invDir.x;
+    SimdFloat tMax = ( b.Plane( 1 - dirIsNeg[ 0 ], 0 ) - ray.o.x ) * pre.invDir.x;
+    SimdFloat tyMin = ( b.Plane( dirIsNeg[ 1 ], 1 ) - ray.o.y ) * pre.invDir.y;
+    SimdFloat tyMax = ( b.Plane( 1 - dirIsNeg[ 1 ], 1 ) - ray.o.y ) * pre.invDir.y;
+    SimdFloat tzMin = ( b.Plane( dirIsNeg[ 2 ], 2 ) - ray.o.z ) * pre.invDir.z;
+    SimdFloat tzMax = ( b.Plane( 1 - dirIsNeg[ 2 ], 2 ) - ray.o.z ) * pre.invDir.z;
+
+    // update the far values to ensure robust bounds intersection
+    SimdFloat robust = 1 + 2 * gamma( 3 );
+    tMin = Max( tMin, Max( tyMin, tzMin ) );
+    tMax = Min( tMax * robust, Min( tyMax * robust, tzMax * robust ) );
+    *hitt0 = tMin;
+    return ( tMin <= tMax ) & ( tMin < ray.tMax ) & ( tMax > 0.f );
+}
+
+// SimdWidth boxes in SoA form. bounds[ 0 ] holds the lower corners and bounds[ 1 ] the upper ones,
+// mirroring Bounds3's operator[], so the slab test can pick near and far planes the same way.
+struct PBRT_SIMD_ALIGN SimdBounds3f
+{
+    Float bounds[ 2 ][ 3 ][ SimdWidth ];
+
+    void Set( int lane, const Bounds3f& b )
+    {
+        for ( int c = 0; c < 3; ++c ) {
+            bounds[ 0 ][ c ][ lane ] = b.pMin[ c ];
+            bounds[ 1 ][ c ][ lane ] = b.pMax[ c ];
+        }
+    }
+    // an inverted box, which no ray ever hits
+    void SetEmpty( int lane ) { Set( lane, Bounds3f() ); }
+    bool IsEmpty( int lane ) const { return bounds[ 0 ][ 0 ][ lane ] > bounds[ 1 ][ 0 ][ lane ]; }
+    // only meaningful for lanes that aren't empty
+    Bounds3f Get( int lane ) const
+    {
+        return Bounds3f( Point3f( bounds[ 0 ][ 0 ][ lane ], bounds[ 0 ][ 1 ][ lane ],
+                                  bounds[ 0 ][ 2 ][ lane ] ),
+                         Point3f( bounds[ 1 ][ 0 ][ lane ], bounds[ 1 ][ 1 ][ lane ],
+                                  bounds[ 1 ][ 2 ][ lane ] ) );
+    }
+
+    SimdFloat Plane( int side, int axis ) const
+    {
+        return SimdFloat::Load( bounds[ side ][ axis ] );
+    }
+    SimdMask IntersectP( const Ray& ray, const RayPrecomputed& pre, SimdFloat* hitt0 ) const
+    {
+        return SimdBoundsIntersectP( *this, ray, pre, hitt0 );
+    }
+};
+
+// SimdWidth boxes stored as 8-bit offsets on a grid spanning a common frame (usually the parent
+// node's bounds): 6 bytes per box instead of 24. Set() rounds outward, so a decoded box always
+// contains the box it was given. SetFrame() must be called before any Set().
+struct SimdQuantizedBounds3f
+{
+    Float origin[ 3 ], scale[ 3 ];
+    uint8_t q[ 2 ][ 3 ][ SimdWidth ];
+
+    void SetFrame( const Bounds3f& frame )
+    {
+        for ( int c = 0; c < 3; ++c ) {
+            origin[ c ] = frame.pMin[ c ];
+            // a degenerate extent still gets a nonzero step so that empty lanes stay inverted
+            Float extent = frame.pMax[ c ] - frame.pMin[ c ];
+            scale[ c ] = extent > 0 ? NextFloatUp( extent / 255 ) : 1;
+            while ( origin[ c ] + 255 * scale[ c ] < frame.pMax[ c ] )
+                scale[ c ] = NextFloatUp( scale[ c ] );
+        }
+    }
+    void Set( int lane, const Bounds3f& b )
+    {
+        for ( int c = 0; c < 3; ++c ) {
+            Float lo = std::floor( ( b.pMin[ c ] - origin[ c ] ) / scale[ c ] );
+            Float hi = std::ceil( ( b.pMax[ c ] - origin[ c ] ) / scale[ c ] );
+            q[ 0 ][ c ][ lane ] = ( uint8_t )Clamp( lo, 0, 255 );
+            q[ 1 ][ c ][ lane ] = ( uint8_t )Clamp( hi, 0, 255 );
+            // step outward until the decoded planes, computed exactly as traversal does, enclose b
+            while ( q[ 0 ][ c ][ lane ] > 0 && Plane( 0, c )[ lane ] > b.pMin[ c ] )
+                --q[ 0 ][ c ][ lane ];
+            while ( q[ 1 ][ c ][ lane ] < 255 && Plane( 1, c )[ lane ] < b.pMax[ c ] )
+                ++q[ 1 ][ c ][ lane ];
+        }
+    }
+    void SetEmpty( int lane )
+    {
+        for ( int c = 0; c < 3; ++c ) {
+            q[ 0 ][ c ][ lane ] = 255;
+            q[ 1 ][ c ][ lane ] = 0;
+        }
+    }
+
+    SimdFloat Plane( int side, int axis ) const
+    {
+        return origin[ axis ] + SimdFloat::LoadBytes( q[ side ][ axis ] ) * scale[ axis ];
+    }
+    SimdMask IntersectP( const Ray& ray, const RayPrecomputed& pre, SimdFloat* hitt0 ) const
+    {
+        return SimdBoundsIntersectP( *this, ray, pre, hitt0 );
+    }
+};
+
+} /* namespace pbrt */
+#endif /* simd_hpp */
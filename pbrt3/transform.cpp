@@ -8,6 +8,7 @@
 
 #include "transform.hpp"
 #include "interaction.hpp"
+#include "simd.hpp"
 
 namespace pbrt {
 
@@ -35,10 +36,157 @@ Matrix4x4::Matrix4x4( Float t00, Float t01, Float t02, Float t03, Float t10, Flo
     m[ 3 ][ 3 ] = t33;
 }
 
+static TransformType ClassifyMatrix( const Matrix4x4& m )
+{
+    const Float( *a )[ 4 ] = m.m;
+    // any NaN makes the matrix Projective; the comparisons below would classify a NaN in the
+    // upper 3x4 as Affine
+    for ( int i = 0; i < 4; ++i )
+        for ( int j = 0; j < 4; ++j )
+            if ( std::isnan( a[ i ][ j ] ) )
+                return TransformType::Projective;
+    if ( a[ 3 ][ 0 ] != 0 || a[ 3 ][ 1 ] != 0 || a[ 3 ][ 2 ] != 0 || a[ 3 ][ 3 ] != 1 )
+        return TransformType::Projective;
+    Float s = a[ 0 ][ 0 ];
+    if ( a[ 0 ][ 1 ] != 0 || a[ 0 ][ 2 ] != 0 || a[ 1 ][ 0 ] != 0 || a[ 1 ][ 2 ] != 0 ||
+         a[ 2 ][ 0 ] != 0 || a[ 2 ][ 1 ] != 0 || a[ 1 ][ 1 ] != s || a[ 2 ][ 2 ] != s )
+        return TransformType::Affine;
+    if ( s != 1 )
+        return TransformType::UniformScale;
+    if ( a[ 0 ][ 3 ] != 0 || a[ 1 ][ 3 ] != 0 || a[ 2 ][ 3 ] != 0 )
+        return TransformType::Translation;
+    return TransformType::Identity;
+}
+
+TransformType Transform::Classify( const Matrix4x4& m, const Matrix4x4& mInv )
+{
+    // normals go through mInv, so both matrices have to fit the type; the comparisons are exact
+    // (any NaN makes a matrix Projective), so the fast kernels only skip terms that are zero
+    return std::max( ClassifyMatrix( m ), ClassifyMatrix( mInv ) );
+}
+
+Matrix4x4 GaussJordanInverse( const Matrix4x4& m )
+{
+    int indxc[ 4 ], indxr[ 4 ];
+    int ipiv[ 4 ] = { 0, 0, 0, 0 };
+    Float minv[ 4 ][ 4 ];
+    memcpy( minv, m.m, 4 * 4 * sizeof( Float ) );
+    for ( int i = 0; i < 4; i++ ) {
+        int irow = 0, icol = 0;
+        Float big = 0.f;
+        // Choose pivot
+        for ( int j = 0; j < 4; j++ ) {
+            if ( ipiv[ j ] != 1 ) {
+                for ( int k = 0; k < 4; k++ ) {
+                    if ( ipiv[ k ] == 0 ) {
+                        if ( std::abs( minv[ j ][ k ] ) >= big ) {
+                            big = Float( std::abs( minv[ j ][ k ] ) );
+                            irow = j;
+                            icol = k;
+                        }
+                    } else if ( ipiv[ k ] > 1 )
+                        Error( "Singular matrix in MatrixInvert" );
+                }
+            }
+        }
+        ++ipiv[ icol ];
+        // Swap rows _irow_ and _icol_ for pivot
+        if ( irow != icol ) {
+            for ( int k = 0; k < 4; ++k )
+                std::swap( minv[ irow ][ k ], minv[ icol ][ k ] );
+        }
+        indxr[ i ] = irow;
+        indxc[ i ] = icol;
+        if ( minv[ icol ][ icol ] == 0.f )
+            Error( "Singular matrix in MatrixInvert" );
+
+        // Set $m[icol][icol]$ to one by scaling row _icol_ appropriately
+        Float pivinv = 1. / minv[ icol ][ icol ];
+        minv[ icol ][ icol ] = 1.;
+        for ( int j = 0; j < 4; j++ )
+            minv[ icol ][ j ] *= pivinv;
+
+        // Subtract this row from others to zero out their columns
+        for ( int j = 0; j < 4; j++ ) {
+            if ( j != icol ) {
+                Float save = minv[ j ][ icol ];
+                minv[ j ][ icol ] = 0;
+                for ( int k = 0; k < 4; k++ )
+                    minv[ j ][ k ] -= minv[ icol ][ k ] * save;
+            }
+        }
+    }
+    // Swap columns to reflect permutation
+    for ( int j = 3; j >= 0; j-- ) {
+        if ( indxr[ j ] != indxc[ j ] ) {
+            for ( int k = 0; k < 4; k++ )
+                std::swap( minv[ k ][ indxr[ j ] ], minv[ k ][ indxc[ j ] ] );
+        }
+    }
+    return Matrix4x4( minv );
+}
+
+// the inverse of the upper-left 3x3 block of m, by cofactors; false if it is singular or its
+// determinant over- or underflows
+static bool Inverse3x3( const Matrix4x4& m, Float inv[ 3 ][ 3 ] )
+{
+    const Float( *a )[ 4 ] = m.m;
+    Float c00 = a[ 1 ][ 1 ] * a[ 2 ][ 2 ] - a[ 1 ][ 2 ] * a[ 2 ][ 1 ];
+    Float c01 = a[ 1 ][ 2 ] * a[ 2 ][ 0 ] - a[ 1 ][ 0 ] * a[ 2 ][ 2 ];
+    Float c02 = a[ 1 ][ 0 ] * a[ 2 ][ 1 ] - a[ 1 ][ 1 ] * a[ 2 ][ 0 ];
+    Float det = a[ 0 ][ 0 ] * c00 + a[ 0 ][ 1 ] * c01 + a[ 0 ][ 2 ] * c02;
+    Float invDet = 1 / det;
+    if ( !std::isfinite( det ) || !std::isfinite( invDet ) )
+        return false;
+    inv[ 0 ][ 0 ] = c00 * invDet;
+    inv[ 1 ][ 0 ] = c01 * invDet;
+    inv[ 2 ][ 0 ] = c02 * invDet;
+    inv[ 0 ][ 1 ] = ( a[ 0 ][ 2 ] * a[ 2 ][ 1 ] - a[ 0 ][ 1 ] * a[ 2 ][ 2 ] ) * invDet;
+    inv[ 1 ][ 1 ] = ( a[ 0 ][ 0 ] * a[ 2 ][ 2 ] - a[ 0 ][ 2 ] * a[ 2 ][ 0 ] ) * invDet;
+    inv[ 2 ][ 1 ] = ( a[ 0 ][ 1 ] * a[ 2 ][ 0 ] - a[ 0 ][ 0 ] * a[ 2 ][ 1 ] ) * invDet;
+    inv[ 0 ][ 2 ] = ( a[ 0 ][ 1 ] * a[ 1 ][ 2 ] - a[ 0 ][ 2 ] * a[ 1 ][ 1 ] ) * invDet;
+    inv[ 1 ][ 2 ] = ( a[ 0 ][ 2 ] * a[ 1 ][ 0 ] - a[ 0 ][ 0 ] * a[ 1 ][ 2 ] ) * invDet;
+    inv[ 2 ][ 2 ] = ( a[ 0 ][ 0 ] * a[ 1 ][ 1 ] - a[ 0 ][ 1 ] * a[ 1 ][ 0 ] ) * invDet;
+    return true;
+}
+
+bool AffineInverse( const Matrix4x4& m, Matrix4x4* r )
+{
+    const Float( *a )[ 4 ] = m.m;
+    Float inv[ 3 ][ 3 ];
+    if ( a[ 3 ][ 0 ] != 0 || a[ 3 ][ 1 ] != 0 || a[ 3 ][ 2 ] != 0 || a[ 3 ][ 3 ] != 1 ||
+         !Inverse3x3( m, inv ) )
+        return false;
+    *r = Matrix4x4();
+    for ( int i = 0; i < 3; ++i ) {
+        for ( int j = 0; j < 3; ++j )
+            r->m[ i ][ j ] = inv[ i ][ j ];
+        r->m[ i ][ 3 ] = -( inv[ i ][ 0 ] * a[ 0 ][ 3 ] + inv[ i ][ 1 ] * a[ 1 ][ 3 ] +
+                            inv[ i ][ 2 ] * a[ 2 ][ 3 ] );
+    }
+    DCHECK( ClassifyMatrix( *r ) <= ClassifyMatrix( m ) );
+    return true;
+}
+
+Matrix4x4 Inverse( const Matrix4x4& m )
+{
+    // an affine m is inverted as its 3x3 block and translation, so that the inverse's last row
+    // is exactly ( 0, 0, 0, 1 ) and Transform( m ).Type() is the type of m itself; the 4x4
+    // kernels below only get that row to within rounding, which would make it Projective
+    Matrix4x4 r;
+    if ( AffineInverse( m, &r ) )
+        return r;
+#if defined( PBRT_SIMD_AVX ) || defined( PBRT_SIMD_SSE )
+    if ( SimdMatrixInverse( m.m, r.m ) )
+        return r;
+#endif
+    return GaussJordanInverse( m );
+}
+
 Transform Transform::Scale( Float x, Float y, Float z ) const
 {
     Matrix4x4 m( x, 0, 0, 0, 0, y, 0, 0, 0, 0, z, 0, 0, 0, 0, 1 );
-    Matrix4x4 mInv( 1 / x, 0, 0, 0, 0, 1 / x, 0, 0, 0, 0, 1 / x, 0, 0, 0, 0, 1 );
+    Matrix4x4 mInv( 1 / x, 0, 0, 0, 0, 1 / y, 0, 0, 0, 0, 1 / z, 0, 0, 0, 0, 1 );
     return Transform( m, mInv );
 }
 
@@ -136,15 +284,261 @@ SurfaceInteraction Transform::operator()( const SurfaceInteraction& si ) const
 {
     SurfaceInteraction ret;
     // transform p and pError in SurfaceInteraction
+    ret.p = ( *this )( si.p, si.pError, &ret.pError );
+
     // transform reamining members of SurfaceInteraction
+    const Transform& t = *this;
+    ret.n = Normalize( t( si.n ) );
+    ret.wo = Normalize( t( si.wo ) );
+    ret.time = si.time;
+    ret.mediumInterface = si.mediumInterface;
+    ret.uv = si.uv;
+    ret.shape = si.shape;
+    ret.dpdu = t( si.dpdu );
+    ret.dpdv = t( si.dpdv );
+    ret.dndu = t( si.dndu );
+    ret.dndv = t( si.dndv );
+    ret.shading.n = Normalize( t( si.shading.n ) );
+    ret.shading.dpdu = t( si.shading.dpdu );
+    ret.shading.dpdv = t( si.shading.dpdv );
+    ret.shading.dndu = t( si.shading.dndu );
+    ret.shading.dndv = t( si.shading.dndv );
+    ret.shading.n = FaceForward( ret.shading.n, ret.n );
     return ret;
 }
 
+Bounds3f Transform::operator()( const Bounds3f& b ) const
+{
+    // the transformed box is bounded by its transformed corners
+    const Transform& M = *this;
+    Bounds3f ret;
+    for ( int corner = 0; corner < 8; ++corner )
+        ret = Union( ret, M( b.Corner( corner ) ) );
+    return ret;
+}
+
+// the batch operators only take SimdWidth elements at a time when SimdFloat has vector registers
+// behind it; with the scalar emulation the per-element operators are faster
+#if defined( PBRT_SIMD_AVX ) || defined( PBRT_SIMD_SSE )
+static PBRT_CONSTEXPR bool BatchSimd = true;
+#else
+static PBRT_CONSTEXPR bool BatchSimd = false;
+#endif
+
+// a * x + b * y + c * z in SimdWidth lanes, evaluated in the same order as the scalar operators
+static inline SimdFloat SimdLinear( Float a, Float b, Float c, const SimdFloat v[ 3 ] )
+{
+    return a * v[ 0 ] + b * v[ 1 ] + c * v[ 2 ];
+}
+
+static inline SimdFloat SimdAbsLinear( Float a, Float b, Float c, const SimdFloat v[ 3 ] )
+{
+    return Abs( a * v[ 0 ] ) + Abs( b * v[ 1 ] ) + Abs( c * v[ 2 ] );
+}
+
+// operator()( p ), or operator()( p, pError ) when pErr is given, for SimdWidth points. Translation
+// and uniform scale take the affine path: the zeros of their matrices change nothing but the sign
+// of a zero result.
+static inline void SimdTransformPoints( const Matrix4x4& m, bool projective, const SimdFloat p[ 3 ],
+                                        SimdFloat pp[ 3 ], SimdFloat* pErr )
+{
+    const Float( *a )[ 4 ] = m.m;
+    for ( int c = 0; c < 3; ++c ) {
+        pp[ c ] = SimdLinear( a[ c ][ 0 ], a[ c ][ 1 ], a[ c ][ 2 ], p ) + a[ c ][ 3 ];
+        if ( pErr )
+            pErr[ c ] = gamma( 3 ) * ( SimdAbsLinear( a[ c ][ 0 ], a[ c ][ 1 ], a[ c ][ 2 ], p ) +
+                                       std::abs( a[ c ][ 3 ] ) );
+    }
+    if ( projective ) {
+        SimdFloat wp = SimdLinear( a[ 3 ][ 0 ], a[ 3 ][ 1 ], a[ 3 ][ 2 ], p ) + a[ 3 ][ 3 ];
+        CHECK( ( wp == 0.f ).None() );
+        // Point3::operator/() multiplies by the reciprocal, which is exact for w == 1, so the
+        // scalar operators' branch on it isn't needed
+        SimdFloat invW = 1.f / wp;
+        for ( int c = 0; c < 3; ++c )
+            pp[ c ] = invW * pp[ c ];
+    }
+}
+
+// operator()( v ), or operator()( v, vError ) when vErr is given, for SimdWidth vectors of a
+// transform that isn't a pure translation
+static inline void SimdTransformVectors( const Matrix4x4& m, const SimdFloat v[ 3 ],
+                                         SimdFloat vp[ 3 ], SimdFloat* vErr )
+{
+    const Float( *a )[ 4 ] = m.m;
+    for ( int c = 0; c < 3; ++c ) {
+        vp[ c ] = SimdLinear( a[ c ][ 0 ], a[ c ][ 1 ], a[ c ][ 2 ], v );
+        if ( vErr )
+            vErr[ c ] = gamma( 3 ) * SimdAbsLinear( a[ c ][ 0 ], a[ c ][ 1 ], a[ c ][ 2 ], v );
+    }
+}
+
+void Transform::TransformPoints( const Point3f* p, int n, Point3f* out, Vector3f* pError ) const
+{
+    static_assert( sizeof( Point3f ) == 3 * sizeof( Float ), "Point3f must be three Floats" );
+    if ( type == TransformType::Identity ) {
+        if ( out != p )
+            std::copy( p, p + n, out );
+        if ( pError )
+            std::fill( pError, pError + n, Vector3f( 0, 0, 0 ) );
+        return;
+    }
+    bool projective = type == TransformType::Projective;
+    int i = 0;
+    for ( ; BatchSimd && i + SimdWidth <= n; i += SimdWidth ) {
+        SimdFloat v[ 3 ], vp[ 3 ], vErr[ 3 ];
+        SimdLoad3( &p[ i ].x, &v[ 0 ], &v[ 1 ], &v[ 2 ] );
+        SimdTransformPoints( m, projective, v, vp, pError ? vErr : nullptr );
+        if ( pError )
+            SimdStore3( &pError[ i ].x, vErr[ 0 ], vErr[ 1 ], vErr[ 2 ] );
+        SimdStore3( &out[ i ].x, vp[ 0 ], vp[ 1 ], vp[ 2 ] );
+    }
+    for ( ; i < n; ++i )
+        out[ i ] = pError ? ( *this )( p[ i ], &pError[ i ] ) : ( *this )( p[ i ] );
+}
+
+void Transform::TransformVectors( const Vector3f* v, int n, Vector3f* out,
+                                  Vector3f* vError ) const
+{
+    static_assert( sizeof( Vector3f ) == 3 * sizeof( Float ), "Vector3f must be three Floats" );
+    if ( type <= TransformType::Translation ) {
+        if ( out != v )
+            std::copy( v, v + n, out );
+        if ( vError )
+            std::fill( vError, vError + n, Vector3f( 0, 0, 0 ) );
+        return;
+    }
+    int i = 0;
+    for ( ; BatchSimd && i + SimdWidth <= n; i += SimdWidth ) {
+        SimdFloat w[ 3 ], wp[ 3 ], wErr[ 3 ];
+        SimdLoad3( &v[ i ].x, &w[ 0 ], &w[ 1 ], &w[ 2 ] );
+        SimdTransformVectors( m, w, wp, vError ? wErr : nullptr );
+        if ( vError )
+            SimdStore3( &vError[ i ].x, wErr[ 0 ], wErr[ 1 ], wErr[ 2 ] );
+        SimdStore3( &out[ i ].x, wp[ 0 ], wp[ 1 ], wp[ 2 ] );
+    }
+    for ( ; i < n; ++i )
+        out[ i ] = vError ? ( *this )( v[ i ], &vError[ i ] ) : ( *this )( v[ i ] );
+}
+
+void Transform::TransformNormals( const Normal3f* nrm, int n, Normal3f* out ) const
+{
+    static_assert( sizeof( Normal3f ) == 3 * sizeof( Float ), "Normal3f must be three Floats" );
+    if ( type <= TransformType::Translation ) {
+        if ( out != nrm )
+            std::copy( nrm, nrm + n, out );
+        return;
+    }
+    // normals go through the transpose of the inverse
+    const Float( *a )[ 4 ] = mInv.m;
+    int i = 0;
+    for ( ; BatchSimd && i + SimdWidth <= n; i += SimdWidth ) {
+        SimdFloat w[ 3 ];
+        SimdLoad3( &nrm[ i ].x, &w[ 0 ], &w[ 1 ], &w[ 2 ] );
+        SimdStore3( &out[ i ].x, SimdLinear( a[ 0 ][ 0 ], a[ 1 ][ 0 ], a[ 2 ][ 0 ], w ),
+                    SimdLinear( a[ 0 ][ 1 ], a[ 1 ][ 1 ], a[ 2 ][ 1 ], w ),
+                    SimdLinear( a[ 0 ][ 2 ], a[ 1 ][ 2 ], a[ 2 ][ 2 ], w ) );
+    }
+    for ( ; i < n; ++i )
+        out[ i ] = ( *this )( nrm[ i ] );
+}
+
+void Transform::TransformRays( const Ray* r, int n, Ray* out, Vector3f* oError,
+                               Vector3f* dError ) const
+{
+    if ( type == TransformType::Identity ) {
+        for ( int i = 0; i < n; ++i )
+            out[ i ] = Ray( r[ i ].o, r[ i ].d, r[ i ].tMax, r[ i ].time, r[ i ].medium );
+        if ( oError )
+            std::fill( oError, oError + n, Vector3f( 0, 0, 0 ) );
+        if ( dError )
+            std::fill( dError, dError + n, Vector3f( 0, 0, 0 ) );
+        return;
+    }
+    // the scalar kernels for translation and uniform scale beat gathering rays into lanes
+    bool batch = BatchSimd && type >= TransformType::Affine;
+    bool projective = type == TransformType::Projective;
+    int i = 0;
+    for ( ; batch && i + SimdWidth <= n; i += SimdWidth ) {
+        // gather origins and directions into lanes: o in 0..2, d in 3..5, then dt in 6
+        PBRT_SIMD_ALIGN Float lanes[ 7 ][ SimdWidth ];
+        for ( int j = 0; j < SimdWidth; ++j )
+            for ( int c = 0; c < 3; ++c ) {
+                lanes[ c ][ j ] = r[ i + j ].o[ c ];
+                lanes[ 3 + c ][ j ] = r[ i + j ].d[ c ];
+            }
+        SimdFloat o[ 3 ], d[ 3 ], op[ 3 ], dp[ 3 ], oErr[ 3 ], dErr[ 3 ];
+        for ( int c = 0; c < 3; ++c ) {
+            o[ c ] = SimdFloat::Load( lanes[ c ] );
+            d[ c ] = SimdFloat::Load( lanes[ 3 + c ] );
+        }
+        SimdTransformPoints( m, projective, o, op, oErr );
+        SimdTransformVectors( m, d, dp, dErr );
+
+        // offset ray origin to edge of error bounds, as operator()( const Ray& ) does
+        SimdFloat lengthSquared = dp[ 0 ] * dp[ 0 ] + dp[ 1 ] * dp[ 1 ] + dp[ 2 ] * dp[ 2 ];
+        SimdMask offset = lengthSquared > 0.f;
+        SimdFloat dt = ( Abs( dp[ 0 ] ) * oErr[ 0 ] + Abs( dp[ 1 ] ) * oErr[ 1 ] +
+                         Abs( dp[ 2 ] ) * oErr[ 2 ] ) /
+                       lengthSquared;
+        for ( int c = 0; c < 3; ++c ) {
+            Select( offset, op[ c ] + dp[ c ] * dt, op[ c ] ).Store( lanes[ c ] );
+            dp[ c ].Store( lanes[ 3 + c ] );
+        }
+        Select( offset, dt, 0.f ).Store( lanes[ 6 ] );
+        for ( int j = 0; j < SimdWidth; ++j ) {
+            const Ray& ray = r[ i + j ];
+            out[ i + j ] = Ray( Point3f( lanes[ 0 ][ j ], lanes[ 1 ][ j ], lanes[ 2 ][ j ] ),
+                                Vector3f( lanes[ 3 ][ j ], lanes[ 4 ][ j ], lanes[ 5 ][ j ] ),
+                                ray.tMax - lanes[ 6 ][ j ], ray.time, ray.medium );
+        }
+        if ( oError )
+            SimdStore3( &oError[ i ].x, oErr[ 0 ], oErr[ 1 ], oErr[ 2 ] );
+        if ( dError )
+            SimdStore3( &dError[ i ].x, dErr[ 0 ], dErr[ 1 ], dErr[ 2 ] );
+    }
+    for ( ; i < n; ++i ) {
+        Vector3f oErr, dErr;
+        if ( oError || dError )
+            out[ i ] = ( *this )( r[ i ], oError ? &oError[ i ] : &oErr,
+                                  dError ? &dError[ i ] : &dErr );
+        else
+            out[ i ] = ( *this )( r[ i ] );
+    }
+}
+
 Transform Transform::operator*( const Transform& t2 ) const
 {
     return Transform( Matrix4x4::Mul( m, t2.m ), Matrix4x4::Mul( t2.mInv, mInv ) );
 }
 
+Transform Transform::Compose( const Transform* t, int n, Transform* prefix )
+{
+    // the products stay plain matrices, classified only where a Transform is handed out
+    Matrix4x4 m, mInv;
+    bool identity = true;
+    for ( auto i = 0; i < n; ++i ) {
+        if ( t[ i ].IsIdentity() ) {
+            if ( prefix )
+                prefix[ i ] = i > 0 ? prefix[ i - 1 ] : Transform();
+            continue;
+        }
+        if ( identity ) {
+            m = t[ i ].m;
+            mInv = t[ i ].mInv;
+            identity = false;
+        } else {
+            m = Matrix4x4::Mul( m, t[ i ].m );
+            mInv = Matrix4x4::Mul( t[ i ].mInv, mInv );
+        }
+        if ( prefix )
+            prefix[ i ] = Transform( m, mInv );
+    }
+    if ( prefix && n > 0 )
+        return prefix[ n - 1 ];
+    return identity ? Transform() : Transform( m, mInv );
+}
+
 bool Transform::operator==( const Transform& t2 ) const
 {
     return ( m == t2.m ); // && mInv == t2.mInv ); // is unnecessary
@@ -163,6 +557,27 @@ bool Transform::SwapsHandedness() const
     return det < 0;
 }
 
+// the symmetric bilinear form behind Quaternion::ToTransform()'s rotation matrix, written
+// homogeneously (w^2 + x^2 - y^2 - z^2 for 1 - 2 ( y^2 + z^2 ) and so on): r( q, q ) is the
+// rotation of the unit quaternion q
+static void RotationBilinear( const Quaternion& u, const Quaternion& v, Float r[ 3 ][ 3 ] )
+{
+    Float ww = u.w * v.w, xx = u.v.x * v.v.x, yy = u.v.y * v.v.y, zz = u.v.z * v.v.z;
+    Float xy = u.v.x * v.v.y + v.v.x * u.v.y, xz = u.v.x * v.v.z + v.v.x * u.v.z;
+    Float yz = u.v.y * v.v.z + v.v.y * u.v.z;
+    Float wx = u.w * v.v.x + v.w * u.v.x, wy = u.w * v.v.y + v.w * u.v.y;
+    Float wz = u.w * v.v.z + v.w * u.v.z;
+    r[ 0 ][ 0 ] = ww + xx - yy - zz;
+    r[ 0 ][ 1 ] = xy - wz;
+    r[ 0 ][ 2 ] = xz + wy;
+    r[ 1 ][ 0 ] = xy + wz;
+    r[ 1 ][ 1 ] = ww - xx + yy - zz;
+    r[ 1 ][ 2 ] = yz - wx;
+    r[ 2 ][ 0 ] = xz - wy;
+    r[ 2 ][ 1 ] = yz + wx;
+    r[ 2 ][ 2 ] = ww - xx - yy + zz;
+}
+
 AnimatedTransform::AnimatedTransform( const Transform* startTransform, Float startTime,
                                       const Transform* endTransform, Float endTime )
 : startTransform{ startTransform },
@@ -176,7 +591,70 @@ AnimatedTransform::AnimatedTransform( const Transform* startTransform, Float sta
     if ( Dot( R[ 0 ], R[ 1 ] ) < 0 )
         R[ 1 ] = -R[ 1 ]; // Flip R[1] if needed to select shortest path
     hasRotation = Dot( R[ 0 ], R[ 1 ] ) < .9995f;
-    // Compute terms of motion derivative function
+    scaleAnimated = S[ 0 ] != S[ 1 ];
+    SInv = Inverse( S[ 0 ] );
+    if ( !hasRotation )
+        return;
+
+    // split the slerp q0 cos( theta t ) + qperp sin( theta t ) into the constant, cos( 2 theta t )
+    // and sin( 2 theta t ) parts of its rotation matrix
+    Float cosTheta = Dot( R[ 0 ], R[ 1 ] );
+    theta = std::acos( Clamp( cosTheta, -1, 1 ) );
+    Quaternion qperp = Normalize( R[ 1 ] - R[ 0 ] * cosTheta );
+    Float r00[ 3 ][ 3 ], rpp[ 3 ][ 3 ];
+    RotationBilinear( R[ 0 ], R[ 0 ], r00 );
+    RotationBilinear( qperp, qperp, rpp );
+    RotationBilinear( R[ 0 ], qperp, RSin );
+    for ( auto i = 0; i < 3; ++i )
+        for ( auto j = 0; j < 3; ++j ) {
+            RConst[ i ][ j ] = ( r00[ i ][ j ] + rpp[ i ][ j ] ) * .5f;
+            RCos[ i ][ j ] = ( r00[ i ][ j ] - rpp[ i ][ j ] ) * .5f;
+        }
+
+    // compute terms of motion derivative function: differentiating T + R S p with S and T linear
+    // in t gives dT + R' S p + R dS p, which collects into c1 + ( c2 + c3 t ) cos( 2 theta t ) +
+    // ( c4 + c5 t ) sin( 2 theta t ) with
+    //     c1 = dT + RConst dS p,              c2 = 2 theta RSin S0 p + RCos dS p,
+    //     c3 = 2 theta RSin dS p,             c4 = -2 theta RCos S0 p + RSin dS p,
+    //     c5 = -2 theta RCos dS p
+    Vector3f dT = T[ 1 ] - T[ 0 ];
+    Float dS[ 3 ][ 3 ];
+    for ( auto i = 0; i < 3; ++i )
+        for ( auto j = 0; j < 3; ++j )
+            dS[ i ][ j ] = S[ 1 ].m[ i ][ j ] - S[ 0 ].m[ i ][ j ];
+    // row c of the 3x3 product a b
+    auto row = []( const Float a[ 3 ][ 3 ], const Float b[ 3 ][ 3 ], int c, Float scale,
+                   Float r[ 3 ] ) {
+        for ( auto j = 0; j < 3; ++j )
+            r[ j ] = scale * ( a[ c ][ 0 ] * b[ 0 ][ j ] + a[ c ][ 1 ] * b[ 1 ][ j ] +
+                               a[ c ][ 2 ] * b[ 2 ][ j ] );
+    };
+    Float S0[ 3 ][ 3 ];
+    for ( auto i = 0; i < 3; ++i )
+        for ( auto j = 0; j < 3; ++j )
+            S0[ i ][ j ] = S[ 0 ].m[ i ][ j ];
+    for ( auto c = 0; c < 3; ++c ) {
+        Float constDS[ 3 ], cosDS[ 3 ], sinDS[ 3 ], cosS0[ 3 ], sinS0[ 3 ];
+        row( RConst, dS, c, 1, constDS );
+        row( RCos, dS, c, 1, cosDS );
+        row( RSin, dS, c, 1, sinDS );
+        row( RCos, S0, c, 2 * theta, cosS0 );
+        row( RSin, S0, c, 2 * theta, sinS0 );
+        c1[ c ] = DerivativeTerm( dT[ c ], constDS[ 0 ], constDS[ 1 ], constDS[ 2 ] );
+        c2[ c ] = DerivativeTerm( 0, sinS0[ 0 ] + cosDS[ 0 ], sinS0[ 1 ] + cosDS[ 1 ],
+                                  sinS0[ 2 ] + cosDS[ 2 ] );
+        c3[ c ] = DerivativeTerm( 0, 2 * theta * sinDS[ 0 ], 2 * theta * sinDS[ 1 ],
+                                  2 * theta * sinDS[ 2 ] );
+        c4[ c ] = DerivativeTerm( 0, sinDS[ 0 ] - cosS0[ 0 ], sinDS[ 1 ] - cosS0[ 1 ],
+                                  sinDS[ 2 ] - cosS0[ 2 ] );
+        c5[ c ] = DerivativeTerm( 0, -2 * theta * cosDS[ 0 ], -2 * theta * cosDS[ 1 ],
+                                  -2 * theta * cosDS[ 2 ] );
+    }
+    for ( auto s = 0; s <= nMotionSegments; ++s ) {
+        Float t = ( Float )s / nMotionSegments;
+        cos2Theta[ s ] = std::cos( 2 * theta * t );
+        sin2Theta[ s ] = std::sin( 2 * theta * t );
+    }
 }
 
 void AnimatedTransform::Decompose( const Matrix4x4& m, Vector3f* T, Quaternion* Rquat,
@@ -218,6 +696,60 @@ void AnimatedTransform::Decompose( const Matrix4x4& m, Vector3f* T, Quaternion*
     *S = Matrix4x4::Mul( Inverse( R ), M );
 }
 
+Transform AnimatedTransform::interpolate( Float dt ) const
+{
+    // Interpolate translation at dt
+    Vector3f trans = ( 1 - dt ) * T[ 0 ] + dt * T[ 1 ];
+    // Interpolate rotation at dt
+    Transform rotate = Slerp( dt, R[ 0 ], R[ 1 ] ).ToTransform();
+    // Interpolate scale at dt, and invert it unless it doesn't change
+    Matrix4x4 scale = S[ 0 ], scaleInv = SInv;
+    if ( scaleAnimated ) {
+        for ( auto i = 0; i < 3; ++i )
+            for ( auto j = 0; j < 3; ++j )
+                scale.m[ i ][ j ] = Lerp( dt, S[ 0 ].m[ i ][ j ], S[ 1 ].m[ i ][ j ] );
+        Float inv[ 3 ][ 3 ];
+        if ( Inverse3x3( scale, inv ) ) {
+            for ( auto i = 0; i < 3; ++i )
+                for ( auto j = 0; j < 3; ++j )
+                    scaleInv.m[ i ][ j ] = inv[ i ][ j ];
+        } else
+            scaleInv = Inverse( scale );
+    }
+    // compose translate * rotate * scale and its inverse directly; all three are affine, so only
+    // the 3x3 blocks multiply and the inverse's translation is -( S^-1 R^-1 ) trans
+    const Matrix4x4& r = rotate.GetMatrix();
+    const Matrix4x4& rInv = rotate.GetInverseMatrix();
+    Matrix4x4 m, mInv;
+    for ( auto i = 0; i < 3; ++i ) {
+        for ( auto j = 0; j < 3; ++j ) {
+            m.m[ i ][ j ] = r.m[ i ][ 0 ] * scale.m[ 0 ][ j ] + r.m[ i ][ 1 ] * scale.m[ 1 ][ j ] +
+                            r.m[ i ][ 2 ] * scale.m[ 2 ][ j ];
+            mInv.m[ i ][ j ] = scaleInv.m[ i ][ 0 ] * rInv.m[ 0 ][ j ] +
+                               scaleInv.m[ i ][ 1 ] * rInv.m[ 1 ][ j ] +
+                               scaleInv.m[ i ][ 2 ] * rInv.m[ 2 ][ j ];
+        }
+        m.m[ i ][ 3 ] = trans[ i ];
+    }
+    for ( auto i = 0; i < 3; ++i )
+        mInv.m[ i ][ 3 ] = -( mInv.m[ i ][ 0 ] * trans.x + mInv.m[ i ][ 1 ] * trans.y +
+                              mInv.m[ i ][ 2 ] * trans.z );
+    return Transform( m, mInv );
+}
+
+// entry-wise lerp of two transforms and of their inverses
+static Transform LerpTransform( Float t, const Transform& t0, const Transform& t1 )
+{
+    Matrix4x4 m, mInv;
+    for ( auto i = 0; i < 4; ++i )
+        for ( auto j = 0; j < 4; ++j ) {
+            m.m[ i ][ j ] = Lerp( t, t0.GetMatrix().m[ i ][ j ], t1.GetMatrix().m[ i ][ j ] );
+            mInv.m[ i ][ j ] =
+              Lerp( t, t0.GetInverseMatrix().m[ i ][ j ], t1.GetInverseMatrix().m[ i ][ j ] );
+        }
+    return Transform( m, mInv );
+}
+
 void AnimatedTransform::Interpolate( Float time, Transform* t ) const
 {
     // Handle boundary conditions for matrix interpolation
@@ -230,29 +762,93 @@ void AnimatedTransform::Interpolate( Float time, Transform* t ) const
         return;
     }
     Float dt = ( time - startTime ) / ( endTime - startTime );
-    // Interpolate translation at dt
-    Vector3f trans = ( 1 - dt ) * T[ 0 ] + dt * T[ 1 ];
-    // Interpolate rotation at dt
-    Quaternion rotate = Slerp( dt, R[ 0 ], R[ 1 ] );
-    // Interpolate scale at dt
-    Matrix4x4 scale;
-    for ( auto i = 0; i < 3; ++i )
-        for ( auto j = 0; j < 3; ++j )
-            scale.m[ i ][ j ] = Lerp( dt, S[ 0 ].m[ i ][ j ], S[ 1 ].m[ i ][ j ] );
-    // compute interpolated matrix as product of interpolated components
-    *t = t->Translate( trans ) * rotate.ToTransform() * Transform( scale );
+    if ( table.empty() ) {
+        *t = interpolate( dt );
+        return;
+    }
+    int nSegments = ( int )table.size() - 1;
+    Float x = dt * nSegments;
+    int segment = std::min( ( int )x, nSegments - 1 );
+    *t = LerpTransform( x - segment, table[ segment ], table[ segment + 1 ] );
 }
 
-Ray AnimatedTransform::operator()( const Ray& r ) const { return Ray{}; }
+void AnimatedTransform::PrecomputeInterpolation( Float tolerance, int maxSegments )
+{
+    table.clear();
+    if ( !actuallyAnimated )
+        return;
+    std::vector< Transform > samples{ interpolate( 0 ), interpolate( 1 ) };
+    while ( true ) {
+        // compare every segment's lerped midpoint with the exact one, which is also the sample
+        // that halving the segment adds
+        int nSegments = ( int )samples.size() - 1;
+        std::vector< Transform > refined;
+        Float maxError = 0;
+        for ( auto i = 0; i < nSegments; ++i ) {
+            Transform exact = interpolate( ( i + .5f ) / nSegments );
+            Transform lerped = LerpTransform( .5f, samples[ i ], samples[ i + 1 ] );
+            for ( auto j = 0; j < 3; ++j )
+                for ( auto k = 0; k < 4; ++k ) {
+                    maxError = std::max( maxError, std::abs( exact.GetMatrix().m[ j ][ k ] -
+                                                             lerped.GetMatrix().m[ j ][ k ] ) );
+                    maxError = std::max( maxError,
+                                         std::abs( exact.GetInverseMatrix().m[ j ][ k ] -
+                                                   lerped.GetInverseMatrix().m[ j ][ k ] ) );
+                }
+            refined.push_back( samples[ i ] );
+            refined.push_back( exact );
+        }
+        if ( maxError <= tolerance || nSegments >= maxSegments )
+            break;
+        refined.push_back( samples.back() );
+        samples.swap( refined );
+    }
+    table.swap( samples );
+}
+
+Ray AnimatedTransform::operator()( const Ray& r ) const
+{
+    if ( !actuallyAnimated || r.time <= startTime )
+        return ( *startTransform )( r );
+    if ( r.time >= endTime )
+        return ( *endTransform )( r );
+    Transform t;
+    Interpolate( r.time, &t );
+    return t( r );
+}
 
 RayDifferential AnimatedTransform::operator()( const RayDifferential& r ) const
 {
-    return RayDifferential{};
+    if ( !actuallyAnimated || r.time <= startTime )
+        return ( *startTransform )( r );
+    if ( r.time >= endTime )
+        return ( *endTransform )( r );
+    Transform t;
+    Interpolate( r.time, &t );
+    return t( r );
 }
 
-Point3f AnimatedTransform::operator()( const Point3f& p ) const { return Point3f{}; }
+Point3f AnimatedTransform::operator()( Float time, const Point3f& p ) const
+{
+    if ( !actuallyAnimated || time <= startTime )
+        return ( *startTransform )( p );
+    if ( time >= endTime )
+        return ( *endTransform )( p );
+    Transform t;
+    Interpolate( time, &t );
+    return t( p );
+}
 
-Vector3f AnimatedTransform::operator()( const Vector3f& v ) const { return Vector3f{}; }
+Vector3f AnimatedTransform::operator()( Float time, const Vector3f& v ) const
+{
+    if ( !actuallyAnimated || time <= startTime )
+        return ( *startTransform )( v );
+    if ( time >= endTime )
+        return ( *endTransform )( v );
+    Transform t;
+    Interpolate( time, &t );
+    return t( v );
+}
 
 Bounds3f AnimatedTransform::MotionBounds( const Bounds3f& b ) const
 {
@@ -260,29 +856,201 @@ Bounds3f AnimatedTransform::MotionBounds( const Bounds3f& b ) const
         return ( *startTransform )( b );
     if ( !hasRotation )
         return Union( ( *startTransform )( b ), ( *endTransform )( b ) );
-    // otherwise return motion bounds accounting for animated rotateion:
-    Bounds3f bounds;
+    // otherwise return motion bounds accounting for animated rotation:
+    Point3f corners[ 8 ];
     for ( auto corner = 0; corner < 8; ++corner )
-        bounds = Union( bounds, BoundPointMotion( b.Corner( corner ) ) );
-    return bounds;
+        corners[ corner ] = b.Corner( corner );
+    return boundPointsMotion( corners, 8 );
+}
+
+// Sets the keys from boundsAt( time ), the bounds at one time, for a motion that is only linear
+// between startTime and endTime: a segment ( time0, time1 ) straddling either of them bends there,
+// so its keys can't be lerped and both become the union of the bounds at time0, at the
+// breakpoints inside the segment and at time1.
+template < typename BoundsAt >
+static void LinearKeys( BoundsAt boundsAt, Float startTime, Float endTime, Float time0,
+                        Float time1, Bounds3f* bounds0, Bounds3f* bounds1 )
+{
+    *bounds0 = boundsAt( time0 );
+    *bounds1 = boundsAt( time1 );
+    bool straddlesStart = time0 < startTime && startTime < time1;
+    bool straddlesEnd = time0 < endTime && endTime < time1;
+    if ( !straddlesStart && !straddlesEnd )
+        return;
+    Bounds3f bounds = Union( *bounds0, *bounds1 );
+    if ( straddlesStart )
+        bounds = Union( bounds, boundsAt( startTime ) );
+    if ( straddlesEnd )
+        bounds = Union( bounds, boundsAt( endTime ) );
+    *bounds0 = *bounds1 = bounds;
+}
+
+void AnimatedTransform::LinearMotionBounds( const Bounds3f& b, Float time0, Float time1,
+                                            Bounds3f* bounds0, Bounds3f* bounds1 ) const
+{
+    if ( !actuallyAnimated ) {
+        *bounds0 = *bounds1 = ( *startTransform )( b );
+        return;
+    }
+    if ( !hasRotation ) {
+        // translation and scale are interpolated linearly, so every point moves along a line
+        auto boundsAt = [&]( Float time ) {
+            Transform t;
+            Interpolate( time, &t );
+            return t( b );
+        };
+        LinearKeys( boundsAt, startTime, endTime, time0, time1, bounds0, bounds1 );
+        return;
+    }
+    // rotation moves points along arcs; bound the rotated, scaled box by a sphere around the
+    // interpolated translation, which still moves linearly
+    Float radius = 0;
+    for ( auto corner = 0; corner < 8; ++corner ) {
+        Point3f p = b.Corner( corner );
+        for ( auto i = 0; i < 2; ++i ) {
+            const Matrix4x4& s = S[ i ];
+            Vector3f sp( s.m[ 0 ][ 0 ] * p.x + s.m[ 0 ][ 1 ] * p.y + s.m[ 0 ][ 2 ] * p.z,
+                         s.m[ 1 ][ 0 ] * p.x + s.m[ 1 ][ 1 ] * p.y + s.m[ 1 ][ 2 ] * p.z,
+                         s.m[ 2 ][ 0 ] * p.x + s.m[ 2 ][ 1 ] * p.y + s.m[ 2 ][ 2 ] * p.z );
+            radius = std::max( radius, sp.Length() );
+        }
+    }
+    radius = NextFloatUp( radius );
+    Vector3f r( radius, radius, radius );
+    auto boundsAt = [&]( Float time ) {
+        Float dt = Clamp( ( time - startTime ) / ( endTime - startTime ), 0, 1 );
+        Vector3f c = ( 1 - dt ) * T[ 0 ] + dt * T[ 1 ];
+        return Bounds3f( Point3f( c.x, c.y, c.z ) - r, Point3f( c.x, c.y, c.z ) + r );
+    };
+    LinearKeys( boundsAt, startTime, endTime, time0, time1, bounds0, bounds1 );
 }
 
 Bounds3f AnimatedTransform::BoundPointMotion( const Point3f& p ) const
 {
-    Bounds3f bounds( ( *startTransform )( p ), ( *endTransform )( p ) );
-    Float cosTheta = Dot( R[ 0 ], R[ 1 ] );
-    Float theta = std::acos( Clamp( cosTheta, -1, 1 ) );
-    for ( auto c = 0; c < 3; ++c ) {
-        // find any motion derivative zeros for the component c
-        Float zeros[ 4 ];
-        int nZeros = 0;
-        IntervalFindZeros( c1[ c ].Eval( p ), c2[ c ].Eval( p ), c3[ c ].Eval( p ),
-                           c4[ c ].Eval( p ), c5[ c ].Eval( p ), theta, Interval( 0., 1. ), zeros,
-                           &nZeros );
-        // expand bounding box for any motion derivative zeros found
-        for ( auto i = 0; i < nZeros; ++i ) {
-            Point3f pz = ( *this )( Lerp( zeros[ i ], startTime, endTime ), p );
-            bounds = Union( bounds, pz );
+    if ( !actuallyAnimated )
+        return Bounds3f( ( *startTransform )( p ) );
+    if ( !hasRotation )
+        return Bounds3f( ( *startTransform )( p ), ( *endTransform )( p ) );
+    return boundPointsMotion( &p, 1 );
+}
+
+Point3f AnimatedTransform::motionPoint( Float dt, const Point3f& p ) const
+{
+    Float cosine = std::cos( 2 * theta * dt ), sine = std::sin( 2 * theta * dt );
+    Float sp[ 3 ];
+    for ( auto i = 0; i < 3; ++i )
+        sp[ i ] = Lerp( dt, S[ 0 ].m[ i ][ 0 ], S[ 1 ].m[ i ][ 0 ] ) * p.x +
+                  Lerp( dt, S[ 0 ].m[ i ][ 1 ], S[ 1 ].m[ i ][ 1 ] ) * p.y +
+                  Lerp( dt, S[ 0 ].m[ i ][ 2 ], S[ 1 ].m[ i ][ 2 ] ) * p.z;
+    Point3f r;
+    for ( auto i = 0; i < 3; ++i ) {
+        r[ i ] = Lerp( dt, T[ 0 ][ i ], T[ 1 ][ i ] );
+        for ( auto j = 0; j < 3; ++j )
+            r[ i ] +=
+              ( RConst[ i ][ j ] + RCos[ i ][ j ] * cosine + RSin[ i ][ j ] * sine ) * sp[ j ];
+    }
+    return r;
+}
+
+// refines a zero of c[ 0 ] + ( c[ 1 ] + c[ 2 ] t ) cos( 2 theta t ) + ( c[ 3 ] + c[ 4 ] t )
+// sin( 2 theta t ), which is f0 at t0 and f1 at t1, with Newton's method from the secant's zero,
+// bisecting whenever a step would leave [ t0, t1 ]; when the function changes sign across the
+// interval, the interval shrinks to keep the bracket
+static Float RefineMotionZero( const Float c[ 5 ], Float theta, Float t0, Float t1, Float f0,
+                               Float f1 )
+{
+    bool negative0 = f0 <= 0, bracketed = negative0 != ( f1 <= 0 );
+    Float t = bracketed ? t0 + ( t1 - t0 ) * f0 / ( f0 - f1 ) : ( t0 + t1 ) * .5f;
+    for ( auto i = 0; i < 8; ++i ) {
+        Float cosine = std::cos( 2 * theta * t ), sine = std::sin( 2 * theta * t );
+        Float fNewton = c[ 0 ] + ( c[ 1 ] + c[ 2 ] * t ) * cosine + ( c[ 3 ] + c[ 4 ] * t ) * sine;
+        Float fPrimeNewton = ( c[ 2 ] + 2 * ( c[ 3 ] + c[ 4 ] * t ) * theta ) * cosine +
+                             ( c[ 4 ] - 2 * ( c[ 1 ] + c[ 2 ] * t ) * theta ) * sine;
+        if ( fNewton == 0 )
+            break;
+        if ( bracketed ) {
+            if ( ( fNewton <= 0 ) == negative0 )
+                t0 = t;
+            else
+                t1 = t;
+        }
+        Float tNewton = fPrimeNewton != 0 ? t - fNewton / fPrimeNewton : t0;
+        if ( !( tNewton > t0 && tNewton < t1 ) )
+            tNewton = ( t0 + t1 ) * .5f;
+        bool converged = std::abs( tNewton - t ) <= 1e-6f;
+        t = tNewton;
+        if ( converged )
+            break;
+    }
+    return t;
+}
+
+// Bounds the rotating motion of the points p[ 0 .. n ) by their ends and by every place where the
+// derivative of one of their coordinates is zero. Those are searched for SimdWidth points and
+// one axis at a time: the derivatives are sampled on the nMotionSegments cells of [ 0, 1 ] with
+// the precomputed cos2Theta and sin2Theta, and only cells where a derivative changes sign, or
+// comes close enough to zero at an end that its curvature bound allows a zero, are refined one
+// lane at a time.
+// Nothing is cached, so different primitives can be bounded in parallel.
+Bounds3f AnimatedTransform::boundPointsMotion( const Point3f* p, int n ) const
+{
+    Bounds3f bounds;
+    for ( auto i = 0; i < n; ++i )
+        bounds = Union( Union( bounds, ( *startTransform )( p[ i ] ) ),
+                        ( *endTransform )( p[ i ] ) );
+    const Float h = Float( 1 ) / nMotionSegments;
+    for ( auto first = 0; first < n; first += SimdWidth ) {
+        // lanes past the end repeat the last point and are masked off
+        PBRT_SIMD_ALIGN Float lanes[ 3 ][ SimdWidth ];
+        for ( auto j = 0; j < SimdWidth; ++j )
+            for ( auto c = 0; c < 3; ++c )
+                lanes[ c ][ j ] = p[ std::min( first + j, n - 1 ) ][ c ];
+        SimdFloat px = SimdFloat::Load( lanes[ 0 ] ), py = SimdFloat::Load( lanes[ 1 ] ),
+                  pz = SimdFloat::Load( lanes[ 2 ] );
+        int valid = n - first >= SimdWidth ? ( 1 << SimdWidth ) - 1 : ( 1 << ( n - first ) ) - 1;
+        for ( auto c = 0; c < 3; ++c ) {
+            const DerivativeTerm* terms[ 5 ] = { &c1[ c ], &c2[ c ], &c3[ c ], &c4[ c ], &c5[ c ] };
+            SimdFloat k[ 5 ];
+            for ( auto i = 0; i < 5; ++i )
+                k[ i ] = terms[ i ]->kc + terms[ i ]->kx * px + terms[ i ]->ky * py +
+                         terms[ i ]->kz * pz;
+            // f is within |f''| h^2 / 8 of the chord across a cell, so a cell where f keeps its
+            // sign can only hold a zero if f is that close to zero at one of its ends
+            SimdFloat sum = Abs( k[ 1 ] ) + Abs( k[ 2 ] ) + Abs( k[ 3 ] ) + Abs( k[ 4 ] );
+            SimdFloat slack = ( h * h / 8 ) * ( 4 * theta * ( Abs( k[ 2 ] ) + Abs( k[ 4 ] ) ) +
+                                                4 * theta * theta * sum );
+            PBRT_SIMD_ALIGN Float coefficients[ 5 ][ SimdWidth ], ends[ 2 ][ SimdWidth ];
+            bool stored = false;
+            SimdFloat fPrev = k[ 0 ] + k[ 1 ];
+            for ( auto s = 1; s <= nMotionSegments; ++s ) {
+                Float t = s * h;
+                SimdFloat f = k[ 0 ] + ( k[ 1 ] + k[ 2 ] * t ) * cos2Theta[ s ] +
+                              ( k[ 3 ] + k[ 4 ] * t ) * sin2Theta[ s ];
+                SimdMask candidates =
+                  ( ( fPrev <= 0 ) ^ ( f <= 0 ) ) | ( Min( Abs( fPrev ), Abs( f ) ) <= slack );
+                int bits = candidates.Bits() & valid;
+                if ( !bits ) {
+                    fPrev = f;
+                    continue;
+                }
+                fPrev.Store( ends[ 0 ] );
+                f.Store( ends[ 1 ] );
+                fPrev = f;
+                if ( !stored ) {
+                    for ( auto i = 0; i < 5; ++i )
+                        k[ i ].Store( coefficients[ i ] );
+                    stored = true;
+                }
+                for ( ; bits; bits &= bits - 1 ) {
+                    int j = CountTrailingZeros( bits );
+                    Float coeffs[ 5 ] = { coefficients[ 0 ][ j ], coefficients[ 1 ][ j ],
+                                          coefficients[ 2 ][ j ], coefficients[ 3 ][ j ],
+                                          coefficients[ 4 ][ j ] };
+                    Float zero = RefineMotionZero( coeffs, theta, t - h, t, ends[ 0 ][ j ],
+                                                   ends[ 1 ][ j ] );
+                    bounds = Union( bounds, motionPoint( zero, p[ first + j ] ) );
+                }
+            }
         }
     }
     return bounds;
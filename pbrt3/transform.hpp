@@ -12,6 +12,7 @@
 #include "geometry.hpp"
 #include "pbrt.hpp"
 #include "quaternion.hpp"
+#include "simd.hpp"
 #include "stringprint.hpp"
 
 namespace pbrt {
@@ -72,7 +73,8 @@ struct Matrix4x4
         }
     }
 
-    static Matrix4x4 Mul( const Matrix4x4& m1, const Matrix4x4& m2 )
+    // the plain loop, which Mul() replaces with SimdMatrixMul() when vectors are compiled in
+    static Matrix4x4 ScalarMul( const Matrix4x4& m1, const Matrix4x4& m2 )
     {
         Matrix4x4 r;
         for ( auto i = 0; i < 4; ++i )
@@ -82,67 +84,21 @@ struct Matrix4x4
         return r;
     }
 
-    friend Matrix4x4 Inverse( const Matrix4x4& m )
+    static Matrix4x4 Mul( const Matrix4x4& m1, const Matrix4x4& m2 )
     {
-        int indxc[ 4 ], indxr[ 4 ];
-        int ipiv[ 4 ] = { 0, 0, 0, 0 };
-        Float minv[ 4 ][ 4 ];
-        memcpy( minv, m.m, 4 * 4 * sizeof( Float ) );
-        for ( int i = 0; i < 4; i++ ) {
-            int irow = 0, icol = 0;
-            Float big = 0.f;
-            // Choose pivot
-            for ( int j = 0; j < 4; j++ ) {
-                if ( ipiv[ j ] != 1 ) {
-                    for ( int k = 0; k < 4; k++ ) {
-                        if ( ipiv[ k ] == 0 ) {
-                            if ( std::abs( minv[ j ][ k ] ) >= big ) {
-                                big = Float( std::abs( minv[ j ][ k ] ) );
-                                irow = j;
-                                icol = k;
-                            }
-                        } else if ( ipiv[ k ] > 1 )
-                            Error( "Singular matrix in MatrixInvert" );
-                    }
-                }
-            }
-            ++ipiv[ icol ];
-            // Swap rows _irow_ and _icol_ for pivot
-            if ( irow != icol ) {
-                for ( int k = 0; k < 4; ++k )
-                    std::swap( minv[ irow ][ k ], minv[ icol ][ k ] );
-            }
-            indxr[ i ] = irow;
-            indxc[ i ] = icol;
-            if ( minv[ icol ][ icol ] == 0.f )
-                Error( "Singular matrix in MatrixInvert" );
-
-            // Set $m[icol][icol]$ to one by scaling row _icol_ appropriately
-            Float pivinv = 1. / minv[ icol ][ icol ];
-            minv[ icol ][ icol ] = 1.;
-            for ( int j = 0; j < 4; j++ )
-                minv[ icol ][ j ] *= pivinv;
-
-            // Subtract this row from others to zero out their columns
-            for ( int j = 0; j < 4; j++ ) {
-                if ( j != icol ) {
-                    Float save = minv[ j ][ icol ];
-                    minv[ j ][ icol ] = 0;
-                    for ( int k = 0; k < 4; k++ )
-                        minv[ j ][ k ] -= minv[ icol ][ k ] * save;
-                }
-            }
-        }
-        // Swap columns to reflect permutation
-        for ( int j = 3; j >= 0; j-- ) {
-            if ( indxr[ j ] != indxc[ j ] ) {
-                for ( int k = 0; k < 4; k++ )
-                    std::swap( minv[ k ][ indxr[ j ] ], minv[ k ][ indxc[ j ] ] );
-            }
-        }
-        return Matrix4x4( minv );
+#if defined( PBRT_SIMD_AVX ) || defined( PBRT_SIMD_SSE )
+        Matrix4x4 r;
+        SimdMatrixMul( m1.m, m2.m, r.m );
+        return r;
+#else
+        return ScalarMul( m1, m2 );
+#endif
     }
 
+    // by blocks with SSE, falling back to Gauss-Jordan elimination with full pivoting (which
+    // reports singular matrices) otherwise and for nearly singular matrices
+    friend Matrix4x4 Inverse( const Matrix4x4& m );
+
     friend std::ostream& operator<<( std::ostream& os, const Matrix4x4& m )
     {
         os << StringPrintf( "[ [ %f, %f, %f, %f ] "
@@ -157,14 +113,33 @@ struct Matrix4x4
     }
 };
 
+// the other paths Inverse() chooses from, for callers that need one in particular: the 3x3 block
+// and translation of an affine m (false, leaving r alone, if m isn't affine or the block is
+// singular), and Gauss-Jordan elimination
+bool AffineInverse( const Matrix4x4& m, Matrix4x4* r );
+Matrix4x4 GaussJordanInverse( const Matrix4x4& m );
+
+// What a Transform's matrix does, from the cheapest to apply to the most general; each class
+// contains the ones before it. Translation and UniformScale may also translate, Affine is any
+// matrix whose last row is ( 0, 0, 0, 1 ), and only Projective needs the divide by w.
+enum class TransformType : uint8_t { Identity, Translation, UniformScale, Affine, Projective };
+
+// Points, vectors and normals are transformed by a kernel chosen by the transform's type, which
+// is found once at construction: a translation is three adds, and no affine transform computes w.
 class Transform {
   public:
     Transform() {}
-    Transform( const Float mat[ 4 ][ 4 ] ) : m{ mat }, mInv{ Inverse( m ) } {}
-    Transform( const Matrix4x4& m ) : m{ m }, mInv{ Inverse( m ) } {}
-    Transform( const Matrix4x4& m, const Matrix4x4& mInv ) : m{ m }, mInv{ mInv } {}
+    Transform( const Float mat[ 4 ][ 4 ] )
+    : m{ mat }, mInv{ Inverse( m ) }, type{ Classify( m, mInv ) }
+    {
+    }
+    Transform( const Matrix4x4& m ) : m{ m }, mInv{ Inverse( m ) }, type{ Classify( m, mInv ) } {}
+    Transform( const Matrix4x4& m, const Matrix4x4& mInv )
+    : m{ m }, mInv{ mInv }, type{ Classify( m, mInv ) }
+    {
+    }
 
-    friend Transform Inverse( const Transform& t ) { return Transform( t.mInv, t.m ); }
+    friend Transform Inverse( const Transform& t ) { return Transform( t.mInv, t.m, t.type ); }
     friend Transform Transpose( const Transform& t )
     {
         return Transform( Transpose( t.m ), Transpose( t.mInv ) );
@@ -189,9 +164,24 @@ class Transform {
     template < typename T > inline Point3< T > operator()( const Point3< T >& p ) const
     {
         T x = p.x, y = p.y, z = p.z;
+        switch ( type ) {
+        case TransformType::Identity:
+            return p;
+        case TransformType::Translation:
+            return Point3< T >( x + m.m[ 0 ][ 3 ], y + m.m[ 1 ][ 3 ], z + m.m[ 2 ][ 3 ] );
+        case TransformType::UniformScale: {
+            T s = m.m[ 0 ][ 0 ];
+            return Point3< T >( s * x + m.m[ 0 ][ 3 ], s * y + m.m[ 1 ][ 3 ],
+                                s * z + m.m[ 2 ][ 3 ] );
+        }
+        default:
+            break;
+        }
         T xp = m.m[ 0 ][ 0 ] * x + m.m[ 0 ][ 1 ] * y + m.m[ 0 ][ 2 ] * z + m.m[ 0 ][ 3 ];
         T yp = m.m[ 1 ][ 0 ] * x + m.m[ 1 ][ 1 ] * y + m.m[ 1 ][ 2 ] * z + m.m[ 1 ][ 3 ];
         T zp = m.m[ 2 ][ 0 ] * x + m.m[ 2 ][ 1 ] * y + m.m[ 2 ][ 2 ] * z + m.m[ 2 ][ 3 ];
+        if ( type == TransformType::Affine )
+            return Point3< T >( xp, yp, zp );
         T wp = m.m[ 3 ][ 0 ] * x + m.m[ 3 ][ 1 ] * y + m.m[ 3 ][ 2 ] * z + m.m[ 3 ][ 3 ];
         CHECK_NE( wp, 0 );
         if ( wp == 1 )
@@ -203,6 +193,10 @@ class Transform {
     template < typename T > inline Vector3< T > operator()( const Vector3< T >& v ) const
     {
         T x = v.x, y = v.y, z = v.z;
+        if ( type <= TransformType::Translation )
+            return v;
+        if ( type == TransformType::UniformScale )
+            return v * m.m[ 0 ][ 0 ];
         return Vector3< T >( m.m[ 0 ][ 0 ] * x + m.m[ 0 ][ 1 ] * y + m.m[ 0 ][ 2 ] * z,
                              m.m[ 1 ][ 0 ] * x + m.m[ 1 ][ 1 ] * y + m.m[ 1 ][ 2 ] * z,
                              m.m[ 2 ][ 0 ] * x + m.m[ 2 ][ 1 ] * y + m.m[ 2 ][ 2 ] * z );
@@ -211,6 +205,10 @@ class Transform {
     template < typename T > inline Normal3< T > operator()( const Normal3< T >& n ) const
     {
         T x = n.x, y = n.y, z = n.z;
+        if ( type <= TransformType::Translation )
+            return n;
+        if ( type == TransformType::UniformScale )
+            return n * mInv.m[ 0 ][ 0 ];
         return Normal3< T >( mInv.m[ 0 ][ 0 ] * x + mInv.m[ 1 ][ 0 ] * y + mInv.m[ 2 ][ 0 ] * z,
                              mInv.m[ 0 ][ 1 ] * x + mInv.m[ 1 ][ 1 ] * y + mInv.m[ 2 ][ 1 ] * z,
                              mInv.m[ 0 ][ 2 ] * x + mInv.m[ 1 ][ 2 ] * y + mInv.m[ 2 ][ 2 ] * z );
@@ -218,6 +216,8 @@ class Transform {
 
     inline Ray operator()( const Ray& r ) const
     {
+        if ( type == TransformType::Identity )
+            return Ray( r.o, r.d, r.tMax, r.time, r.medium );
         Vector3f oError;
         Point3f o = ( *this )( r.o, &oError );
         Vector3f d = ( *this )( r.d );
@@ -248,11 +248,32 @@ class Transform {
     inline Point3< T > operator()( const Point3< T >& p, Vector3< T >* pError ) const
     {
         T x = p.x, y = p.y, z = p.z;
+        // the identity is exact; the other affine classes drop the terms that are known to be
+        // zero from both the point and its error bound, which leaves the bound unchanged
+        switch ( type ) {
+        case TransformType::Identity:
+            *pError = Vector3< T >( 0, 0, 0 );
+            return p;
+        case TransformType::Translation:
+            *pError = gamma( 3 ) * Vector3< T >( std::abs( x ) + std::abs( m.m[ 0 ][ 3 ] ),
+                                                 std::abs( y ) + std::abs( m.m[ 1 ][ 3 ] ),
+                                                 std::abs( z ) + std::abs( m.m[ 2 ][ 3 ] ) );
+            return Point3< T >( x + m.m[ 0 ][ 3 ], y + m.m[ 1 ][ 3 ], z + m.m[ 2 ][ 3 ] );
+        case TransformType::UniformScale: {
+            T s = m.m[ 0 ][ 0 ];
+            *pError = gamma( 3 ) * Vector3< T >( std::abs( s * x ) + std::abs( m.m[ 0 ][ 3 ] ),
+                                                 std::abs( s * y ) + std::abs( m.m[ 1 ][ 3 ] ),
+                                                 std::abs( s * z ) + std::abs( m.m[ 2 ][ 3 ] ) );
+            return Point3< T >( s * x + m.m[ 0 ][ 3 ], s * y + m.m[ 1 ][ 3 ],
+                                s * z + m.m[ 2 ][ 3 ] );
+        }
+        default:
+            break;
+        }
         // Compute transformed coordinates from point _pt_
         T xp = m.m[ 0 ][ 0 ] * x + m.m[ 0 ][ 1 ] * y + m.m[ 0 ][ 2 ] * z + m.m[ 0 ][ 3 ];
         T yp = m.m[ 1 ][ 0 ] * x + m.m[ 1 ][ 1 ] * y + m.m[ 1 ][ 2 ] * z + m.m[ 1 ][ 3 ];
         T zp = m.m[ 2 ][ 0 ] * x + m.m[ 2 ][ 1 ] * y + m.m[ 2 ][ 2 ] * z + m.m[ 2 ][ 3 ];
-        T wp = m.m[ 3 ][ 0 ] * x + m.m[ 3 ][ 1 ] * y + m.m[ 3 ][ 2 ] * z + m.m[ 3 ][ 3 ];
 
         // Compute absolute error for transformed point
         T xAbsSum = ( std::abs( m.m[ 0 ][ 0 ] * x ) + std::abs( m.m[ 0 ][ 1 ] * y ) +
@@ -262,6 +283,9 @@ class Transform {
         T zAbsSum = ( std::abs( m.m[ 2 ][ 0 ] * x ) + std::abs( m.m[ 2 ][ 1 ] * y ) +
                       std::abs( m.m[ 2 ][ 2 ] * z ) + std::abs( m.m[ 2 ][ 3 ] ) );
         *pError = gamma( 3 ) * Vector3< T >( xAbsSum, yAbsSum, zAbsSum );
+        if ( type == TransformType::Affine )
+            return Point3< T >( xp, yp, zp );
+        T wp = m.m[ 3 ][ 0 ] * x + m.m[ 3 ][ 1 ] * y + m.m[ 3 ][ 2 ] * z + m.m[ 3 ][ 3 ];
         CHECK_NE( wp, 0 );
         if ( wp == 1 )
             return Point3< T >( xp, yp, zp );
@@ -274,10 +298,31 @@ class Transform {
                                    Vector3< T >* absError ) const
     {
         T x = pt.x, y = pt.y, z = pt.z;
+        switch ( type ) {
+        case TransformType::Identity:
+            *absError = ptError;
+            return pt;
+        case TransformType::Translation:
+            *absError = ( gamma( 3 ) + ( T )1 ) * ptError +
+                        gamma( 3 ) * Vector3< T >( std::abs( x ) + std::abs( m.m[ 0 ][ 3 ] ),
+                                                   std::abs( y ) + std::abs( m.m[ 1 ][ 3 ] ),
+                                                   std::abs( z ) + std::abs( m.m[ 2 ][ 3 ] ) );
+            return Point3< T >( x + m.m[ 0 ][ 3 ], y + m.m[ 1 ][ 3 ], z + m.m[ 2 ][ 3 ] );
+        case TransformType::UniformScale: {
+            T s = m.m[ 0 ][ 0 ];
+            *absError = ( gamma( 3 ) + ( T )1 ) * std::abs( s ) * ptError +
+                        gamma( 3 ) * Vector3< T >( std::abs( s * x ) + std::abs( m.m[ 0 ][ 3 ] ),
+                                                   std::abs( s * y ) + std::abs( m.m[ 1 ][ 3 ] ),
+                                                   std::abs( s * z ) + std::abs( m.m[ 2 ][ 3 ] ) );
+            return Point3< T >( s * x + m.m[ 0 ][ 3 ], s * y + m.m[ 1 ][ 3 ],
+                                s * z + m.m[ 2 ][ 3 ] );
+        }
+        default:
+            break;
+        }
         T xp = m.m[ 0 ][ 0 ] * x + m.m[ 0 ][ 1 ] * y + m.m[ 0 ][ 2 ] * z + m.m[ 0 ][ 3 ];
         T yp = m.m[ 1 ][ 0 ] * x + m.m[ 1 ][ 1 ] * y + m.m[ 1 ][ 2 ] * z + m.m[ 1 ][ 3 ];
         T zp = m.m[ 2 ][ 0 ] * x + m.m[ 2 ][ 1 ] * y + m.m[ 2 ][ 2 ] * z + m.m[ 2 ][ 3 ];
-        T wp = m.m[ 3 ][ 0 ] * x + m.m[ 3 ][ 1 ] * y + m.m[ 3 ][ 2 ] * z + m.m[ 3 ][ 3 ];
         absError->x = ( gamma( 3 ) + ( T )1 ) * ( std::abs( m.m[ 0 ][ 0 ] ) * ptError.x +
                                                   std::abs( m.m[ 0 ][ 1 ] ) * ptError.y +
                                                   std::abs( m.m[ 0 ][ 2 ] ) * ptError.z ) +
@@ -293,6 +338,9 @@ class Transform {
                                                   std::abs( m.m[ 2 ][ 2 ] ) * ptError.z ) +
                       gamma( 3 ) * ( std::abs( m.m[ 2 ][ 0 ] * x ) + std::abs( m.m[ 2 ][ 1 ] * y ) +
                                      std::abs( m.m[ 2 ][ 2 ] * z ) + std::abs( m.m[ 2 ][ 3 ] ) );
+        if ( type == TransformType::Affine )
+            return Point3< T >( xp, yp, zp );
+        T wp = m.m[ 3 ][ 0 ] * x + m.m[ 3 ][ 1 ] * y + m.m[ 3 ][ 2 ] * z + m.m[ 3 ][ 3 ];
         CHECK_NE( wp, 0 );
         if ( wp == 1. )
             return Point3< T >( xp, yp, zp );
@@ -304,6 +352,15 @@ class Transform {
     inline Vector3< T > operator()( const Vector3< T >& v, Vector3< T >* absError ) const
     {
         T x = v.x, y = v.y, z = v.z;
+        if ( type <= TransformType::Translation ) {
+            *absError = Vector3< T >( 0, 0, 0 );
+            return v;
+        }
+        if ( type == TransformType::UniformScale ) {
+            Vector3< T > vp = v * m.m[ 0 ][ 0 ];
+            *absError = gamma( 3 ) * Abs( vp );
+            return vp;
+        }
         absError->x =
           gamma( 3 ) * ( std::abs( m.m[ 0 ][ 0 ] * v.x ) + std::abs( m.m[ 0 ][ 1 ] * v.y ) +
                          std::abs( m.m[ 0 ][ 2 ] * v.z ) );
@@ -323,6 +380,16 @@ class Transform {
                                     Vector3< T >* absError ) const
     {
         T x = v.x, y = v.y, z = v.z;
+        if ( type <= TransformType::Translation ) {
+            *absError = vError;
+            return v;
+        }
+        if ( type == TransformType::UniformScale ) {
+            Vector3< T > vp = v * m.m[ 0 ][ 0 ];
+            *absError = ( gamma( 3 ) + ( T )1 ) * std::abs( m.m[ 0 ][ 0 ] ) * vError +
+                        gamma( 3 ) * Abs( vp );
+            return vp;
+        }
         absError->x =
           ( gamma( 3 ) + ( T )1 ) *
             ( std::abs( m.m[ 0 ][ 0 ] ) * vError.x + std::abs( m.m[ 0 ][ 1 ] ) * vError.y +
@@ -348,6 +415,10 @@ class Transform {
 
     inline Ray operator()( const Ray& r, Vector3f* oError, Vector3f* dError ) const
     {
+        if ( type == TransformType::Identity ) {
+            *oError = *dError = Vector3f( 0, 0, 0 );
+            return Ray( r.o, r.d, r.tMax, r.time, r.medium );
+        }
         Point3f o = ( *this )( r.o, oError );
         Vector3f d = ( *this )( r.d, dError );
         Float tMax = r.tMax;
@@ -378,97 +449,47 @@ class Transform {
     Bounds3f operator()( const Bounds3f& b ) const;
     SurfaceInteraction operator()( const SurfaceInteraction& si ) const;
 
+    // Batch versions of the operators above for n elements, SimdWidth at a time; out may be the
+    // array that is read. Each result and error bound is the one the single-element operator
+    // gives (up to the compiler fusing its multiply-adds, and the sign of zero). Error arrays
+    // are optional.
+    void TransformPoints( const Point3f* p, int n, Point3f* out,
+                          Vector3f* pError = nullptr ) const;
+    void TransformVectors( const Vector3f* v, int n, Vector3f* out,
+                           Vector3f* vError = nullptr ) const;
+    void TransformNormals( const Normal3f* nrm, int n, Normal3f* out ) const;
+    void TransformRays( const Ray* r, int n, Ray* out, Vector3f* oError = nullptr,
+                        Vector3f* dError = nullptr ) const;
+
     Transform operator*( const Transform& t2 ) const;
+    // t[ 0 ] * t[ 1 ] * ... * t[ n - 1 ] in one pass that accumulates the matrix and its inverse
+    // together and skips identities; with prefix, also prefix[ i ] = t[ 0 ] * ... * t[ i ], the
+    // world transforms of a hierarchy given its local ones
+    static Transform Compose( const Transform* t, int n, Transform* prefix = nullptr );
     bool operator==( const Transform& t2 ) const;
     bool operator!=( const Transform& t2 ) const;
 
     bool SwapsHandedness() const;
+    const Matrix4x4& GetMatrix() const { return m; }
+    const Matrix4x4& GetInverseMatrix() const { return mInv; }
+    TransformType Type() const { return type; }
+    bool IsIdentity() const { return type == TransformType::Identity; }
 
   private:
+    // the inverse of each class is in the same class, so a pair that is already classified
+    // doesn't need to be looked at again
+    Transform( const Matrix4x4& m, const Matrix4x4& mInv, TransformType type )
+    : m{ m }, mInv{ mInv }, type{ type }
+    {
+    }
+    static TransformType Classify( const Matrix4x4& m, const Matrix4x4& mInv );
+
     Matrix4x4 m, mInv;
+    TransformType type = TransformType::Identity;
     friend struct Quaternion;
     friend class AnimatedTransform;
 };
 
-struct Interval
-{
-    Float low, high;
-
-    Interval( Float v ) : low{ v }, high{ v } {}
-    Interval( Float v0, Float v1 ) : low{ v0 }, high{ v1 } {}
-
-    Interval operator+( const Interval& i ) const { return Interval( low + i.low, high + i.high ); }
-
-    Interval operator-( const Interval& i ) const { return Interval( low - i.high, high - i.low ); }
-
-    Interval operator*( const Interval& i ) const
-    {
-        return Interval( std::min( std::min( low * i.low, high * i.low ),
-                                   std::min( low * i.high, high * i.high ) ),
-                         std::max( std::max( low * i.low, high * i.low ),
-                                   std::max( low * i.high, high * i.high ) ) );
-    }
-};
-
-inline Interval Sin( const Interval& i )
-{
-    Float sinLow = std::sin( i.low ), sinHigh = std::sin( i.high );
-    if ( sinLow > sinHigh )
-        std::swap( sinLow, sinHigh );
-    if ( i.low < Pi / 2 && i.high > Pi / 2 )
-        sinHigh = 1.;
-    if ( i.low < ( 3.f / 2.f ) * Pi && i.high > ( 3.f / 2.f ) * Pi )
-        sinLow = -1.;
-    return Interval( sinLow, sinHigh );
-}
-
-inline Interval Cos( const Interval& i )
-{
-    Float cosLow = std::cos( i.low ), cosHigh = std::cos( i.high );
-    if ( cosLow > cosHigh )
-        std::swap( cosLow, cosHigh );
-    if ( i.low < Pi / 2 && i.high > Pi / 2 )
-        cosHigh = 1.;
-    if ( i.low < ( 3.f / 2.f ) * Pi && i.high > ( 3.f / 2.f ) * Pi )
-        cosLow = -1.;
-    return Interval( cosLow, cosHigh );
-}
-
-void IntervalFindZeros( Float c1, Float c2, Float c3, Float c4, Float c5, Float theta,
-                        Interval tInterval, Float* zeros, int* zeroCount, int depth = 8 )
-{
-    // evaluate motion derivative in interval form, return if no zeros:
-    Interval range =
-      Interval( c1 ) +
-      ( Interval( c2 ) + Interval( c3 ) * tInterval ) * Cos( Interval( 2 * theta ) * tInterval ) +
-      ( Interval( c4 ) + Interval( c5 ) * tInterval ) * Sin( Interval( 2 * theta ) * tInterval );
-    if ( range.low > 0. || range.high < 0. || range.low == range.high )
-        return;
-    if ( depth > 0 ) {
-        // split tInterval and check both resulting intervalsx
-        Float mid = ( tInterval.low + tInterval.high ) * .5f;
-        IntervalFindZeros( c1, c2, c3, c4, c5, theta, Interval( tInterval.low, mid ), zeros,
-                           zeroCount, depth - 1 );
-        IntervalFindZeros( c1, c2, c3, c4, c5, theta, Interval( mid, tInterval.high ), zeros,
-                           zeroCount, depth - 1 );
-    } else {
-        // use newton's method to refine zero
-        Float tNewton = ( tInterval.low + tInterval.high ) * .5f;
-        for ( auto i = 0; i < 4; ++i ) {
-            Float fNewton = c1 + ( c2 + c3 * tNewton ) * std::cos( 2.f * theta * tNewton ) +
-                            ( c4 + c5 * tNewton ) * std::sin( 2.f * theta * tNewton );
-            Float fPrimeNewton =
-              ( c3 + 2 * ( c4 + c5 * tNewton ) * theta ) * std::cos( 2.f * tNewton * theta ) +
-              ( c5 - 2 * ( c2 + c3 * tNewton ) * theta ) * std::sin( 2.f * tNewton * theta );
-            if ( fNewton == 0 || fPrimeNewton == 0 )
-                break;
-            tNewton = tNewton - fNewton / fPrimeNewton;
-        }
-        zeros[ *zeroCount ] = tNewton;
-        ++( *zeroCount );
-    }
-}
-
 class AnimatedTransform {
   public:
     AnimatedTransform( const Transform* startTransform, Float startTime,
@@ -476,14 +497,25 @@ class AnimatedTransform {
 
     void Decompose( const Matrix4x4& m, Vector3f* T, Quaternion* R, Matrix4x4* S );
     void Interpolate( Float time, Transform* t ) const;
-
+    // Samples the motion into a table that Interpolate() then lerps between, entry by entry,
+    // instead of slerping and composing a transform for every call. The interval is halved
+    // until, at the middle of every segment, no entry of the lerped matrix or of its inverse is
+    // further than tolerance from the exact one, or until there are maxSegments segments.
+    void PrecomputeInterpolation( Float tolerance, int maxSegments = 256 );
+    bool IsAnimated() const { return actuallyAnimated; }
+
+    // the transforms at the rays' times, or at the given time
     Ray operator()( const Ray& r ) const;
     RayDifferential operator()( const RayDifferential& r ) const;
-    Point3f operator()( const Point3f& p ) const;
-    Vector3f operator()( const Vector3f& v ) const;
+    Point3f operator()( Float time, const Point3f& p ) const;
+    Vector3f operator()( Float time, const Vector3f& v ) const;
 
     Bounds3f MotionBounds( const Bounds3f& b ) const;
     Bounds3f BoundPointMotion( const Point3f& p ) const;
+    // bounds of b at time0 and time1 such that interpolating linearly between them bounds b at
+    // every time in between
+    void LinearMotionBounds( const Bounds3f& b, Float time0, Float time1, Bounds3f* bounds0,
+                             Bounds3f* bounds1 ) const;
 
   private:
     struct DerivativeTerm
@@ -496,15 +528,37 @@ class AnimatedTransform {
         Float Eval( const Point3f& p ) const { return kc + kx * p.x + ky * p.y + kz * p.z; }
     };
 
+    Transform interpolate( Float dt ) const;
+    // with rotation, the point p at dt in [ 0, 1 ] is T( dt ) + R( dt ) S( dt ) p, where the
+    // slerped rotation R( dt ) = RConst + RCos cos( 2 theta dt ) + RSin sin( 2 theta dt ), since
+    // its matrix is quadratic in cos( theta dt ) and sin( theta dt )
+    Point3f motionPoint( Float dt, const Point3f& p ) const;
+    Bounds3f boundPointsMotion( const Point3f* p, int n ) const;
+
+    // the motion derivative is sampled at nMotionSegments + 1 evenly spaced times
+    static const int nMotionSegments = 32;
+
     const Transform* startTransform;
     const Transform* endTransform;
     const Float startTime, endTime;
     Vector3f T[ 2 ];
     Quaternion R[ 2 ];
     Matrix4x4 S[ 2 ];
-    DerivativeTerm c1[ 3 ], c2[ 3 ], c3[ 3 ], c4[ 4 ], c5[ 3 ];
+    // the derivative of coordinate c of the moving point p is
+    //     c1[ c ]( p ) + ( c2[ c ]( p ) + c3[ c ]( p ) t ) cos( 2 theta t ) +
+    //                    ( c4[ c ]( p ) + c5[ c ]( p ) t ) sin( 2 theta t )
+    DerivativeTerm c1[ 3 ], c2[ 3 ], c3[ 3 ], c4[ 3 ], c5[ 3 ];
     const bool actuallyAnimated;
     bool hasRotation;
+    // only set with rotation
+    Float theta = 0;
+    Float RConst[ 3 ][ 3 ], RCos[ 3 ][ 3 ], RSin[ 3 ][ 3 ];
+    Float cos2Theta[ nMotionSegments + 1 ], sin2Theta[ nMotionSegments + 1 ];
+    // S[ 0 ] == S[ 1 ] makes the interpolated scale constant, and its inverse is SInv
+    bool scaleAnimated;
+    Matrix4x4 SInv;
+    // transforms at evenly spaced times from startTime to endTime, when precomputed
+    std::vector< Transform > table;
 };
 
 } /* namespace pbrt */
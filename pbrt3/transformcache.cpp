@@ -0,0 +1,103 @@
+//
+//  transformcache.cpp
+//  pbrt3
+//
+//  Created by Ilya Rostovtsev on 10/17/26.
+//  Copyright © 2017 Ilya Rostovtsev. All rights reserved.
+//
+
+#include "transformcache.hpp"
+#include "stats.hpp"
+
+namespace pbrt {
+
+STAT_MEMORY_COUNTER( "Memory/TransformCache", transformCacheBytes );
+STAT_PERCENT( "Scene/TransformCache hits", nTransformCacheHits, nTransformCacheLookups );
+
+uint64_t TransformCache::Hash( const Transform& t )
+{
+    // Transform::operator==() compares m exactly, under which -0 and 0 are equal, so both hash
+    // the same
+    Float m[ 4 ][ 4 ];
+    for ( int i = 0; i < 4; ++i )
+        for ( int j = 0; j < 4; ++j )
+            m[ i ][ j ] = t.GetMatrix().m[ i ][ j ] + Float( 0 );
+    return HashBytes( m, sizeof( m ), 0 );
+}
+
+TransformCache::Entry* TransformCache::find( const Transform& t, uint64_t hash )
+{
+    size_t mask = table.size() - 1;
+    for ( size_t i = hash & mask;; i = ( i + 1 ) & mask ) {
+        Entry& entry = table[ i ];
+        if ( !entry.t || ( entry.hash == hash && *entry.t == t ) )
+            return &entry;
+    }
+}
+
+void TransformCache::insert( uint64_t hash, const Transform* t, const Transform* inverse )
+{
+    if ( 2 * ( nEntries + 1 ) > ( int )table.size() )
+        grow();
+    Entry* entry = find( *t, hash );
+    entry->hash = hash;
+    entry->t = t;
+    entry->inverse = inverse;
+    ++nEntries;
+}
+
+void TransformCache::grow()
+{
+    std::vector< Entry > old( 2 * table.size() );
+    old.swap( table );
+    for ( const Entry& entry : old )
+        if ( entry.t )
+            *find( *entry.t, entry.hash ) = entry;
+}
+
+const Transform* TransformCache::Lookup( const Transform& t, const Transform** tInverse )
+{
+    ++nTransformCacheLookups;
+    uint64_t hash = Hash( t );
+    Entry* entry = find( t, hash );
+    if ( entry->t ) {
+        ++nTransformCacheHits;
+        if ( tInverse )
+            *tInverse = entry->inverse;
+        return entry->t;
+    }
+
+    // intern t and its inverse as a pair; a transform that is its own inverse (the identity, a
+    // reflection) is stored once
+    Transform* tCached = arena.Alloc< Transform >();
+    *tCached = t;
+    Transform inverse = Inverse( t );
+    uint64_t inverseHash = Hash( inverse );
+    Entry* inverseEntry = find( inverse, inverseHash );
+    const Transform* inverseCached = inverseEntry->t;
+    if ( !inverseCached ) {
+        if ( inverse == t )
+            inverseCached = tCached;
+        else {
+            Transform* ic = arena.Alloc< Transform >();
+            *ic = inverse;
+            inverseCached = ic;
+            insert( inverseHash, inverseCached, tCached );
+        }
+    }
+    insert( hash, tCached, inverseCached );
+    transformCacheBytes = arena.TotalAllocated() + table.size() * sizeof( Entry );
+    if ( tInverse )
+        *tInverse = inverseCached;
+    return tCached;
+}
+
+void TransformCache::Clear()
+{
+    transformCacheBytes = 0;
+    arena.Reset();
+    std::vector< Entry >( 64 ).swap( table );
+    nEntries = 0;
+}
+
+} /* namespace pbrt */
@@ -0,0 +1,55 @@
+//
+//  transformcache.hpp
+//  pbrt3
+//
+//  Created by Ilya Rostovtsev on 10/17/26.
+//  Copyright © 2017 Ilya Rostovtsev. All rights reserved.
+//
+
+#ifndef transformcache_hpp
+#define transformcache_hpp
+
+#include "memory.hpp"
+#include "pbrt.hpp"
+#include "transform.hpp"
+
+namespace pbrt {
+
+// Interns the scene's Transforms, so that every shape placed with the same matrix shares one
+// ObjectToWorld and one WorldToObject instead of allocating its own 132 bytes for each. Lookup()
+// hash-conses on the matrix and hands out instances allocated in the cache's arena, which stay
+// valid until Clear(). A transform and its inverse are interned together and point at each other,
+// so looking up either one returns the pair without inverting anything. Not thread-safe: it is
+// meant to be filled while the scene is being built.
+class TransformCache {
+  public:
+    TransformCache() : table( 64 ) {}
+
+    // the shared copy of t, and of Inverse( t ) when tInverse isn't null
+    const Transform* Lookup( const Transform& t, const Transform** tInverse = nullptr );
+    // forgets every transform; pointers handed out before are invalidated
+    void Clear();
+    // number of distinct transforms, counting each inverse separately
+    int Size() const { return nEntries; }
+
+  private:
+    struct Entry
+    {
+        uint64_t hash;
+        const Transform* t = nullptr;
+        const Transform* inverse;
+    };
+
+    static uint64_t Hash( const Transform& t );
+    Entry* find( const Transform& t, uint64_t hash );
+    void insert( uint64_t hash, const Transform* t, const Transform* inverse );
+    void grow();
+
+    // open addressing with linear probing; the size is a power of two at most half full
+    std::vector< Entry > table;
+    int nEntries = 0;
+    MemoryArena arena;
+};
+
+} /* namespace pbrt */
+#endif /* transformcache_hpp */